@@ -0,0 +1,246 @@
+#include "BlockMatcher.h"
+
+// Bound, in units of FLT_EPSILON*(|a|^2 + |b|^2) per descriptor dimension, on
+// how far an expanded squared distance and the distance BFMatcher computes can
+// each be from the true one. The nearest row of BFMatcher always lies within
+// twice the sum of both bounds of the best expanded estimate.
+static const float EXPANSION_ERROR = 8.f;
+static const float EXPANSION_ERROR_SLACK = 16.f;
+
+/*!
+	Matches the query rows of a range of query blocks. With secondDistances set
+	the runner-up of every query is kept as well, and with reverseBest set every
+	block records, per train row, the best estimate of its queries and which one
+	it came from
+*/
+class MatchBlocksBody : public ParallelLoopBody
+{
+public:
+	MatchBlocksBody(const Mat& _query, const Mat& _train, const Mat& _queryNorms, const Mat& _trainNorms,
+		float _maxTrainNorm, vector<DMatch>& _matches, vector<float>* _secondDistances = NULL,
+		Mat* _reverseBest = NULL, Mat* _reverseIdx = NULL)
+		: query(_query), train(_train), queryNorms(_queryNorms), trainNorms(_trainNorms),
+		maxTrainNorm(_maxTrainNorm), matches(_matches), secondDistances(_secondDistances),
+		reverseBest(_reverseBest), reverseIdx(_reverseIdx) {}
+
+	virtual void operator()(const Range& range) const
+	{
+		const float* qn = queryNorms.ptr<float>(0);
+		const float* tn = trainNorms.ptr<float>(0);
+		float errorScale = (EXPANSION_ERROR * query.cols + EXPANSION_ERROR_SLACK) * FLT_EPSILON;
+
+		bool keepSecond = secondDistances != NULL;
+		vector<float> best(BlockMatcher::QUERY_BLOCK), second(BlockMatcher::QUERY_BLOCK), margin(BlockMatcher::QUERY_BLOCK);
+		vector<vector<pair<int, float> > > candidates(BlockMatcher::QUERY_BLOCK);
+		Mat dots, dist;
+
+		for (int block = range.start; block < range.end; block++)
+		{
+			int q0 = block * BlockMatcher::QUERY_BLOCK;
+			int q1 = std::min(q0 + BlockMatcher::QUERY_BLOCK, query.rows);
+			int i, j;
+			float* rb = reverseBest ? reverseBest->ptr<float>(block) : NULL;
+			int* ri = reverseIdx ? reverseIdx->ptr<int>(block) : NULL;
+
+			for (i = q0; i < q1; i++)
+			{
+				best[i - q0] = second[i - q0] = FLT_MAX;
+				margin[i - q0] = errorScale * (qn[i] + maxTrainNorm);
+				candidates[i - q0].clear();
+			}
+
+			for (int t0 = 0; t0 < train.rows; t0 += BlockMatcher::TRAIN_BLOCK)
+			{
+				int t1 = std::min(t0 + BlockMatcher::TRAIN_BLOCK, train.rows);
+				gemm(query.rowRange(q0, q1), train.rowRange(t0, t1), 1.0, noArray(), 0.0, dots, GEMM_2_T);
+
+				for (i = q0; i < q1; i++)
+				{
+					const float* dot = dots.ptr<float>(i - q0);
+					vector<pair<int, float> >& cand = candidates[i - q0];
+					float& b = best[i - q0];
+					float& b2 = second[i - q0];
+					float& bound = keepSecond ? b2 : b;		// estimate the candidates must stay near
+					float m = margin[i - q0];
+					bool improved = false;
+
+					for (j = t0; j < t1; j++)
+					{
+						float estimate = qn[i] + tn[j] - 2.f * dot[j - t0];
+						if (rb && estimate < rb[j])
+						{
+							rb[j] = estimate;
+							ri[j] = i;
+						}
+						if (estimate <= bound + m)
+						{
+							cand.push_back(make_pair(j, estimate));
+							if (estimate < b)
+							{
+								b2 = b;
+								b = estimate;
+								improved = true;
+							}
+							else if (estimate < b2)
+							{
+								b2 = estimate;
+								improved = true;
+							}
+						}
+					}
+
+					// drop the rows the new best estimate has ruled out
+					if (improved)
+					{
+						size_t kept = 0;
+						for (size_t k = 0; k < cand.size(); k++)
+							if (cand[k].second <= bound + m)
+								cand[kept++] = cand[k];
+						cand.resize(kept);
+					}
+				}
+			}
+
+			// measure the candidates like BFMatcher; they are in train order, so
+			// equally distant rows resolve to the first one as they do there
+			for (i = q0; i < q1; i++)
+			{
+				const vector<pair<int, float> >& cand = candidates[i - q0];
+				int bestIdx = -1;
+				float bestDist = FLT_MAX, secondDist = FLT_MAX;
+
+				for (size_t k = 0; k < cand.size(); k++)
+				{
+					batchDistance(query.row(i), train.row(cand[k].first), dist, CV_32F, noArray(), NORM_L2);
+					float d = dist.at<float>(0, 0);
+					if (d < bestDist || bestIdx < 0)
+					{
+						secondDist = bestDist;
+						bestDist = d;
+						bestIdx = cand[k].first;
+					}
+					else if (d < secondDist)
+						secondDist = d;
+				}
+				matches[i] = DMatch(i, bestIdx, 0, bestDist);
+				if (keepSecond)
+					(*secondDistances)[i] = secondDist;
+			}
+		}
+	}
+
+private:
+	const Mat& query;
+	const Mat& train;
+	const Mat& queryNorms;
+	const Mat& trainNorms;
+	float maxTrainNorm;
+	vector<DMatch>& matches;
+	vector<float>* secondDistances;
+	Mat* reverseBest;
+	Mat* reverseIdx;
+};
+
+//------------------------------------match()------------------------------------------
+// find the nearest train descriptor of every query descriptor
+//Precondition: query and train are CV_32F with the same number of columns;
+//				queryNorms, if given, is squaredNorms(query)
+//Postcondition: matches holds one match per query row in query order, as
+//				 BFMatcher(NORM_L2).match() would return; it is empty if either
+//				 matrix is empty
+//-------------------------------------------------------------------------------------
+void BlockMatcher::match(const Mat& query, const Mat& train, vector<DMatch>& matches, const Mat& _queryNorms)
+{
+	matches.clear();
+	if (query.empty() || train.empty())
+		return;
+
+	CV_Assert(query.type() == CV_32F && train.type() == CV_32F && query.cols == train.cols);
+
+	Mat queryNorms = _queryNorms.empty() ? squaredNorms(query) : _queryNorms;
+	Mat trainNorms = squaredNorms(train);
+	double maxTrainNorm;
+	minMaxLoc(trainNorms, NULL, &maxTrainNorm);
+
+	matches.resize(query.rows);
+	int blocks = (query.rows + QUERY_BLOCK - 1) / QUERY_BLOCK;
+	parallel_for_(Range(0, blocks), MatchBlocksBody(query, train, queryNorms, trainNorms, (float)maxTrainNorm, matches));
+}
+
+//------------------------------------squaredNorms()-----------------------------------
+// the squared length of every row, which can be computed once for descriptors
+// that are matched against several others
+//Precondition: descriptors is CV_32F
+//Postcondition: a row vector of the squared row lengths is returned
+//-------------------------------------------------------------------------------------
+Mat BlockMatcher::squaredNorms(const Mat& descriptors)
+{
+	Mat norms(1, descriptors.rows, CV_32F);
+	float* dst = norms.ptr<float>(0);
+
+	for (int i = 0; i < descriptors.rows; i++)
+	{
+		const float* row = descriptors.ptr<float>(i);
+		float sum = 0;
+		for (int k = 0; k < descriptors.cols; k++)
+			sum += row[k] * row[k];
+		dst[i] = sum;
+	}
+	return norms;
+}
+
+//------------------------------------matchTwoWay()------------------------------------
+// find the two nearest train descriptors of every query descriptor and the
+// nearest query descriptor of every train descriptor, from one set of products
+//Precondition: query and train are CV_32F with the same number of columns;
+//				queryNorms, if given, is squaredNorms(query)
+//Postcondition: matches is what match() returns; secondDistances holds the
+//				 distance of the second nearest train row of every query, FLT_MAX
+//				 if there is only one; reverseMatches holds the nearest query row
+//				 of every train row, decided on the expanded distances, so rows
+//				 within float rounding of each other may be picked either way
+//-------------------------------------------------------------------------------------
+void BlockMatcher::matchTwoWay(const Mat& query, const Mat& train, vector<DMatch>& matches,
+	vector<float>& secondDistances, vector<int>& reverseMatches, const Mat& _queryNorms)
+{
+	matches.clear();
+	secondDistances.clear();
+	reverseMatches.clear();
+	if (query.empty() || train.empty())
+		return;
+
+	CV_Assert(query.type() == CV_32F && train.type() == CV_32F && query.cols == train.cols);
+
+	Mat queryNorms = _queryNorms.empty() ? squaredNorms(query) : _queryNorms;
+	Mat trainNorms = squaredNorms(train);
+	double maxTrainNorm;
+	minMaxLoc(trainNorms, NULL, &maxTrainNorm);
+
+	// each query block keeps its own best query per train row; they are merged below
+	int blocks = (query.rows + QUERY_BLOCK - 1) / QUERY_BLOCK;
+	Mat reverseBest(blocks, train.rows, CV_32F, Scalar::all(FLT_MAX));
+	Mat reverseIdx(blocks, train.rows, CV_32S, Scalar::all(-1));
+
+	matches.resize(query.rows);
+	secondDistances.resize(query.rows);
+	parallel_for_(Range(0, blocks), MatchBlocksBody(query, train, queryNorms, trainNorms, (float)maxTrainNorm, matches,
+		&secondDistances, &reverseBest, &reverseIdx));
+
+	// blocks are merged in query order, so equal estimates resolve to the first query
+	reverseMatches.assign(reverseIdx.ptr<int>(0), reverseIdx.ptr<int>(0) + train.rows);
+	const float* rb0 = reverseBest.ptr<float>(0);
+	vector<float> bestEstimate(rb0, rb0 + train.rows);
+	for (int block = 1; block < blocks; block++)
+	{
+		const float* rb = reverseBest.ptr<float>(block);
+		const int* ri = reverseIdx.ptr<int>(block);
+		for (int j = 0; j < train.rows; j++)
+		{
+			if (rb[j] < bestEstimate[j])
+			{
+				bestEstimate[j] = rb[j];
+				reverseMatches[j] = ri[j];
+			}
+		}
+	}
+}
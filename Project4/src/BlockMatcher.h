@@ -0,0 +1,74 @@
+//-------------------------------------------------------------------------
+// Name: BlockMatcher.h
+// Description: Brute-force nearest neighbour matcher for float descriptors
+//  built on matrix products. The squared L2 distances are expanded as
+//  |a|^2 + |b|^2 - 2 a.b, and the dot products of a block of query rows
+//  with a block of train rows come from one gemm() call, so the distance
+//  matrix is only ever held one block at a time. The expansion loses a
+//  little precision, so for every query the train rows whose estimate is
+//  within its error bound of the best estimate are kept as candidates and
+//  measured again with batchDistance(), the routine BFMatcher uses. The
+//  matches, including their distances and the choice between equally
+//  distant rows, are therefore the same as BFMatcher's. Query blocks are
+//  matched in parallel. The same pass can also keep the second nearest
+//  train row of every query and the nearest query row of every train row,
+//  which the ratio test and the mutual nearest neighbour check need.
+// Methods:
+//			match()
+//			matchTwoWay()
+//			squaredNorms()
+//-------------------------------------------------------------------------
+
+#ifndef BLOCK_MATCHER_H
+#define BLOCK_MATCHER_H
+
+#include "opencv2/opencv.hpp"
+#include <vector>
+
+using namespace std;
+using namespace cv;
+
+#ifdef __cplusplus
+
+class BlockMatcher
+{
+public:
+	static const int QUERY_BLOCK = 64;		// query rows of one gemm() block
+	static const int TRAIN_BLOCK = 256;		// train rows of one gemm() block
+
+//------------------------------------match()------------------------------------------
+// find the nearest train descriptor of every query descriptor
+//Precondition: query and train are CV_32F with the same number of columns;
+//				queryNorms, if given, is squaredNorms(query)
+//Postcondition: matches holds one match per query row in query order, as
+//				 BFMatcher(NORM_L2).match() would return; it is empty if either
+//				 matrix is empty
+//-------------------------------------------------------------------------------------
+	static void match(const Mat& query, const Mat& train, vector<DMatch>& matches, const Mat& queryNorms = Mat());
+
+//------------------------------------matchTwoWay()------------------------------------
+// find the two nearest train descriptors of every query descriptor and the
+// nearest query descriptor of every train descriptor, from one set of products
+//Precondition: query and train are CV_32F with the same number of columns;
+//				queryNorms, if given, is squaredNorms(query)
+//Postcondition: matches is what match() returns; secondDistances holds the
+//				 distance of the second nearest train row of every query, FLT_MAX
+//				 if there is only one; reverseMatches holds the nearest query row
+//				 of every train row, decided on the expanded distances, so rows
+//				 within float rounding of each other may be picked either way
+//-------------------------------------------------------------------------------------
+	static void matchTwoWay(const Mat& query, const Mat& train, vector<DMatch>& matches,
+		vector<float>& secondDistances, vector<int>& reverseMatches, const Mat& queryNorms = Mat());
+
+//------------------------------------squaredNorms()-----------------------------------
+// the squared length of every row, which can be computed once for descriptors
+// that are matched against several others
+//Precondition: descriptors is CV_32F
+//Postcondition: a row vector of the squared row lengths is returned
+//-------------------------------------------------------------------------------------
+	static Mat squaredNorms(const Mat& descriptors);
+};
+
+#endif /* __cplusplus */
+
+#endif
@@ -0,0 +1,113 @@
+#include "ByteMatcher.h"
+#include <algorithm>
+#include <climits>
+
+// squared L2 distance of two byte rows; the differences fit in 16 bits and their
+// squares are summed pairwise into 32 bits with pmaddwd, so every order of the
+// integer additions gives the same sum
+static inline int squaredDistance(const uchar* a, const uchar* b, int len)
+{
+	int k = 0, sum = 0;
+#if CV_SSE2
+	if (checkHardwareSupport(CV_CPU_SSE2))
+	{
+		__m128i zero = _mm_setzero_si128(), acc = _mm_setzero_si128();
+		for (; k <= len - 16; k += 16)
+		{
+			__m128i va = _mm_loadu_si128((const __m128i*)(a + k)), vb = _mm_loadu_si128((const __m128i*)(b + k));
+			__m128i d0 = _mm_sub_epi16(_mm_unpacklo_epi8(va, zero), _mm_unpacklo_epi8(vb, zero));
+			__m128i d1 = _mm_sub_epi16(_mm_unpackhi_epi8(va, zero), _mm_unpackhi_epi8(vb, zero));
+			acc = _mm_add_epi32(acc, _mm_add_epi32(_mm_madd_epi16(d0, d0), _mm_madd_epi16(d1, d1)));
+		}
+		acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, _MM_SHUFFLE(1, 0, 3, 2)));
+		acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, _MM_SHUFFLE(2, 3, 0, 1)));
+		sum = _mm_cvtsi128_si32(acc);
+	}
+#endif
+	for (; k < len; k++)
+	{
+		int diff = (int)a[k] - (int)b[k];
+		sum += diff * diff;
+	}
+	return sum;
+}
+
+/*!
+	Matches the query rows of a range of query blocks, one train block at a time
+*/
+class MatchBytesBody : public ParallelLoopBody
+{
+public:
+	MatchBytesBody(const Mat& _query, const Mat& _train, vector<DMatch>& _matches)
+		: query(_query), train(_train), matches(_matches) {}
+
+	virtual void operator()(const Range& range) const
+	{
+		vector<int> best(ByteMatcher::QUERY_BLOCK), bestIdx(ByteMatcher::QUERY_BLOCK);
+		Mat dist;
+
+		for (int block = range.start; block < range.end; block++)
+		{
+			int q0 = block * ByteMatcher::QUERY_BLOCK;
+			int q1 = std::min(q0 + ByteMatcher::QUERY_BLOCK, query.rows);
+			int i, j;
+
+			std::fill(best.begin(), best.end(), INT_MAX);
+			std::fill(bestIdx.begin(), bestIdx.end(), -1);
+
+			// train rows are visited in order and only a strictly smaller sum replaces
+			// the best, so rows with equal sums resolve to the first
+			for (int t0 = 0; t0 < train.rows; t0 += ByteMatcher::TRAIN_BLOCK)
+			{
+				int t1 = std::min(t0 + ByteMatcher::TRAIN_BLOCK, train.rows);
+				for (i = q0; i < q1; i++)
+				{
+					const uchar* q = query.ptr<uchar>(i);
+					int& b = best[i - q0];
+					int& bi = bestIdx[i - q0];
+					for (j = t0; j < t1; j++)
+					{
+						int d = squaredDistance(q, train.ptr<uchar>(j), query.cols);
+						if (d < b)
+						{
+							b = d;
+							bi = j;
+						}
+					}
+				}
+			}
+
+			for (i = q0; i < q1; i++)
+			{
+				int t = bestIdx[i - q0];
+				batchDistance(query.row(i), train.row(t), dist, CV_32F, noArray(), NORM_L2);
+				matches[i] = DMatch(i, t, 0, dist.at<float>(0, 0));
+			}
+		}
+	}
+
+private:
+	const Mat& query;
+	const Mat& train;
+	vector<DMatch>& matches;
+};
+
+//------------------------------------match()------------------------------------------
+// find the nearest train descriptor of every query descriptor
+//Precondition: query and train are CV_8U with the same number of columns
+//Postcondition: matches holds one match per query row in query order, with the
+//				 train row of the smallest integer sum, the first of equal ones;
+//				 it is empty if either matrix is empty
+//-------------------------------------------------------------------------------------
+void ByteMatcher::match(const Mat& query, const Mat& train, vector<DMatch>& matches)
+{
+	matches.clear();
+	if (query.empty() || train.empty())
+		return;
+
+	CV_Assert(query.type() == CV_8U && train.type() == CV_8U && query.cols == train.cols);
+
+	matches.resize(query.rows);
+	int blocks = (query.rows + QUERY_BLOCK - 1) / QUERY_BLOCK;
+	parallel_for_(Range(0, blocks), MatchBytesBody(query, train, matches));
+}
@@ -0,0 +1,51 @@
+//-------------------------------------------------------------------------
+// Name: ByteMatcher.h
+// Description: Brute-force nearest neighbour matcher for descriptors
+//  quantised to CV_8U. The squared L2 distance of two rows is summed in
+//  32-bit integers straight from the bytes, with SSE2 multiply-adds on
+//  packed 16-bit differences when the CPU has them, and a row of
+//  bytes is a quarter of the float one, so four times as many train rows
+//  stay in cache. A block of train rows is compared with a block of query
+//  rows before moving on. The rows are ranked by their integer sums, which
+//  are exact, and the first of rows with equal sums is kept. BFMatcher
+//  ranks them by the float square roots of the same sums, and sums a few
+//  apart can round to the same float once they are large, as they are
+//  for long stacked descriptors; it then keeps the first of those rows,
+//  where this matcher keeps the one with the smaller sum. The chosen row
+//  can therefore differ from BFMatcher's between rows whose distances
+//  agree to float precision, and nowhere else. The distance of a match
+//  is measured with batchDistance(). Query blocks are matched in parallel.
+// Methods:
+//			match()
+//-------------------------------------------------------------------------
+
+#ifndef BYTE_MATCHER_H
+#define BYTE_MATCHER_H
+
+#include "opencv2/opencv.hpp"
+#include <vector>
+
+using namespace std;
+using namespace cv;
+
+#ifdef __cplusplus
+
+class ByteMatcher
+{
+public:
+	static const int QUERY_BLOCK = 32;		// query rows matched together
+	static const int TRAIN_BLOCK = 512;		// train rows kept in cache for a query block
+
+//------------------------------------match()------------------------------------------
+// find the nearest train descriptor of every query descriptor
+//Precondition: query and train are CV_8U with the same number of columns
+//Postcondition: matches holds one match per query row in query order, with the
+//				 train row of the smallest integer sum, the first of equal ones;
+//				 it is empty if either matrix is empty
+//-------------------------------------------------------------------------------------
+	static void match(const Mat& query, const Mat& train, vector<DMatch>& matches);
+};
+
+#endif /* __cplusplus */
+
+#endif
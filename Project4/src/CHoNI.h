@@ -3,6 +3,7 @@
 #define __OPENCV_CHoNI_H__
 
 #include "RGBSIFT.h"
+#include "IntensityHistogram.h"
 using namespace std;
 using namespace cv;
 #ifdef __cplusplus
@@ -29,9 +30,6 @@ namespace cv
 	protected:
 		virtual void calcSIFTDescriptor(const Mat& img, Point2f ptf, float ori, float scl, int d, int n, float* dst) const;
 
-	private:
-		void calculateIntensity(int band, float bins_per_intensity, int d, int n, float *hist, int radius, float cos_t, float sin_t, Point pt, int rows, int cols, float *CBin, float *RBin, const  Mat& img, int histlen, float *intensity) const;
-		void normalizeHistogram(float *dst, int d, int n) const;
 	};
 
 } /* namespace cv */
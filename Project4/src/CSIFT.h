@@ -23,7 +23,13 @@ namespace cv
 		CV_WRAP int descriptorSize() const;
 
 	protected:
+		// converts the referenced opponent levels to O1/O3, O2/O3
+		virtual void buildDescriptorPyramid(const Mat& image, const std::vector<KeyPoint>& keypoints, int firstOctave, int nOctaves, std::vector<Mat>& pyr) const;
+
 		virtual void calcSIFTDescriptor(const Mat& img, Point2f ptf, float ori, float scl, int d, int n, float* dst) const;
+
+		// the O1/O3 and O2/O3 blocks
+		virtual int descriptorChannels() const;
 	};
 
 } /* namespace cv */
@@ -3,6 +3,7 @@
 #define __OPENCV_COLORSPIN_SIFT_H__
 
 #include "RGBSIFT.h"
+#include "SpinKernel.h"
 using namespace std;
 using namespace cv;
 #ifdef __cplusplus
@@ -26,7 +27,7 @@ namespace cv
 
 	protected:
 		virtual void calcSIFTDescriptor(const Mat& img, Point2f ptf, float ori, float scl, int d, int n, float* dst) const;
-		virtual void calcBand(const Mat& img, float *dst, int band, float *intensity, float *dist, Point pt, int radius, int len, int intensity_bins, int distance_bins, float bins_per_distance, float bins_per_intensity, float alpha, float beta) const;
+		virtual void calcBand(const Mat& img, float *dst, int band, float *intensity, const SpinWindow& window, const int *R, const int *C, const int *index, int len, int intensity_bins, int distance_bins) const;
 		virtual void calcDescriptors(const std::vector<Mat>& gpyr, const std::vector<KeyPoint>& keypoints, Mat& descriptors, int nOctaveLayers, int firstOctave) const;
 		CV_WRAP virtual int descriptorSize() const;
 	};
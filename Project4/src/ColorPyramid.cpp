@@ -0,0 +1,52 @@
+#include "ColorPyramid.h"
+
+std::mutex ColorPyramidCache::cacheLock;
+Mat ColorPyramidCache::cachedImage;
+ColorPyramidKey ColorPyramidCache::cachedKey;
+Ptr<vector<Mat> > ColorPyramidCache::cachedPyramid;
+
+//------------------------------------find()-------------------------------------------
+// look up the colour pyramid of an image
+//Precondition: image is the image passed to the descriptor
+//Postcondition: the cached pyramid is returned if it was built from the same pixels
+//				 with the same parameters, otherwise an empty Ptr is returned
+//-------------------------------------------------------------------------------------
+Ptr<vector<Mat> > ColorPyramidCache::find(const Mat& image, const ColorPyramidKey& key)
+{
+	std::lock_guard<std::mutex> lock(cacheLock);
+
+	if (cachedPyramid.empty() || cachedImage.data != image.data || cachedImage.size() != image.size() ||
+		cachedImage.type() != image.type() || cachedImage.step != image.step)
+		return Ptr<vector<Mat> >();
+
+	if (cachedKey.firstOctave != key.firstOctave || cachedKey.nOctaves != key.nOctaves ||
+		cachedKey.nOctaveLayers != key.nOctaveLayers || cachedKey.sigma != key.sigma)
+		return Ptr<vector<Mat> >();
+
+	return cachedPyramid;
+}
+
+//------------------------------------store()------------------------------------------
+// keep the colour pyramid of an image, replacing the previous one
+//Precondition: pyr was built from image with the parameters in key
+//Postcondition: find() returns pyr for the same image and parameters
+//-------------------------------------------------------------------------------------
+void ColorPyramidCache::store(const Mat& image, const ColorPyramidKey& key, const Ptr<vector<Mat> >& pyr)
+{
+	std::lock_guard<std::mutex> lock(cacheLock);
+	cachedImage = image;
+	cachedKey = key;
+	cachedPyramid = pyr;
+}
+
+//------------------------------------clear()------------------------------------------
+// release the cached pyramid and the image it refers to
+//Precondition: None
+//Postcondition: the cache is empty
+//-------------------------------------------------------------------------------------
+void ColorPyramidCache::clear()
+{
+	std::lock_guard<std::mutex> lock(cacheLock);
+	cachedImage.release();
+	cachedPyramid.release();
+}
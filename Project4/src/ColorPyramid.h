@@ -0,0 +1,74 @@
+//-------------------------------------------------------------------------
+// Name: ColorPyramid.h
+// Description: Cache of the RGB gaussian pyramid of the most recent image.
+//  Blurring and resizing commute with linear colour transforms, so the
+//  colour descriptors share one RGB pyramid per image and derive linear
+//  colour spaces such as opponent colour from its levels with a per-pixel
+//  3x3 matrix (see ColorTransform) instead of blurring a second base
+//  image. The cached pyramid keeps a reference to the source image, so
+//  its pixels cannot be released and reused by another image while the
+//  entry is alive.
+// Methods:
+//			find()
+//			store()
+//			clear()
+//-------------------------------------------------------------------------
+
+#ifndef COLOR_PYRAMID_H
+#define COLOR_PYRAMID_H
+
+#include "opencv2/opencv.hpp"
+#include <mutex>
+#include <vector>
+
+using namespace std;
+using namespace cv;
+
+#ifdef __cplusplus
+
+/*!
+	Parameters a colour pyramid was built with
+*/
+struct ColorPyramidKey
+{
+	int firstOctave;		// -1 if the base image was doubled
+	int nOctaves;			// number of octaves
+	int nOctaveLayers;		// layers per octave
+	double sigma;			// blur of the base image
+};
+
+class ColorPyramidCache
+{
+public:
+//------------------------------------find()-------------------------------------------
+// look up the colour pyramid of an image
+//Precondition: image is the image passed to the descriptor
+//Postcondition: the cached pyramid is returned if it was built from the same pixels
+//				 with the same parameters, otherwise an empty Ptr is returned
+//-------------------------------------------------------------------------------------
+	static Ptr<vector<Mat> > find(const Mat& image, const ColorPyramidKey& key);
+
+//------------------------------------store()------------------------------------------
+// keep the colour pyramid of an image, replacing the previous one
+//Precondition: pyr was built from image with the parameters in key
+//Postcondition: find() returns pyr for the same image and parameters
+//-------------------------------------------------------------------------------------
+	static void store(const Mat& image, const ColorPyramidKey& key, const Ptr<vector<Mat> >& pyr);
+
+//------------------------------------clear()------------------------------------------
+// release the cached pyramid and the image it refers to
+//Precondition: None
+//Postcondition: the cache is empty
+//-------------------------------------------------------------------------------------
+	static void clear();
+
+private:
+	static std::mutex cacheLock;
+	static Mat cachedImage;
+	static ColorPyramidKey cachedKey;
+	static Ptr<vector<Mat> > cachedPyramid;
+};
+
+#endif /* __cplusplus */
+
+#endif
@@ -0,0 +1,239 @@
+#include "ColorTransform.h"
+
+// images below this many pixels are converted on the calling thread
+static const int MIN_PARALLEL_PIXELS = 1 << 16;
+
+// applies a row kernel to a band of rows
+class ColorTransformBody : public ParallelLoopBody
+{
+public:
+	typedef void(*RowKernel)(const float* src, float* dst, int cols);
+
+	ColorTransformBody(const Mat& _src, Mat& _dst, RowKernel _kernel)
+		: src(_src), dst(_dst), kernel(_kernel) {}
+
+	virtual void operator()(const Range& range) const
+	{
+		for (int y = range.start; y < range.end; y++)
+			kernel(src.ptr<float>(y), dst.ptr<float>(y), src.cols);
+	}
+
+private:
+	const Mat& src;
+	Mat& dst;
+	RowKernel kernel;
+};
+
+#if CV_SSE2
+// splits four interleaved 3-channel pixels into one register per channel
+static inline void deinterleave3(const float* src, __m128& c0, __m128& c1, __m128& c2)
+{
+	__m128 a = _mm_loadu_ps(src), b = _mm_loadu_ps(src + 4), c = _mm_loadu_ps(src + 8);
+	c0 = _mm_shuffle_ps(a, _mm_shuffle_ps(b, c, _MM_SHUFFLE(1, 1, 2, 2)), _MM_SHUFFLE(2, 0, 3, 0));
+	c1 = _mm_shuffle_ps(_mm_shuffle_ps(a, b, _MM_SHUFFLE(0, 0, 1, 1)), _mm_shuffle_ps(b, c, _MM_SHUFFLE(2, 2, 3, 3)), _MM_SHUFFLE(2, 0, 2, 0));
+	c2 = _mm_shuffle_ps(_mm_shuffle_ps(a, b, _MM_SHUFFLE(1, 1, 2, 2)), _mm_shuffle_ps(c, c, _MM_SHUFFLE(3, 3, 0, 0)), _MM_SHUFFLE(2, 0, 2, 0));
+}
+
+// writes one register per channel back as four interleaved 3-channel pixels
+static inline void interleave3(float* dst, __m128 c0, __m128 c1, __m128 c2)
+{
+	_mm_storeu_ps(dst, _mm_shuffle_ps(_mm_unpacklo_ps(c0, c1), _mm_shuffle_ps(c2, c0, _MM_SHUFFLE(1, 1, 0, 0)), _MM_SHUFFLE(2, 0, 1, 0)));
+	_mm_storeu_ps(dst + 4, _mm_shuffle_ps(_mm_shuffle_ps(c1, c2, _MM_SHUFFLE(1, 1, 1, 1)), _mm_shuffle_ps(c0, c1, _MM_SHUFFLE(2, 2, 2, 2)), _MM_SHUFFLE(2, 0, 2, 0)));
+	_mm_storeu_ps(dst + 8, _mm_shuffle_ps(_mm_shuffle_ps(c2, c0, _MM_SHUFFLE(3, 3, 2, 2)), _mm_shuffle_ps(c1, c2, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(2, 0, 2, 0)));
+}
+
+// writes two registers as four interleaved 2-channel pixels
+static inline void interleave2(float* dst, __m128 c0, __m128 c1)
+{
+	_mm_storeu_ps(dst, _mm_unpacklo_ps(c0, c1));
+	_mm_storeu_ps(dst + 4, _mm_unpackhi_ps(c0, c1));
+}
+#endif
+
+static void opponentRow(const float* src, float* dst, int cols)
+{
+	int x = 0;
+#if CV_SSE2
+	if (checkHardwareSupport(CV_CPU_SSE2))
+	{
+		__m128 two = _mm_set1_ps(2.f), s2 = _mm_set1_ps(sqrtf(2)), s6 = _mm_set1_ps(sqrtf(6)), s3 = _mm_set1_ps(sqrtf(3));
+		for (; x <= cols - 4; x += 4, src += 12, dst += 12)
+		{
+			__m128 b, g, r;
+			deinterleave3(src, b, g, r);
+			__m128 rg = _mm_add_ps(r, g);
+			interleave3(dst, _mm_div_ps(_mm_sub_ps(r, g), s2), _mm_div_ps(_mm_sub_ps(rg, _mm_mul_ps(two, b)), s6),
+				_mm_div_ps(_mm_add_ps(rg, b), s3));
+		}
+	}
+#endif
+	for (; x < cols; x++, src += 3, dst += 3)
+	{
+		float b = src[0], g = src[1], r = src[2];
+		dst[0] = (r - g) / sqrtf(2);
+		dst[1] = (r + g - 2 * b) / sqrtf(6);
+		dst[2] = (r + g + b) / sqrtf(3);
+	}
+}
+
+static void normalizedRGRow(const float* src, float* dst, int cols)
+{
+	int x = 0;
+#if CV_SSE2
+	if (checkHardwareSupport(CV_CPU_SSE2))
+	{
+		for (; x <= cols - 4; x += 4, src += 12, dst += 12)
+		{
+			__m128 b, g, r;
+			deinterleave3(src, b, g, r);
+			__m128 sum = _mm_add_ps(_mm_add_ps(r, g), b);
+			interleave3(dst, _mm_div_ps(r, sum), _mm_div_ps(g, sum), _mm_setzero_ps());
+		}
+	}
+#endif
+	for (; x < cols; x++, src += 3, dst += 3)
+	{
+		float b = src[0], g = src[1], r = src[2];
+		dst[0] = r / (r + g + b);
+		dst[1] = g / (r + g + b);
+		dst[2] = 0;
+	}
+}
+
+static void cInvariantRow(const float* src, float* dst, int cols)
+{
+	int x = 0;
+#if CV_SSE2
+	if (checkHardwareSupport(CV_CPU_SSE2))
+	{
+		for (; x <= cols - 4; x += 4, src += 12, dst += 8)
+		{
+			__m128 o1, o2, o3;
+			deinterleave3(src, o1, o2, o3);
+			interleave2(dst, _mm_div_ps(o1, o3), _mm_div_ps(o2, o3));
+		}
+	}
+#endif
+	for (; x < cols; x++, src += 3, dst += 2)
+	{
+		dst[0] = src[0] / src[2];
+		dst[1] = src[1] / src[2];
+	}
+}
+
+static void hueSaturationRow(const float* src, float* dst, int cols)
+{
+	int x = 0;
+#if CV_SSE2
+	if (checkHardwareSupport(CV_CPU_SSE2))
+	{
+		__m128 eps = _mm_set1_ps(FLT_EPSILON), signMask = _mm_set1_ps(-0.f), zero = _mm_setzero_ps();
+		__m128 deg120 = _mm_set1_ps(120.f), deg240 = _mm_set1_ps(240.f), deg360 = _mm_set1_ps(360.f);
+		__m128d sixty = _mm_set1_pd(60.);
+		for (; x <= cols - 4; x += 4, src += 12, dst += 8)
+		{
+			__m128 b, g, r;
+			deinterleave3(src, b, g, r);
+			// the operands are in the order that makes max and min pick what std::max and std::min pick
+			__m128 v = _mm_max_ps(b, _mm_max_ps(g, r));
+			__m128 diff = _mm_sub_ps(v, _mm_min_ps(b, _mm_min_ps(g, r)));
+			__m128 s = _mm_div_ps(diff, _mm_add_ps(_mm_andnot_ps(signMask, v), eps));
+
+			// 60 / (diff + FLT_EPSILON) is divided in double precision, two values at a time
+			__m128 de = _mm_add_ps(diff, eps);
+			__m128 scale = _mm_movelh_ps(_mm_cvtpd_ps(_mm_div_pd(sixty, _mm_cvtps_pd(de))),
+				_mm_cvtpd_ps(_mm_div_pd(sixty, _mm_cvtps_pd(_mm_movehl_ps(de, de)))));
+
+			// the first channel equal to the maximum picks the formula, red before green before blue
+			__m128 isR = _mm_cmpeq_ps(v, r), isG = _mm_andnot_ps(isR, _mm_cmpeq_ps(v, g));
+			__m128 isB = _mm_andnot_ps(_mm_or_ps(isR, isG), _mm_castsi128_ps(_mm_set1_epi32(-1)));
+			__m128 h = _mm_or_ps(_mm_and_ps(isR, _mm_mul_ps(_mm_sub_ps(g, b), scale)),
+				_mm_or_ps(_mm_and_ps(isG, _mm_add_ps(_mm_mul_ps(_mm_sub_ps(b, r), scale), deg120)),
+					_mm_and_ps(isB, _mm_add_ps(_mm_mul_ps(_mm_sub_ps(r, g), scale), deg240))));
+			h = _mm_add_ps(h, _mm_and_ps(_mm_cmplt_ps(h, zero), deg360));
+			interleave2(dst, h, s);
+		}
+	}
+#endif
+	for (; x < cols; x++, src += 3, dst += 2)
+	{
+		float b = src[0], g = src[1], r = src[2];
+		float v = std::max(std::max(r, g), b);
+		float vmin = std::min(std::min(r, g), b);
+		float diff = v - vmin;
+
+		float s = diff / (float)(fabs(v) + FLT_EPSILON);
+		diff = (float)(60. / (diff + FLT_EPSILON));
+
+		float h = v == r ? (g - b)*diff : v == g ? (b - r)*diff + 120.f : (r - g)*diff + 240.f;
+		h = h < 0 ? h + 360.f : h;
+
+		dst[0] = h;
+		dst[1] = s;
+	}
+}
+
+//------------------------------------opponent()---------------------------------------
+// convert a BGR image to the opponent colour channels
+//Precondition: bgr is a CV_32FC3 image, dst may be the same image
+//Postcondition: dst is a CV_32FC3 image holding O1, O2, O3
+//-------------------------------------------------------------------------------------
+void ColorTransform::opponent(const Mat& bgr, Mat& dst)
+{
+	run(bgr, dst, CV_32FC3, opponentRow);
+}
+
+//------------------------------------normalizedRG()-----------------------------------
+// convert a BGR image to normalised rg chromaticity
+//Precondition: bgr is a CV_32FC3 image, dst may be the same image
+//Postcondition: dst is a CV_32FC3 image holding r / (r + g + b), g / (r + g + b), 0
+//-------------------------------------------------------------------------------------
+void ColorTransform::normalizedRG(const Mat& bgr, Mat& dst)
+{
+	run(bgr, dst, CV_32FC3, normalizedRGRow);
+}
+
+//------------------------------------cInvariant()-------------------------------------
+// compute the colour invariants of an opponent image
+//Precondition: opp is a CV_32FC3 opponent image
+//Postcondition: dst is a CV_32FC2 image holding O1 / O3 and O2 / O3
+//-------------------------------------------------------------------------------------
+void ColorTransform::cInvariant(const Mat& opp, Mat& dst)
+{
+	run(opp, dst, CV_32FC2, cInvariantRow);
+}
+
+//------------------------------------hueSaturation()----------------------------------
+// compute the hue (degrees) and saturation of a BGR image
+//Precondition: bgr is a CV_32FC3 image
+//Postcondition: dst is a CV_32FC2 image holding hue and saturation
+//-------------------------------------------------------------------------------------
+void ColorTransform::hueSaturation(const Mat& bgr, Mat& dst)
+{
+	run(bgr, dst, CV_32FC2, hueSaturationRow);
+}
+
+//------------------------------------run()--------------------------------------------
+// apply a row kernel to every row of an image, in parallel row bands
+//Precondition: src is a CV_32FC3 image
+//Postcondition: dst is allocated with dstType and filled by the kernel
+//-------------------------------------------------------------------------------------
+void ColorTransform::run(const Mat& src, Mat& dst, int dstType, RowKernel kernel)
+{
+	if (src.type() != CV_32FC3)
+		CV_Error(CV_StsBadArg, "input image must be of type CV_32FC3");
+
+	// in place conversion is only possible when the pixel layout is unchanged
+	if (dst.data == src.data)
+		CV_Assert(dstType == src.type());
+	else
+		dst.create(src.size(), dstType);
+
+	ColorTransformBody body(src, dst, kernel);
+	Range rows(0, src.rows);
+
+	if ((double)src.rows * src.cols < MIN_PARALLEL_PIXELS)
+		body(rows);
+	else
+		parallel_for_(rows, body, (double)src.rows * src.cols / MIN_PARALLEL_PIXELS);
+}
@@ -0,0 +1,71 @@
+//-------------------------------------------------------------------------
+// Name: ColorTransform.h
+// Description: Colour space kernels shared by the colour descriptors.
+//  Every kernel works on floating point images, walks whole rows through
+//  raw pointers and splits the image into row bands that are processed in
+//  parallel. With SSE2 the rows are done four pixels at a time, the
+//  channels of the interleaved pixels split into registers with shuffles.
+//  The per-pixel arithmetic of each kernel is the one the descriptors used
+//  before, in both paths, so their results do not change.
+// Methods:
+//			opponent()
+//			normalizedRG()
+//			cInvariant()
+//			hueSaturation()
+//-------------------------------------------------------------------------
+
+#ifndef COLOR_TRANSFORM_H
+#define COLOR_TRANSFORM_H
+
+#include "opencv2/opencv.hpp"
+
+using namespace std;
+using namespace cv;
+
+#ifdef __cplusplus
+
+class ColorTransform
+{
+public:
+	// a colour transform from one image to another, see the kernels below
+	typedef void(*Kernel)(const Mat& src, Mat& dst);
+
+//------------------------------------opponent()---------------------------------------
+// convert a BGR image to the opponent colour channels
+// O1 = (R - G) / sqrt(2), O2 = (R + G - 2B) / sqrt(6), O3 = (R + G + B) / sqrt(3)
+//Precondition: bgr is a CV_32FC3 image, dst may be the same image
+//Postcondition: dst is a CV_32FC3 image holding O1, O2, O3
+//-------------------------------------------------------------------------------------
+	static void opponent(const Mat& bgr, Mat& dst);
+
+//------------------------------------normalizedRG()-----------------------------------
+// convert a BGR image to normalised rg chromaticity
+//Precondition: bgr is a CV_32FC3 image, dst may be the same image
+//Postcondition: dst is a CV_32FC3 image holding r / (r + g + b), g / (r + g + b), 0
+//-------------------------------------------------------------------------------------
+	static void normalizedRG(const Mat& bgr, Mat& dst);
+
+//------------------------------------cInvariant()-------------------------------------
+// compute the colour invariants of an opponent image
+//Precondition: opp is a CV_32FC3 opponent image
+//Postcondition: dst is a CV_32FC2 image holding O1 / O3 and O2 / O3
+//-------------------------------------------------------------------------------------
+	static void cInvariant(const Mat& opp, Mat& dst);
+
+//------------------------------------hueSaturation()----------------------------------
+// compute the hue (degrees) and saturation of a BGR image, with the same
+// arithmetic as cvtColor(COLOR_BGR2HSV) but without the value plane
+//Precondition: bgr is a CV_32FC3 image
+//Postcondition: dst is a CV_32FC2 image holding hue and saturation
+//-------------------------------------------------------------------------------------
+	static void hueSaturation(const Mat& bgr, Mat& dst);
+
+private:
+	typedef void(*RowKernel)(const float* src, float* dst, int cols);
+
+	static void run(const Mat& src, Mat& dst, int dstType, RowKernel kernel);
+};
+
+#endif /* __cplusplus */
+
+#endif
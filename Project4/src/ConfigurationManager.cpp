@@ -18,6 +18,20 @@ ConfigurationManager::ConfigurationManager(ConfigurationManager &cm) {
 	extractor = cm.extractor;
 	save = cm.save;
 	display = cm.display;
+	cachedSampling = cm.cachedSampling;
+	benchmark = cm.benchmark;
+	fusedExtraction = cm.fusedExtraction;
+	pooledChannels = cm.pooledChannels;
+	octantGradients = cm.octantGradients;
+	maxSamples = cm.maxSamples;
+	matcher = cm.matcher;
+	matcherParams = cm.matcherParams;
+	ratioStrategy = cm.ratioStrategy;
+	mutualStrategy = cm.mutualStrategy;
+	fusionWeights = cm.fusionWeights;
+	guidedRadius = cm.guidedRadius;
+	maxFeatures = cm.maxFeatures;
+	byteDescriptors = cm.byteDescriptors;
 	uniqueHomographies = cm.uniqueHomographies;
 	resetImageNames = cm.resetImageNames;
 	valid = cm.valid;
@@ -37,6 +51,20 @@ ConfigurationManager& ConfigurationManager::operator=(const ConfigurationManager
 		extractor = cm.extractor;
 		save = cm.save;
 		display = cm.display;
+		cachedSampling = cm.cachedSampling;
+		benchmark = cm.benchmark;
+		fusedExtraction = cm.fusedExtraction;
+		pooledChannels = cm.pooledChannels;
+		octantGradients = cm.octantGradients;
+		maxSamples = cm.maxSamples;
+		matcher = cm.matcher;
+		matcherParams = cm.matcherParams;
+		ratioStrategy = cm.ratioStrategy;
+		mutualStrategy = cm.mutualStrategy;
+		fusionWeights = cm.fusionWeights;
+		guidedRadius = cm.guidedRadius;
+		maxFeatures = cm.maxFeatures;
+		byteDescriptors = cm.byteDescriptors;
 		uniqueHomographies = cm.uniqueHomographies;
 		resetImageNames = cm.resetImageNames;
 		valid = cm.valid;
@@ -189,7 +217,7 @@ void ConfigurationManager::setConfiguration(Configuration config, int type) {
 
 		case CONFIG::SAVE:
 
-			if(config.identifier == DISPLAY_IDENTIFIER && config.specs.size() > 0) {
+			if(config.identifier == SAVE_IDENTIFIER && config.specs.size() > 0) {
 				save = (config.specs[0] == TRUE_TOKEN) ? true : false;
 			}
 
@@ -204,14 +232,127 @@ void ConfigurationManager::setConfiguration(Configuration config, int type) {
 			break;
 
 		default:
+			setOption(config);
+	}
+}
+
+
+void ConfigurationManager::setOption(Configuration config) {
+	if(config.specs.empty()) {
+		cout << "There was an error setting a configuration" << endl;
+		optionsValid = false;
+	}
+	else if(config.identifier == SAMPLING_IDENTIFIER) {
+		setSwitch(config.specs[0], EXACT_TOKEN, CACHED_TOKEN, cachedSampling);
+	}
+	else if(config.identifier == BENCHMARK_IDENTIFIER) {
+		setSwitch(config.specs[0], FALSE_TOKEN, TRUE_TOKEN, benchmark);
+	}
+	else if(config.identifier == EXTRACTION_IDENTIFIER) {
+		setSwitch(config.specs[0], SEPARATE_TOKEN, FUSED_TOKEN, fusedExtraction);
+	}
+	else if(config.identifier == CHANNELS_IDENTIFIER) {
+		setSwitch(config.specs[0], STACKED_TOKEN, POOLED_TOKEN, pooledChannels);
+	}
+	else if(config.identifier == GRADIENTS_IDENTIFIER) {
+		setSwitch(config.specs[0], EXACT_TOKEN, OCTANT_TOKEN, octantGradients);
+	}
+	else if(config.identifier == SAMPLES_IDENTIFIER) {
+		istringstream value(config.specs[0]);
+		if(!(value >> maxSamples) || maxSamples < 0) {
+			cout << "There was an error setting a configuration" << endl;
+			maxSamples = 0;
+			optionsValid = false;
+		}
+	}
+	else if(config.identifier == MATCHER_IDENTIFIER) {
+		// the backend name, then its accuracy knobs
+		matcher = config.specs[0];
+		matcherParams.clear();
+		bool known = matcher == BRUTE_TOKEN || matcher == BLOCKED_TOKEN || matcher == PARTIAL_TOKEN || matcher == KDFOREST_TOKEN || matcher == HNSW_TOKEN;
+		for(int i = 1; i < config.specs.size() && known; i++) {
+			istringstream value(config.specs[i]);
+			int param;
+			known = (value >> param) && param > 0;
+			matcherParams.push_back(param);
+		}
+		if(!known) {
+			cout << "There was an error setting a configuration" << endl;
+			matcher = BRUTE_TOKEN;
+			matcherParams.clear();
+			optionsValid = false;
+		}
+	}
+	else if(config.identifier == STRATEGIES_IDENTIFIER) {
+		// nearest neighbour matching is always evaluated, the others are added to it
+		ratioStrategy = mutualStrategy = false;
+		for(int i = 0; i < config.specs.size(); i++) {
+			if(config.specs[i] == RATIO_TOKEN) { ratioStrategy = true; }
+			else if(config.specs[i] == MUTUAL_TOKEN) { mutualStrategy = true; }
+			else if(config.specs[i] != NN_TOKEN) {
+				cout << "There was an error setting a configuration" << endl;
+				optionsValid = false;
+			}
+		}
+	}
+	else if(config.identifier == FUSION_IDENTIFIER) {
+		// the weights every part of a stacked descriptor is tried with
+		fusionWeights.clear();
+		for(int i = 0; i < config.specs.size(); i++) {
+			istringstream value(config.specs[i]);
+			float weight;
+			if(!(value >> weight) || weight < 0) {
+				cout << "There was an error setting a configuration" << endl;
+				fusionWeights.clear();
+				optionsValid = false;
+				break;
+			}
+			fusionWeights.push_back(weight);
+		}
+	}
+	else if(config.identifier == GUIDED_IDENTIFIER) {
+		istringstream value(config.specs[0]);
+		if(!(value >> guidedRadius) || guidedRadius < 0) {
+			cout << "There was an error setting a configuration" << endl;
+			guidedRadius = 0;
+			optionsValid = false;
+		}
+	}
+	else if(config.identifier == FEATURES_IDENTIFIER) {
+		istringstream value(config.specs[0]);
+		if(!(value >> maxFeatures) || maxFeatures < 0) {
 			cout << "There was an error setting a configuration" << endl;
-			valid = false;
+			maxFeatures = 0;
+			optionsValid = false;
+		}
+	}
+	else if(config.identifier == PRECISION_IDENTIFIER) {
+		setSwitch(config.specs[0], FLOAT_TOKEN, UINT8_TOKEN, byteDescriptors);
+	}
+	else {
+		cout << "There was an error setting a configuration" << endl;
+		optionsValid = false;
+	}
+}
+
+
+// sets a two-valued option; any other token is an error and leaves the option off
+void ConfigurationManager::setSwitch(const string &spec, const string &offToken, const string &onToken, bool &flag) {
+	if(spec == onToken) { flag = true; }
+	else if(spec == offToken) { flag = false; }
+	else {
+		cout << "There was an error setting a configuration" << endl;
+		flag = false;
+		optionsValid = false;
 	}
 }
 
 
 void ConfigurationManager::validate() {
 
+	// an optional line that could not be read rejects the whole configuration
+	if(!optionsValid) { valid = false; return; }
+
 	if(projectDirectory == EMPTY_STRING) { valid = false; return; }
 	if(dataset == EMPTY_STRING) { valid = false; return; }
 	if(imageset.empty()) { valid = false; return; }
@@ -21,6 +21,24 @@ static const string DEFAULT_CONFIG_DIRECTORY = "config/";
 static const string TWO_UP = "../../";
 static const string PROJECT_DIR_INDICATOR_TOKEN = "/46x";
 static const string TRUE_TOKEN = "true";
+static const string FALSE_TOKEN = "false";
+static const string EXACT_TOKEN = "exact";
+static const string CACHED_TOKEN = "cached";
+static const string SEPARATE_TOKEN = "separate";
+static const string FUSED_TOKEN = "fused";
+static const string STACKED_TOKEN = "stacked";
+static const string POOLED_TOKEN = "pooled";
+static const string OCTANT_TOKEN = "octant";
+static const string BRUTE_TOKEN = "brute";
+static const string BLOCKED_TOKEN = "blocked";
+static const string PARTIAL_TOKEN = "partial";
+static const string KDFOREST_TOKEN = "kdforest";
+static const string HNSW_TOKEN = "hnsw";
+static const string NN_TOKEN = "nn";
+static const string RATIO_TOKEN = "ratio";
+static const string MUTUAL_TOKEN = "mutual";
+static const string FLOAT_TOKEN = "float";
+static const string UINT8_TOKEN = "uint8";
 static const string EMPTY_STRING = "";
 
 static const char ID_DELIM = ':';
@@ -34,7 +52,8 @@ enum CONFIG {
 	DESCRIPTOR,
 	EXTRACTOR,
 	SAVE,
-	DISPLAY
+	DISPLAY,
+	OPTIONS		// lines from here on are optional and may appear in any order
 };
 
 
@@ -61,6 +80,18 @@ public:
 	const string EXTRACTOR_IDENTIFIER = "extractor";
 	const string SAVE_IDENTIFIER = "save";
 	const string DISPLAY_IDENTIFIER = "display";
+	const string SAMPLING_IDENTIFIER = "sampling";
+	const string BENCHMARK_IDENTIFIER = "benchmark";
+	const string EXTRACTION_IDENTIFIER = "extraction";
+	const string CHANNELS_IDENTIFIER = "channels";
+	const string GRADIENTS_IDENTIFIER = "gradients";
+	const string SAMPLES_IDENTIFIER = "samples";
+	const string MATCHER_IDENTIFIER = "matcher";
+	const string STRATEGIES_IDENTIFIER = "strategies";
+	const string FUSION_IDENTIFIER = "fusion";
+	const string GUIDED_IDENTIFIER = "guided";
+	const string FEATURES_IDENTIFIER = "features";
+	const string PRECISION_IDENTIFIER = "precision";
 
 	const string OXFORD_DATASET = "oxford";
 
@@ -74,6 +105,20 @@ public:
 	string extractor;
 	bool save = false;
 	bool display = false;
+	bool cachedSampling = false;
+	bool benchmark = false;
+	bool fusedExtraction = false;
+	bool pooledChannels = false;
+	bool octantGradients = false;
+	int maxSamples = 0;
+	string matcher = BRUTE_TOKEN;
+	vector<int> matcherParams;
+	bool ratioStrategy = false;
+	bool mutualStrategy = false;
+	vector<float> fusionWeights;
+	float guidedRadius = 0;
+	int maxFeatures = 0;
+	bool byteDescriptors = false;
 	bool uniqueHomographies = false;
 	bool resetImageNames = false;
 	bool isRunningFromConsole;
@@ -88,10 +133,13 @@ public:
 	bool isValid() const { return(valid); }
 private:
 	bool valid = false;
+	bool optionsValid = true;
 	string configFile;
 
 	vector<Configuration> readConfigurationFile();
 	void setConfiguration(Configuration config, int type);
+	void setOption(Configuration config);
+	void setSwitch(const string &spec, const string &offToken, const string &onToken, bool &flag);
 	void validate();
 	void setProjectDirectory();
 	void setIsRunningFromConsole();
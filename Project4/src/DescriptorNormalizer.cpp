@@ -0,0 +1,237 @@
+#include "DescriptorNormalizer.h"
+#include "VanillaSIFT.h"
+
+// matrices with fewer rows are normalised on the calling thread
+static const int MIN_PARALLEL_ROWS = 256;
+
+// squared length of a span, summed in order so the result matches a plain loop
+static float sumSquares(const float* src, int len)
+{
+	float sum = 0;
+	for (int k = 0; k < len; k++)
+		sum += src[k] * src[k];
+	return sum;
+}
+
+#if CV_SSE2
+// squared lengths of four spans at once, lane j summing rows[j] in order, so every lane
+// matches sumSquares() of its row
+static __m128 sumSquares4(float* const* rows, int len)
+{
+	__m128 sum = _mm_setzero_ps();
+	int k = 0;
+	for (; k <= len - 4; k += 4)
+	{
+		__m128 x0 = _mm_loadu_ps(rows[0] + k), x1 = _mm_loadu_ps(rows[1] + k);
+		__m128 x2 = _mm_loadu_ps(rows[2] + k), x3 = _mm_loadu_ps(rows[3] + k);
+		_MM_TRANSPOSE4_PS(x0, x1, x2, x3);
+		sum = _mm_add_ps(sum, _mm_mul_ps(x0, x0));
+		sum = _mm_add_ps(sum, _mm_mul_ps(x1, x1));
+		sum = _mm_add_ps(sum, _mm_mul_ps(x2, x2));
+		sum = _mm_add_ps(sum, _mm_mul_ps(x3, x3));
+	}
+	for (; k < len; k++)
+	{
+		__m128 x = _mm_setr_ps(rows[0][k], rows[1][k], rows[2][k], rows[3][k]);
+		sum = _mm_add_ps(sum, _mm_mul_ps(x, x));
+	}
+	return sum;
+}
+#endif
+
+// clip a span at thr
+static void clip(float* dst, int len, float thr)
+{
+	int k = 0;
+#if CV_SSE2
+	if (checkHardwareSupport(CV_CPU_SSE2))
+	{
+		// thr first, so a NaN entry is kept as std::min keeps it
+		__m128 t = _mm_set1_ps(thr);
+		for (; k <= len - 4; k += 4)
+			_mm_storeu_ps(dst + k, _mm_min_ps(t, _mm_loadu_ps(dst + k)));
+	}
+#endif
+	for (; k < len; k++)
+		dst[k] = std::min(dst[k], thr);
+}
+
+// clip a span at thr and return its squared length after clipping
+static float clipSpan(float* dst, int len, float thr)
+{
+	clip(dst, len, thr);
+	return sumSquares(dst, len);
+}
+
+// final rescale, free of dependences between entries so it can be vectorised
+static void scaleSpan(float* dst, int len, float weight, float scale)
+{
+	int k = 0;
+#if CV_SSE2
+	if (checkHardwareSupport(CV_CPU_SSE2))
+	{
+		__m128 w = _mm_set1_ps(weight), s = _mm_set1_ps(scale);
+		for (; k <= len - 4; k += 4)
+			_mm_storeu_ps(dst + k, _mm_mul_ps(_mm_mul_ps(w, _mm_loadu_ps(dst + k)), s));
+	}
+#endif
+	for (; k < len; k++)
+		dst[k] = weight * dst[k] * scale;
+}
+
+static float finalScale(float sum, float lengthFactor)
+{
+	return VanillaSIFT::SIFT_INT_DESCR_FCTR / std::max(std::sqrt(lengthFactor * sum), FLT_EPSILON);
+}
+
+// runs normalize() on a band of rows
+class NormalizeRowsBody : public ParallelLoopBody
+{
+public:
+	NormalizeRowsBody(Mat& _descriptors, DescriptorNormalizer::Policy _policy, int _blocks, float _lengthFactor, float _weight)
+		: descriptors(_descriptors), policy(_policy), blocks(_blocks), lengthFactor(_lengthFactor), weight(_weight) {}
+
+	virtual void operator()(const Range& range) const
+	{
+		int i = range.start, len = descriptors.cols;
+#if CV_SSE2
+		// the whole-vector policies have one ordered sum per step, so four rows share
+		// the steps with a row in every lane
+		if (checkHardwareSupport(CV_CPU_SSE2) && blocks == 1 &&
+			(policy == DescriptorNormalizer::UNCLIPPED || policy == DescriptorNormalizer::GLOBAL))
+		{
+			for (; i <= range.end - 4; i += 4)
+			{
+				float* rows[4] = { descriptors.ptr<float>(i), descriptors.ptr<float>(i + 1),
+					descriptors.ptr<float>(i + 2), descriptors.ptr<float>(i + 3) };
+				float sums[4];
+				_mm_storeu_ps(sums, sumSquares4(rows, len));
+				int j;
+				if (policy == DescriptorNormalizer::GLOBAL)
+				{
+					for (j = 0; j < 4; j++)
+						clip(rows[j], len, std::sqrt(sums[j])*VanillaSIFT::SIFT_DESCR_MAG_THR);
+					_mm_storeu_ps(sums, sumSquares4(rows, len));
+				}
+				for (j = 0; j < 4; j++)
+					scaleSpan(rows[j], len, weight, finalScale(sums[j], lengthFactor));
+			}
+		}
+#endif
+		for (; i < range.end; i++)
+			DescriptorNormalizer::normalize(descriptors.ptr<float>(i), len, policy, blocks, lengthFactor, weight);
+	}
+
+private:
+	Mat& descriptors;
+	DescriptorNormalizer::Policy policy;
+	int blocks;
+	float lengthFactor, weight;
+};
+
+//------------------------------------normalize()--------------------------------------
+// clip and rescale one descriptor
+//Precondition: len is a multiple of blocks and blocks <= MAX_BLOCKS
+//Postcondition: dst is clipped and rescaled
+//-------------------------------------------------------------------------------------
+void DescriptorNormalizer::normalize(float* dst, int len, Policy policy, int blocks, float lengthFactor, float weight)
+{
+	CV_Assert(blocks > 0 && blocks <= MAX_BLOCKS && len % blocks == 0);
+
+	int blockLen = len / blocks;
+	float sums[MAX_BLOCKS];
+	int b;
+
+	switch (policy)
+	{
+	case UNCLIPPED:
+		scaleSpan(dst, len, weight, finalScale(sumSquares(dst, len), lengthFactor));
+		break;
+
+	case GLOBAL:
+	{
+		float thr = std::sqrt(sumSquares(dst, len))*VanillaSIFT::SIFT_DESCR_MAG_THR;
+		scaleSpan(dst, len, weight, finalScale(clipSpan(dst, len, thr), lengthFactor));
+		break;
+	}
+
+	case PER_BLOCK:
+		for (b = 0; b < blocks; b++)
+		{
+			float* block = dst + b*blockLen;
+			float thr = std::sqrt(sumSquares(block, blockLen))*VanillaSIFT::SIFT_DESCR_MAG_THR;
+			scaleSpan(block, blockLen, weight, finalScale(clipSpan(block, blockLen, thr), lengthFactor));
+		}
+		break;
+
+	case MAX_BLOCK_THRESHOLD:
+	case MAX_BLOCK:
+	{
+		float longest = 0;
+		for (b = 0; b < blocks; b++)
+			longest = std::max(longest, sumSquares(dst + b*blockLen, blockLen));
+		float thr = std::sqrt(longest)*VanillaSIFT::SIFT_DESCR_MAG_THR;
+
+		float sum;
+		if (policy == MAX_BLOCK_THRESHOLD)
+			sum = clipSpan(dst, len, thr);
+		else
+		{
+			for (b = 0; b < blocks; b++)
+				sums[b] = clipSpan(dst + b*blockLen, blockLen, thr);
+			sum = sums[0];
+			for (b = 1; b < blocks; b++)
+				sum = std::max(sum, sums[b]);
+		}
+		scaleSpan(dst, len, weight, finalScale(sum, lengthFactor));
+		break;
+	}
+
+	default:
+		CV_Error(CV_StsBadArg, "unknown normalisation policy");
+	}
+}
+
+//------------------------------------normalizeRows()----------------------------------
+// clip and rescale every row of a descriptor matrix, in parallel row bands
+//Precondition: descriptors is a CV_32F matrix, the other parameters are as for normalize()
+//Postcondition: every row of descriptors is clipped and rescaled on its own
+//-------------------------------------------------------------------------------------
+void DescriptorNormalizer::normalizeRows(Mat& descriptors, Policy policy, int blocks, float lengthFactor, float weight)
+{
+	if (descriptors.empty())
+		return;
+
+	CV_Assert(descriptors.type() == CV_32F);
+
+	NormalizeRowsBody body(descriptors, policy, blocks, lengthFactor, weight);
+	Range rows(0, descriptors.rows);
+
+	if (descriptors.rows < MIN_PARALLEL_ROWS)
+		body(rows);
+	else
+		parallel_for_(rows, body, (double)descriptors.rows / MIN_PARALLEL_ROWS);
+}
+
+//------------------------------------pool()-------------------------------------------
+// sum the channel blocks of a stacked descriptor and normalise the sum like a single
+// channel descriptor
+//Precondition: len is a multiple of channels, dst does not overlap stacked
+//Postcondition: dst holds the pooled descriptor
+//-------------------------------------------------------------------------------------
+void DescriptorNormalizer::pool(const float* stacked, int len, int channels, float* dst)
+{
+	CV_Assert(channels > 0 && len % channels == 0);
+
+	int blockLen = len / channels;
+
+	std::copy(stacked, stacked + blockLen, dst);
+	for (int c = 1; c < channels; c++)
+	{
+		const float* block = stacked + c*blockLen;
+		for (int k = 0; k < blockLen; k++)
+			dst[k] += block[k];
+	}
+
+	normalize(dst, blockLen);
+}
@@ -0,0 +1,79 @@
+//-------------------------------------------------------------------------
+// Name: DescriptorNormalizer.h
+// Description: The clip and renormalise step shared by the descriptors.
+//  A descriptor is normalised, entries above SIFT_DESCR_MAG_THR of its
+//  length are clipped, and it is rescaled to a length of
+//  SIFT_INT_DESCR_FCTR. Stacked colour descriptors differ only in how the
+//  blocks of the vector (one per channel) enter the threshold and the
+//  final scale, which is selected by a policy.
+// Methods:
+//			normalize()
+//			normalizeRows()
+//			pool()
+//-------------------------------------------------------------------------
+
+#ifndef DESCRIPTOR_NORMALIZER_H
+#define DESCRIPTOR_NORMALIZER_H
+
+#include "opencv2/opencv.hpp"
+
+using namespace std;
+using namespace cv;
+
+#ifdef __cplusplus
+
+class DescriptorNormalizer
+{
+public:
+	enum Policy
+	{
+		UNCLIPPED,				// rescale the whole vector, no clipping
+		GLOBAL,					// one threshold and one scale for the whole vector
+		PER_BLOCK,				// every block is clipped and scaled on its own
+		MAX_BLOCK_THRESHOLD,	// threshold from the longest block, one scale for the whole vector
+		MAX_BLOCK				// threshold and scale from the longest block
+	};
+
+	static const int MAX_BLOCKS = 4;
+
+//------------------------------------normalize()--------------------------------------
+// clip and rescale one descriptor
+//Precondition: the following parameters must be correclty defined.
+//parameters:
+	//dst: descriptor of len floats
+	//len: descriptor length, a multiple of blocks
+	//policy: how the blocks enter the threshold and the scale
+	//blocks: number of equal blocks, at most MAX_BLOCKS
+	//lengthFactor: the squared length is multiplied by this before the final scale,
+	//				stacked descriptors use the number of channels
+	//weight: factor applied to every entry with the final scale
+//Postcondition: dst is clipped and rescaled
+//-------------------------------------------------------------------------------------
+	static void normalize(float* dst, int len, Policy policy = GLOBAL, int blocks = 1,
+		float lengthFactor = 1.f, float weight = 1.f);
+
+//------------------------------------normalizeRows()----------------------------------
+// clip and rescale every row of a descriptor matrix, in parallel row bands
+//Precondition: descriptors is a CV_32F matrix, the other parameters are as for normalize()
+//Postcondition: every row of descriptors is clipped and rescaled on its own
+//-------------------------------------------------------------------------------------
+	static void normalizeRows(Mat& descriptors, Policy policy = GLOBAL, int blocks = 1,
+		float lengthFactor = 1.f, float weight = 1.f);
+
+//------------------------------------pool()-------------------------------------------
+// sum the channel blocks of a stacked descriptor and normalise the sum like a single
+// channel descriptor
+//Precondition: the following parameters must be correclty defined.
+//parameters:
+	//stacked: finished descriptor of len floats, channels equal blocks
+	//len: length of the stacked descriptor
+	//channels: number of blocks
+	//dst: len / channels floats, must not overlap stacked
+//Postcondition: dst holds the pooled descriptor
+//-------------------------------------------------------------------------------------
+	static void pool(const float* stacked, int len, int channels, float* dst);
+};
+
+#endif /* __cplusplus */
+
+#endif
@@ -101,6 +101,14 @@ struct DescriptorType {
 			return NONE;
         }
     }
+	// Helper to convert from enum types back to the string codes
+	static string getDescriptorName(DESC_TYPES type)
+	{
+		static const char* names[] = { "SIFT", "SURF", "RGBSIFT", "OpponentSIFT", "HoNC", "HoNC3", "HoWH",
+			"HoNI", "SPIN", "CSPIN", "RGSIFT", "CSIFT", "CHoNI", "PSIFT" };
+		return (type >= 0 && type < NONE) ? names[type] : "NONE";
+	}
+
 	//destructor
 	~DescriptorType() {}
 
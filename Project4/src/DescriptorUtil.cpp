@@ -7,6 +7,7 @@ This class provides utilities for computing key points and different types of de
 #include "DescriptorUtil.h"
 #include <iostream>
 #include <fstream>
+#include <iomanip>
 using namespace std;
 using namespace cv::xfeatures2d;
 
@@ -105,110 +106,138 @@ void DescriptorUtil::writeKeyPoints(vector<KeyPoint> *kpts, string *imgNames, in
 }
 
 void DescriptorUtil::normalizeDescriptors(Mat &descriptors) {
-	float nrm2 = 0;
-	for (int j = 0; j < descriptors.rows; j++) {
-		int len = descriptors.cols;
-		
-		for (int k = 0; k < len; k++)
-			nrm2 += powf(descriptors.at<float>(j, k), 2);
-
-		const float SIFT_INT_DESCR_FCTR = 512.f;
-		nrm2 = SIFT_INT_DESCR_FCTR / std::max(std::sqrt(nrm2), FLT_EPSILON);
-
-		for (int k = 0; k < len; k++)
-		{
-			descriptors.at<float>(j, k) = (descriptors.at<float>(j, k) * nrm2);
-		}
-	}
+	// every row is scaled to the length of the SIFT-family descriptors on its own
+	DescriptorNormalizer::normalizeRows(descriptors, DescriptorNormalizer::UNCLIPPED);
 }
 
-// Computes the descriptors of a specified type for an image, given a set of keypoints
-Mat DescriptorUtil::computeDescriptors(Mat& img, vector<KeyPoint> &keypoints, DESC_TYPES type)
+// Creates the extractor of a SIFT-family descriptor type with its default settings
+static Ptr<VanillaSIFT> createExtractor(DESC_TYPES type)
 {
-    Mat descriptors;
-    vector<KeyPoint> kpts(keypoints.begin(), keypoints.end());
-    
-
     // Lowe's SIFT Descriptor: descriptor size = 128
     if (type == _SIFT) {
-		Ptr<VanillaSIFT> sift = VanillaSIFT::create();
-		sift->compute(img, kpts, descriptors);
+		return VanillaSIFT::create();
     }
-	// SURF Descriptor: descriptor size = 64
-	else if (type == _SURF) {
-		// Ptr<SURF> surf = SURF::create(100.0, 4, 3, true, false);	//extended SURF doesn't seem to improve things!
-		// SURF appears to use scale a bit differently. Increase scale some to improve results.
-		for (int i = 0; i < kpts.size(); i++) kpts[i].size *= 2.0;
-		Ptr<SURF> surf = SURF::create();
-		surf->compute(img, kpts, descriptors);
-		normalizeDescriptors(descriptors);	// Want all methods to have same vector length
-	}
 	// RGB SIFT: descriptor size = 384
 	else if (type == _RGBSIFT) {
-		Ptr<RGBSIFT> rgbsift = RGBSIFT::create();
-		rgbsift->compute(img, kpts, descriptors);
+		return RGBSIFT::create();
 	}
 	// Opponent SIFT: descriptor size = 384
 	else if (type == _OpponentSIFT) {
-		Ptr<OpponentSIFT>oppenentsift = OpponentSIFT::create();
-		oppenentsift->compute(img, kpts, descriptors);
+		return OpponentSIFT::create();
 	}
 	// Color histogram SIFT : descriptor size = 128
 	else if (type == _HoNC) {
-		Ptr<HoNC> honc = HoNC::create();
-		honc->compute(img, kpts, descriptors);
+		return HoNC::create();
 	}
 	// Color histogram SIFT with 3 x 3 x 3 color hist: descriptor size = 432
 	else if (type == _HoNC3) {
-		Ptr<HoNC3> honc3 = HoNC3::create();
-		honc3->compute(img, kpts, descriptors);
+		return HoNC3::create();
 	}
 	// Hue weighted by saturation SIFT : descriptor size = 128
 	else if (type == _HoWH) {
-		Ptr<HoWH> howh = HoWH::create();
-		howh->compute(img, kpts, descriptors);
+		return HoWH::create();
 	}
 	// Gresycale texture SIFT: descriptor size = 128
 	else if (type == _HoNI){
-		Ptr<HoNI> honi = HoNI::create();
-		honi->compute(img, kpts, descriptors);
+		return HoNI::create();
 	}
 	// RGBIntensity: descriptor size = 384
 	else if (type == _CHoNI) {
-		Ptr<CHoNI> choni = CHoNI::create();
-		choni->compute(img, kpts, descriptors);
+		return CHoNI::create();
 	}
 	// rgSIFT: descriptor size = 256 (384, but last 128 are all zero with current implementation)
 	else if (type == _RGSIFT) {
-		Ptr<RGSIFT> rgsift = RGSIFT::create();
-		rgsift->compute(img, kpts, descriptors);
+		return RGSIFT::create();
 	}
 	// CSIFT: descriptor size = 256
 	else if (type == _CSIFT) {
-		Ptr<CSIFT> csift = CSIFT::create();
-		csift->compute(img, kpts, descriptors);
+		return CSIFT::create();
 	}
 	// SPIN: descriptor size = 128
 	else if (type == _SPIN){
-		Ptr<SPIN> spin = SPIN::create();
-		spin->compute(img, kpts, descriptors);
+		return SPIN::create();
 	}
 	// CSPIN: descriptor size = 384
 	else if (type == _CSPIN){
-		Ptr<CSPIN> cspin = CSPIN::create();
-		cspin->compute(img, kpts, descriptors);
+		return CSPIN::create();
 	}
 	else if (type == _PSIFT) {
-		Ptr<PSIFT> psift = PSIFT::create();
-		psift->compute(img, kpts, descriptors);
+		return PSIFT::create();
+	}
+	else if (type == _SURF || type == NONE) {
+		return Ptr<VanillaSIFT>();
+	}
+	CV_Error(CV_StsBadArg, "Unrecognized type in computeDescriptors");
+	return Ptr<VanillaSIFT>();
+}
+
+// Computes the descriptors of a specified type for an image, given a set of keypoints
+Mat DescriptorUtil::computeDescriptors(Mat& img, vector<KeyPoint> &keypoints, DESC_TYPES type, bool pooled)
+{
+    Mat descriptors;
+    vector<KeyPoint> kpts(keypoints.begin(), keypoints.end());
+    
+
+	// SURF Descriptor: descriptor size = 64
+	if (type == _SURF) {
+		// Ptr<SURF> surf = SURF::create(100.0, 4, 3, true, false);	//extended SURF doesn't seem to improve things!
+		// SURF appears to use scale a bit differently. Increase scale some to improve results.
+		for (int i = 0; i < kpts.size(); i++) kpts[i].size *= 2.0;
+		Ptr<SURF> surf = SURF::create();
+		surf->compute(img, kpts, descriptors);
+		normalizeDescriptors(descriptors);	// Want all methods to have same vector length
 	}
 	else if (type == NONE) { }
 	else {
-		CV_Error(CV_StsBadArg, "Unrecognized type in computeDescriptors");
+		Ptr<VanillaSIFT> descriptor = createDescriptor(type, pooled);
+		descriptor->compute(img, kpts, descriptors);
 	}
     return descriptors;
 }
 
+// Creates the extractor of a SIFT-family descriptor type; SURF and NONE have none
+Ptr<VanillaSIFT> DescriptorUtil::createDescriptor(DESC_TYPES type, bool pooled)
+{
+    Ptr<VanillaSIFT> descriptor = createExtractor(type);
+    if (!descriptor.empty() && pooled)
+        descriptor->setChannelPooling(true);
+    return descriptor;
+}
+
+// Computes the descriptors of several types for an image and stacks them in the order given.
+// The SIFT-family types are computed together in one pass over the keypoints; widths receives
+// the number of columns of each type
+Mat DescriptorUtil::computeFusedDescriptors(Mat& img, vector<KeyPoint> &keypoints, const vector<DESC_TYPES>& types, vector<int>& widths, bool pooled)
+{
+	FusedDescriptor fused;
+	vector<Mat> separate(types.size());
+	int cols = 0;
+
+	widths.assign(types.size(), 0);
+	for (size_t i = 0; i < types.size(); i++) {
+		Ptr<VanillaSIFT> descriptor = createDescriptor(types[i], pooled);
+
+		if (!descriptor.empty()) {
+			fused.add(descriptor, cols);
+			widths[i] = descriptor->outputSize();
+		}
+		else {
+			separate[i] = computeDescriptors(img, keypoints, types[i], pooled);
+			widths[i] = separate[i].cols;
+		}
+		cols += widths[i];
+	}
+
+	Mat descriptors((int)keypoints.size(), cols, CV_32F);
+	for (size_t i = 0, col = 0; i < types.size(); col += widths[i], i++) {
+		if (!separate[i].empty())
+			separate[i].copyTo(descriptors.colRange((int)col, (int)col + widths[i]));
+	}
+	fused.compute(img, keypoints, descriptors);
+
+	return descriptors;
+}
+
 // Merge multiple descriptors. There should be an equal number of descriptors in the matrices
 // descriptorArray contains all descriptors
 // num is the number of descriptors
@@ -218,31 +247,36 @@ Mat DescriptorUtil::mergeDescriptors(Mat* descriptorArray, int num)
 	int newrows = descriptorArray[0].rows, newcols = 0;
 	for (int i = 0; i < num; i++)
 		newcols += descriptorArray[i].cols;
-	//create an empty descriptor
-	Mat descriptors(0, newcols, descriptorArray[0].type());
-	for (int i = 0; i < descriptorArray[0].rows; ++i)
+	//create an empty descriptor, of whatever type the parts are
+	Mat descriptors = Mat::zeros(newrows, newcols, descriptorArray[0].type());
+	for (int descriptorIndex = 0, col = 0; descriptorIndex < num; col += descriptorArray[descriptorIndex].cols, descriptorIndex++)
 	{
-		vector<float> mergedRow;
-		for (int descriptorIndex = 0; descriptorIndex < num; descriptorIndex++)
+		//only merge rows when the descripor has equavalent row numbers
+		if (descriptorArray[descriptorIndex].rows == newrows)
 		{
-			//only merge rows when the descripor has equavalent row numbers
-			if (descriptorArray[0].rows == descriptorArray[descriptorIndex].rows)
-			{
-				// Get the corresponding rows
-				Mat m1 = descriptorArray[descriptorIndex].row(i);
-				for (int j = 0; j < descriptorArray[descriptorIndex].cols; ++j)
-					mergedRow.push_back(m1.at<float>(j));
-			}
+			CV_Assert(descriptorArray[descriptorIndex].type() == descriptors.type());
+			descriptorArray[descriptorIndex].copyTo(descriptors.colRange(col, col + descriptorArray[descriptorIndex].cols));
 		}
-		// Create a matrix
-		Mat x(mergedRow);
-		Mat y = x.t();
-		descriptors.push_back(y);
-		mergedRow.clear();
 	}
     return descriptors;
 }
 
+// Rounds descriptors to bytes. The SIFT-family descriptors are scaled by SIFT_INT_DESCR_FCTR so that their
+// entries fit in a byte, and the few that do not are saturated. SURF rows are normalised to the same length,
+// so their signed entries lie within +-SIFT_INT_DESCR_FCTR; they are scaled into +-127 and shifted by 128,
+// which keeps every entry and scales all distances between SURF descriptors alike
+Mat DescriptorUtil::quantizeDescriptors(const Mat &descriptors, DESC_TYPES type)
+{
+	Mat quantized;
+	if (descriptors.empty() || descriptors.type() == CV_8U)
+		return descriptors;
+	if (type == _SURF)
+		descriptors.convertTo(quantized, CV_8U, 127.0 / VanillaSIFT::SIFT_INT_DESCR_FCTR, 128.0);
+	else
+		descriptors.convertTo(quantized, CV_8U);
+	return quantized;
+}
+
 // Writes descriptors to a file (.xml or .yml)
 void DescriptorUtil::writeDescriptors(Mat *&descriptors, string *imgNames, int numImgs, string filename)
 {
@@ -256,17 +290,138 @@ void DescriptorUtil::writeDescriptors(Mat *&descriptors, string *imgNames, int n
     fs.release();
 }
 
-// Matches descriptors from two different images, evaluates the matches using the provided homography, and writes the results out to a file
-void DescriptorUtil::match(const Mat &descr1, Mat &descr2, 
+// Writes the precision and recall lines of the matches a strategy keeps, best key first, and returns how many are correct
+static int writeStrategy(const string &filename, const vector<DMatch> &kept, const vector<float> &keys, const GroundTruth &truth)
+{
+	vector<int> order(kept.size());
+	for (size_t i = 0; i < order.size(); i++) order[i] = (int)i;
+	stable_sort(order.begin(), order.end(), [&keys](int a, int b) { return keys[a] < keys[b]; });
+
+	ofstream outFile(filename.c_str());
+	outFile << kept.size() << "\t" << truth.inBoundsCount() << "\t" << truth.matchableCount() << endl;
+	int numCorrect = 0;
+	outFile << 0 << "\t" << 0 << endl;
+	for (size_t i = 0; i < order.size(); i++) {
+		const DMatch &m = kept[order[i]];
+		if (truth.inBounds(m.queryIdx) && truth.isCorrect(m.queryIdx, m.trainIdx)) {
+			++numCorrect;
+		}
+		outFile << numCorrect << "\t" << i + 1 << endl;
+	}
+	outFile.close();
+	return numCorrect;
+}
+
+// Whether two weightings of the parts differ only by a common factor, which scales every combined distance
+// alike and so leaves the matches and their order unchanged. The weights of each are made to sum to 1 first
+static bool isProportional(const vector<float> &a, const vector<float> &b)
+{
+	float sumA = 0, sumB = 0;
+	for (size_t k = 0; k < a.size(); k++) {
+		sumA += a[k];
+		sumB += b[k];
+	}
+	for (size_t k = 0; k < a.size(); k++) {
+		if (fabs(a[k] / sumA - b[k] / sumB) > 1e-6f) return false;
+	}
+	return true;
+}
+
+// Matches the parts of a stacked descriptor separately and evaluates every weighting of their distances that can be made
+// from the weight grid, writing one results file per weighting with the weights appended to the file name. A weighting
+// proportional to one evaluated before it gives the same results and is skipped
+void DescriptorUtil::matchLateFusion(const vector<Mat> &parts1, const vector<Mat> &parts2, const GroundTruth &truth,
+									 const string outFilename, ostream &log, const vector<float> &weightGrid)
+{
+	if (parts1.empty() || weightGrid.empty()) return;
+
+	// the distances of every part are measured once, the weightings only add them up
+	LateFusionMatcher fusion(parts1, parts2);
+	string base = outFilename.substr(0, outFilename.rfind('.'));
+	vector<int> index(fusion.parts(), 0);
+	vector<float> weights(fusion.parts());
+	vector<vector<float> > evaluated;
+	vector<DMatch> matches;
+
+	bool more = true;
+	while (more) {
+		bool anyWeight = false;
+		stringstream label;
+		for (int k = 0; k < fusion.parts(); k++) {
+			weights[k] = weightGrid[index[k]];
+			anyWeight = anyWeight || weights[k] > 0;
+			label << (k > 0 ? "_" : "") << weights[k];
+		}
+
+		bool repeated = false;
+		for (size_t e = 0; anyWeight && !repeated && e < evaluated.size(); e++) {
+			repeated = isProportional(weights, evaluated[e]);
+		}
+
+		if (anyWeight && !repeated) {
+			evaluated.push_back(weights);
+			fusion.match(weights, matches);
+			vector<float> distances(matches.size());
+			for (size_t i = 0; i < matches.size(); i++) distances[i] = matches[i].distance;
+			int numCorrect = writeStrategy(base + "_w" + label.str() + ".txt", matches, distances, truth);
+			log << "\t" << setw(3) << numCorrect << " correct matches with weights " << label.str() << endl;
+		}
+
+		// next weighting, the last part changing fastest
+		int k = fusion.parts() - 1;
+		while (k >= 0 && ++index[k] == (int)weightGrid.size()) {
+			index[k--] = 0;
+		}
+		more = k >= 0;
+	}
+}
+
+// Matches descriptors from two different images, evaluates the matches against the ground truth of the image pair, and writes the results out to a file
+void DescriptorUtil::match(const NNQuery &query, Mat &descr2, 
 					  const vector<KeyPoint> &kpts1, const vector<KeyPoint> &kpts2, const Mat &img1, const Mat &img2, 
-					  const Mat &homography, const string outFilename, bool drawMatches)
+					  const GroundTruth &truth, const string outFilename, ostream &log, bool drawMatches, const Ptr<NNMatcher>& matcher,
+					  bool ratioStrategy, bool mutualStrategy, float guidedRadius)
 {
     // matching descriptors
-	srand(1);   // ensure random numbers used in matcher are repeatable
-    // FlannBasedMatcher matcher;
-	BFMatcher matcher;
+	Ptr<NNMatcher> backend = matcher.empty() ? NNMatcher::create(BRUTE_MATCHER) : matcher;
     vector<DMatch> matches;
-    matcher.match(descr1, descr2, matches);
+
+	// the other strategies need the runner-up of every query and the nearest query of every train
+	// descriptor, which one pass over the distances gives along with the exact nearest neighbours
+	// guided matching only looks near where the homography maps each keypoint, and so do its strategies
+	vector<DMatch> exact;
+	vector<float> secondDistances;
+	vector<int> reverseMatches;
+	bool twoWay = ratioStrategy || mutualStrategy;
+	bool guided = guidedRadius > 0;
+	if (twoWay && guided) {
+		GuidedMatcher::matchTwoWay(query.descriptors, descr2, truth.projections(), kpts2, guidedRadius, exact, secondDistances, reverseMatches);
+	} else if (twoWay) {
+		Mat train32 = descr2;
+		if (descr2.type() != CV_32F) {
+			descr2.convertTo(train32, CV_32F);
+		}
+		BlockMatcher::matchTwoWay(query.converted, train32, exact, secondDistances, reverseMatches, query.squaredNorms);
+	}
+
+	if (guided && twoWay) {
+		matches = exact;
+	} else if (guided) {
+		GuidedMatcher::match(query.descriptors, descr2, truth.projections(), kpts2, guidedRadius, matches);
+	} else if (twoWay && backend->isExact() && query.descriptors.type() == CV_32F) {
+		matches = exact;
+	} else {
+		backend->match(query, descr2, matches);
+	}
+
+	// an approximate backend is scored against exact matching
+	double recall = -1;
+	if (!guided && !backend->isExact()) {
+		if (!twoWay) {
+			NNMatcher::create(BLOCKED_MATCHER)->match(query, descr2, exact);
+		}
+		recall = NNMatcher::recall(matches, exact);
+	}
     int totalMatches = (int)matches.size();
     sort(matches.begin(), matches.end(), [](const DMatch &m1, const DMatch &m2) {
         return m1.distance < m2.distance;
@@ -278,34 +433,18 @@ void DescriptorUtil::match(const Mat &descr1, Mat &descr2,
     int outBounds = 0;
 	int matchesToDisplay = 200;
     vector<char> matchesMask( totalMatches, 0 );
+
     for (int i = 0; i < totalMatches; ++i) {
 		if (i < matchesToDisplay) matchesMask[i] = 1; else matchesMask[i] = 0;
-        Point p1 = kpts1[matches[i].queryIdx].pt; // image 1 point
-        Point p2 = kpts2[matches[i].trainIdx].pt; // image 2 point
-        Mat p1Mat = (Mat_<double>(3, 1) << (double)p1.x, (double)p1.y, 1.0);
-        Mat p2Mat = (Mat_<double>(3, 1) << (double)p2.x, (double)p2.y, 1.0);
-
-		// checking reverse direction, too!
-		Mat p1Mat2 = (Mat_<double>(3, 1) << (double)p1.x, (double)p1.y, 1.0);
-		Mat p2Mat2 = (Mat_<double>(3, 1) << (double)p2.x, (double)p2.y, 1.0);
-		
-
-        // if (norm(p2 - H * p1 / H.z)) < 2 * p2.size
-        p1Mat = homography * p1Mat;
-        p1Mat /= p1Mat.at<double>(2, 0);
-        double x = p1Mat.at<double>(0, 0);
-        double y = p1Mat.at<double>(1, 0);
+		int query = matches[i].queryIdx, train = matches[i].trainIdx;
+        Point p1 = kpts1[query].pt; // image 1 point
+        Point p2 = kpts2[train].pt; // image 2 point
+
         // Check for out of bounds
-        if (x < 0 || x > img2.cols || y < 0 || y > img2.rows) {
+        if (!truth.inBounds(query)) {
             outBounds++;
         } else {
-            Mat res = p2Mat - p1Mat;
-			p2Mat2 = homography.inv() * p2Mat2;
-			p2Mat2 /= p2Mat2.at<double>(2, 0);
-			Mat res2 = p2Mat2 - p1Mat2;
-			if (norm(res) < kpts2[matches[i].trainIdx].size  && norm(res2) < kpts1[matches[i].queryIdx].size) {
-				correct[i] = true;
-			}
+			correct[i] = truth.isCorrect(query, train);
 
 			if (debug && i < matchesToDisplay) printf("%3d: %4d %4d - %4d %4d: ", i, p1.x, p1.y, p2.x, p2.y);
 			if (debug && i < matchesToDisplay) {
@@ -315,7 +454,13 @@ void DescriptorUtil::match(const Mat &descr1, Mat &descr2,
     }
 
     ofstream outFile(outFilename.c_str());
-	outFile << totalMatches << "\t" << (kpts1.size() - outBounds) << endl;
+	// queries with nothing in reach of a guided search have no match, so the count comes from the ground truth;
+	// the keypoints with a true correspondence are the most correct matches any descriptor can reach
+	outFile << totalMatches << "\t" << (guided ? (size_t)truth.inBoundsCount() : kpts1.size() - outBounds) << "\t" << truth.matchableCount();
+	if (recall >= 0) {
+		outFile << "\t" << recall;
+	}
+	outFile << endl;
 
 	// Find precision and recall values by traversing match list and considering matches in order of distance
 	int numCorrect = 0; 
@@ -333,8 +478,36 @@ void DescriptorUtil::match(const Mat &descr1, Mat &descr2,
 
     outFile.close();
 
-	cout << ">> Output results to: " << outFilename << endl;
-	printf("\t%3d correct matches\n", numCorrect);
+	log << ">> Output results to: " << outFilename << endl;
+	log << "\t" << setw(3) << numCorrect << " correct matches" << endl;
+	if (recall >= 0) {
+		log << "\t" << backend->name() << " nearest neighbour recall " << fixed << setprecision(4) << recall << endl;
+	}
+
+	string strategyBase = outFilename.substr(0, outFilename.rfind('.'));
+	if (ratioStrategy) {
+		// every match is kept, ranked by the ratio of its distance to the runner-up's
+		vector<float> ratios(exact.size());
+		for (size_t i = 0; i < exact.size(); i++) {
+			float second = secondDistances[i];
+			ratios[i] = (second > 0 && second < FLT_MAX) ? exact[i].distance / second : 1.f;
+		}
+		int ratioCorrect = writeStrategy(strategyBase + "_ratio.txt", exact, ratios, truth);
+		log << "\t" << setw(3) << ratioCorrect << " correct matches with the ratio test" << endl;
+	}
+	if (mutualStrategy) {
+		// only matches that are also the nearest in the other direction are kept, ranked by distance
+		vector<DMatch> mutual;
+		vector<float> distances;
+		for (size_t i = 0; i < exact.size(); i++) {
+			if (reverseMatches[exact[i].trainIdx] == exact[i].queryIdx) {
+				mutual.push_back(exact[i]);
+				distances.push_back(exact[i].distance);
+			}
+		}
+		int mutualCorrect = writeStrategy(strategyBase + "_mutual.txt", mutual, distances, truth);
+		log << "\t" << setw(3) << mutualCorrect << " correct matches of " << mutual.size() << " mutual nearest neighbours" << endl;
+	}
 
     // drawing the results
     if (drawMatches) {
@@ -23,6 +23,12 @@ This class provides utilities for computing key points and different types of de
 #include "PSIFT.h"
 #include "CSIFT.h"
 #include "HoNC3.h"
+#include "FusedDescriptor.h"
+#include "NNMatcher.h"
+#include "BlockMatcher.h"
+#include "LateFusionMatcher.h"
+#include "GuidedMatcher.h"
+#include "GroundTruth.h"
 #include <opencv2\features2d.hpp>
 #include <opencv2/opencv.hpp>
 #include "opencv2\xfeatures2d\nonfree.hpp"  //3.0 version
@@ -45,17 +51,39 @@ public:
     // Writes key points to a file (.xml or .yml)
     void writeKeyPoints(vector<KeyPoint> *kpts, string *imgNames, int numImgs, string filename);
 
-    // Computes the descriptors of a specified type for an image, given a set of keypoints
-    Mat computeDescriptors(Mat& img, vector<KeyPoint> &kpts, DESC_TYPES type);
+    // Computes the descriptors of a specified type for an image, given a set of keypoints.
+    // With pooled set, the channels of colour descriptors are summed into one block
+    Mat computeDescriptors(Mat& img, vector<KeyPoint> &kpts, DESC_TYPES type, bool pooled = false);
+
+    // Creates the extractor of a SIFT-family descriptor type; SURF and NONE have none
+    static Ptr<VanillaSIFT> createDescriptor(DESC_TYPES type, bool pooled = false);
+
+    // Computes and stacks several descriptor types, computing the SIFT-family ones in one pass
+    Mat computeFusedDescriptors(Mat& img, vector<KeyPoint> &kpts, const vector<DESC_TYPES>& types, vector<int>& widths, bool pooled = false);
 
     // Merge multiple descriptors. There should be an equal number of descriptors in the matrices
     Mat mergeDescriptors(Mat* descriptorArray, int num);
 
+    // Rounds the descriptors of a type to CV_8U with saturation, a quarter of their float size
+    static Mat quantizeDescriptors(const Mat &descriptors, DESC_TYPES type);
+
     // Writes descriptors to a file (.xml or .yml)
     void writeDescriptors(Mat *&descriptors, string *imgNames, int numImgs, string filename);
 
-    // Matches descriptors from two different images, evaluates the matches using the provided homography, and writes the results out to a file
-    void match(const Mat &descr1, Mat &descr2, const vector<KeyPoint> &kpts1, const vector<KeyPoint> &kpts2, const Mat &img1, const Mat &img2, const Mat &homography, const string outFilename, bool drawMatches = false);
+    // Matches descriptors from two different images, evaluates the matches against the ground truth of the image pair, and writes the results out to a file.
+    // The nearest neighbours come from the given backend, BFMatcher if there is none. An approximate backend also has its recall
+    // against exact matching written to the file. The ratio test and mutual nearest neighbour strategies, when asked for, are
+    // evaluated from the same distance pass and written next to it with _ratio and _mutual appended to the file name.
+    // The descriptors of the first image are prepared by NNMatcher::prepare(), so they can be shared by several pairs.
+    // With a guided radius, each descriptor is only compared with those of the keypoints within that many pixels of where
+    // the homography maps it, instead of using the backend, and the ratio test and mutual check only look at those keypoints as well.
+    // What is reported about the pair goes to log, so pairs matched at the same time can be reported one after the other
+    void match(const NNQuery &query, Mat &descr2, const vector<KeyPoint> &kpts1, const vector<KeyPoint> &kpts2, const Mat &img1, const Mat &img2, const GroundTruth &truth, const string outFilename, ostream &log, bool drawMatches = false, const Ptr<NNMatcher>& matcher = Ptr<NNMatcher>(), bool ratioStrategy = false, bool mutualStrategy = false, float guidedRadius = 0);
+
+    // Matches the parts of a stacked descriptor separately and evaluates every weighting of their distances that can be made
+    // from the weight grid, writing one results file per weighting with the weights appended to the file name. Weightings
+    // proportional to an earlier one are skipped, since they give the same matches. What is reported goes to log, as with match()
+    void matchLateFusion(const vector<Mat> &parts1, const vector<Mat> &parts2, const GroundTruth &truth, const string outFilename, ostream &log, const vector<float> &weightGrid);
 
 	void normalizeDescriptors(Mat &descriptors);
 };
@@ -0,0 +1,83 @@
+#include "FusedDescriptor.h"
+
+//------------------------------------add()--------------------------------------------
+// append a component descriptor
+//Precondition: column + component->outputSize() does not exceed the output width
+//Postcondition: compute() fills columns [column, column + outputSize()) of every
+//				 output row with the component
+//-------------------------------------------------------------------------------------
+void FusedDescriptor::add(const Ptr<VanillaSIFT>& component, int column)
+{
+	components.push_back(component);
+	columns.push_back(column);
+}
+
+//------------------------------------size()-------------------------------------------
+// returns the number of components
+//Precondition: None
+//Postcondition: the number of components added is returned
+//-------------------------------------------------------------------------------------
+int FusedDescriptor::size() const
+{
+	return (int)components.size();
+}
+
+//------------------------------------compute()----------------------------------------
+// describe the keypoints with every component in one pass
+//Precondition: the following parameters must be correclty defined.
+//parameters:
+	//image: 8-bit color image
+	//keypoints: keypoints to describe, as produced by the feature extractor
+	//descriptors: CV_32F matrix with one row per keypoint, already allocated
+//Postcondition: the columns of every component are assigned
+//-------------------------------------------------------------------------------------
+void FusedDescriptor::compute(const Mat& image, const vector<KeyPoint>& keypoints, Mat& descriptors) const
+{
+	if (image.empty() || image.depth() != CV_8U)
+		CV_Error(CV_StsBadArg, "image is empty or has incorrect depth (!=CV_8U)");
+
+	CV_Assert(descriptors.type() == CV_32F && descriptors.rows == (int)keypoints.size());
+
+	if (keypoints.empty() || components.empty())
+		return;
+
+	int count = (int)components.size();
+	vector<vector<Mat> > pyramids(count);
+	vector<int> firstOctaves(count);
+
+	for (int c = 0; c < count; c++)
+	{
+		CV_Assert(columns[c] + components[c]->outputSize() <= descriptors.cols);
+
+		int nOctaves;
+		components[c]->providedOctaveRange(keypoints, firstOctaves[c], nOctaves);
+		components[c]->buildDescriptorPyramid(image, keypoints, firstOctaves[c], nOctaves, pyramids[c]);
+	}
+
+	// every component of a keypoint asks for the same window, so only the first one lists it
+	SamplingPatternCache::setWindowSharing(true);
+
+	try
+	{
+		vector<KeyPoint> keypoint(1);
+		for (int i = 0; i < descriptors.rows; i++)
+		{
+			keypoint[0] = keypoints[i];
+			float* row = descriptors.ptr<float>(i);
+
+			for (int c = 0; c < count; c++)
+			{
+				// a one row header over the component's columns of the output row
+				Mat dst(1, components[c]->outputSize(), CV_32F, row + columns[c]);
+				components[c]->calcDescriptors(pyramids[c], keypoint, dst, components[c]->nOctaveLayers, firstOctaves[c]);
+			}
+		}
+	}
+	catch (...)
+	{
+		SamplingPatternCache::setWindowSharing(false);
+		throw;
+	}
+
+	SamplingPatternCache::setWindowSharing(false);
+}
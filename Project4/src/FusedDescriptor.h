@@ -0,0 +1,63 @@
+//-------------------------------------------------------------------------
+// Name: FusedDescriptor.h
+// Description: Computes the components of a stacked descriptor (such as
+//  RGBSIFT+HoNC+HoWH+HoNI) in one pass over the keypoints. Each component
+//  builds its descriptor pyramid once; then, for every keypoint, all
+//  components describe it one after another, writing straight into their
+//  columns of the concatenated output row. Since the components see the
+//  same keypoint geometry, the rotated sampling window is listed by the
+//  first component and copied by the others instead of being recomputed.
+// Methods:
+//			add()
+//			size()
+//			compute()
+//-------------------------------------------------------------------------
+
+#ifndef FUSED_DESCRIPTOR_H
+#define FUSED_DESCRIPTOR_H
+
+#include "VanillaSIFT.h"
+#include <vector>
+
+using namespace std;
+using namespace cv;
+
+#ifdef __cplusplus
+
+class FusedDescriptor
+{
+public:
+//------------------------------------add()--------------------------------------------
+// append a component descriptor
+//Precondition: column + component->outputSize() does not exceed the output width
+//Postcondition: compute() fills columns [column, column + outputSize()) of every
+//				 output row with the component
+//-------------------------------------------------------------------------------------
+	void add(const Ptr<VanillaSIFT>& component, int column);
+
+//------------------------------------size()-------------------------------------------
+// returns the number of components
+//Precondition: None
+//Postcondition: the number of components added is returned
+//-------------------------------------------------------------------------------------
+	int size() const;
+
+//------------------------------------compute()----------------------------------------
+// describe the keypoints with every component in one pass
+//Precondition: the following parameters must be correclty defined.
+//parameters:
+	//image: 8-bit color image
+	//keypoints: keypoints to describe, as produced by the feature extractor
+	//descriptors: CV_32F matrix with one row per keypoint, already allocated
+//Postcondition: the columns of every component are assigned
+//-------------------------------------------------------------------------------------
+	void compute(const Mat& image, const vector<KeyPoint>& keypoints, Mat& descriptors) const;
+
+private:
+	vector<Ptr<VanillaSIFT> > components;
+	vector<int> columns;
+};
+
+#endif /* __cplusplus */
+
+#endif
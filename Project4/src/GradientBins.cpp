@@ -0,0 +1,127 @@
+#include "GradientBins.h"
+
+bool GradientBins::octantBinning = false;
+
+// atan(t) over one octant, t in [0, 1], as a fraction of the octant:
+// t + t*(1 - t)*(ATAN_C0 + ATAN_C1*t), within 0.09 degrees of the exact angle
+static const float ATAN_C0 = 0.3116f;
+static const float ATAN_C1 = 0.0844f;
+
+//------------------------------------setOctantBinning()-------------------------------
+// select the orientation kernel for every descriptor in the process
+//Precondition: None
+//Postcondition: compute() uses the octant kernel if octant is true, otherwise
+//				 fastAtan2()
+//-------------------------------------------------------------------------------------
+void GradientBins::setOctantBinning(bool octant)
+{
+	octantBinning = octant;
+}
+
+//------------------------------------isOctantBinning()--------------------------------
+// returns whether the octant kernel is used
+//Precondition: None
+//Postcondition: the kernel selection is returned
+//-------------------------------------------------------------------------------------
+bool GradientBins::isOctantBinning()
+{
+	return octantBinning;
+}
+
+//------------------------------------compute()----------------------------------------
+// convert the gradients of the window samples to magnitudes and orientation bins
+//Precondition: the following parameters must be correclty defined.
+//parameters:
+	//X, Y: horizontal and vertical differences of the samples, Y pointing up
+	//len: number of samples
+	//ori: angle(degree) of the keypoint relative to the coordinates, clockwise
+	//n: number of orientation bins over 360 degrees
+	//Obin: receives the orientation bin of each sample, in (-n, n); must not overlap X or Y
+	//Mag: receives the gradient magnitude of each sample; may be X or Y
+//Postcondition: Obin and Mag are assigned. Obin[k] is not wrapped, so
+//				 floor(Obin[k]) must still be brought into [0, n)
+//-------------------------------------------------------------------------------------
+void GradientBins::compute(const float* X, const float* Y, int len, float ori, int n, float* Obin, float* Mag)
+{
+	float bins_per_rad = n / 360.f;
+
+	if (!octantBinning)
+	{
+		// the angle has to be taken before Mag overwrites X or Y
+		hal::fastAtan2(Y, X, Obin, len, true);
+		hal::magnitude(X, Y, Mag, len);
+		for (int k = 0; k < len; k++)
+			Obin[k] = (Obin[k] - ori)*bins_per_rad;
+		return;
+	}
+
+	float offset = ori*bins_per_rad, binsPerOctant = n / 8.f;
+	for (int k = 0; k < len; k += BLOCK_SIZE)
+		computeOctant(X + k, Y + k, std::min(BLOCK_SIZE, len - k), offset, binsPerOctant, Obin + k, Mag + k);
+}
+
+//------------------------------------computeOctant()----------------------------------
+// the octant kernel of compute() for at most BLOCK_SIZE samples
+//Precondition: len <= BLOCK_SIZE
+//Postcondition: Obin and Mag are assigned
+//-------------------------------------------------------------------------------------
+void GradientBins::computeOctant(const float* X, const float* Y, int len, float offset, float binsPerOctant,
+	float* Obin, float* Mag)
+{
+	// Mag may be the input itself, so the block is computed into local arrays
+	// first and copied out at the end
+	float obin[BLOCK_SIZE], mag[BLOCK_SIZE];
+	int k = 0;
+
+#if CV_SSE2
+	if (checkHardwareSupport(CV_CPU_SSE2))
+	{
+		__m128 signMask = _mm_set1_ps(-0.f), zero = _mm_setzero_ps(), one = _mm_set1_ps(1.f);
+		__m128 two = _mm_set1_ps(2.f), four = _mm_set1_ps(4.f), eight = _mm_set1_ps(8.f);
+		__m128 eps = _mm_set1_ps((float)DBL_EPSILON), c0 = _mm_set1_ps(ATAN_C0), c1 = _mm_set1_ps(ATAN_C1);
+		__m128 scale = _mm_set1_ps(binsPerOctant), shift = _mm_set1_ps(offset);
+		for (; k <= len - 4; k += 4)
+		{
+			__m128 x = _mm_loadu_ps(X + k), y = _mm_loadu_ps(Y + k);
+			__m128 ax = _mm_andnot_ps(signMask, x), ay = _mm_andnot_ps(signMask, y);
+			// ay first, so min and max pick what std::min and std::max pick
+			__m128 t = _mm_div_ps(_mm_min_ps(ay, ax), _mm_add_ps(_mm_max_ps(ay, ax), eps));
+
+			__m128 a = _mm_add_ps(t, _mm_mul_ps(_mm_mul_ps(t, _mm_sub_ps(one, t)), _mm_add_ps(c0, _mm_mul_ps(c1, t))));
+			__m128 m = _mm_cmpgt_ps(ay, ax);
+			a = _mm_or_ps(_mm_and_ps(m, _mm_sub_ps(two, a)), _mm_andnot_ps(m, a));
+			m = _mm_cmplt_ps(x, zero);
+			a = _mm_or_ps(_mm_and_ps(m, _mm_sub_ps(four, a)), _mm_andnot_ps(m, a));
+			m = _mm_cmplt_ps(y, zero);
+			a = _mm_or_ps(_mm_and_ps(m, _mm_sub_ps(eight, a)), _mm_andnot_ps(m, a));
+			a = _mm_sub_ps(a, _mm_and_ps(_mm_cmpge_ps(a, eight), eight));
+
+			_mm_storeu_ps(obin + k, _mm_sub_ps(_mm_mul_ps(a, scale), shift));
+			_mm_storeu_ps(mag + k, _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y))));
+		}
+	}
+#endif
+	for (; k < len; k++)
+	{
+		float x = X[k], y = Y[k];
+		float ax = std::abs(x), ay = std::abs(y);
+		float t = std::min(ax, ay) / (std::max(ax, ay) + (float)DBL_EPSILON);
+
+		// angle in octants, first the one next to the larger axis, then mirrored
+		// into the right quadrant and half plane
+		float a = t + t*(1.f - t)*(ATAN_C0 + ATAN_C1*t);
+		a = ay > ax ? 2.f - a : a;
+		a = x < 0 ? 4.f - a : a;
+		a = y < 0 ? 8.f - a : a;
+		a = a >= 8.f ? a - 8.f : a;
+
+		obin[k] = a*binsPerOctant - offset;
+		mag[k] = std::sqrt(x*x + y*y);
+	}
+
+	for (k = 0; k < len; k++)
+	{
+		Obin[k] = obin[k];
+		Mag[k] = mag[k];
+	}
+}
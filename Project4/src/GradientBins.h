@@ -0,0 +1,74 @@
+//-------------------------------------------------------------------------
+// Name: GradientBins.h
+// Description: Gradient-to-bin kernel of the SIFT-family descriptors. For
+//  every sample of the descriptor window it turns the pixel differences
+//  dx, dy into the gradient magnitude and the fractional orientation bin
+//  relative to the keypoint orientation. By default this goes through
+//  fastAtan2() and magnitude() and converts the angle to a bin afterwards.
+//  The octant kernel finds the bin from dx, dy directly: the signs and the
+//  larger of |dx|, |dy| give the octant, and a small rational function of
+//  min/max gives the position inside it. It is a single branch free loop
+//  with an SSE2 path, four samples at a time.
+// Methods:
+//			setOctantBinning()
+//			isOctantBinning()
+//			compute()
+//-------------------------------------------------------------------------
+
+#ifndef GRADIENT_BINS_H
+#define GRADIENT_BINS_H
+
+#include "opencv2/opencv.hpp"
+
+using namespace cv;
+
+#ifdef __cplusplus
+
+class GradientBins
+{
+public:
+	static const int BLOCK_SIZE = 64;		// samples converted per block of the octant kernel
+
+//------------------------------------setOctantBinning()-------------------------------
+// select the orientation kernel for every descriptor in the process
+//Precondition: None
+//Postcondition: compute() uses the octant kernel if octant is true, otherwise
+//				 fastAtan2()
+//-------------------------------------------------------------------------------------
+	static void setOctantBinning(bool octant);
+
+//------------------------------------isOctantBinning()--------------------------------
+// returns whether the octant kernel is used
+//Precondition: None
+//Postcondition: the kernel selection is returned
+//-------------------------------------------------------------------------------------
+	static bool isOctantBinning();
+
+//------------------------------------compute()----------------------------------------
+// convert the gradients of the window samples to magnitudes and orientation bins
+//Precondition: the following parameters must be correclty defined.
+//parameters:
+	//X, Y: horizontal and vertical differences of the samples, Y pointing up
+	//len: number of samples
+	//ori: angle(degree) of the keypoint relative to the coordinates, clockwise
+	//n: number of orientation bins over 360 degrees
+	//Obin: receives the orientation bin of each sample, in (-n, n); must not overlap X or Y
+	//Mag: receives the gradient magnitude of each sample; may be X or Y
+//Postcondition: Obin and Mag are assigned. Obin[k] is not wrapped, so
+//				 floor(Obin[k]) must still be brought into [0, n)
+//-------------------------------------------------------------------------------------
+	static void compute(const float* X, const float* Y, int len, float ori, int n, float* Obin, float* Mag);
+
+private:
+	static bool octantBinning;
+
+//------------------------------------computeOctant()----------------------------------
+// the octant kernel of compute() for at most BLOCK_SIZE samples
+//-------------------------------------------------------------------------------------
+	static void computeOctant(const float* X, const float* Y, int len, float offset, float binsPerOctant,
+		float* Obin, float* Mag);
+};
+
+#endif /* __cplusplus */
+
+#endif
@@ -0,0 +1,138 @@
+#include "GroundTruth.h"
+#include <algorithm>
+#include <climits>
+#include <cmath>
+
+// Maps the keypoint locations, rounded to pixels, through a homography. Each entry holds x/z, y/z and z/z,
+// computed in the order the 3x3 matrix product and the division of a Mat use, so the distances built from
+// them are the same as with one Mat per keypoint
+static void projectKeyPoints(const vector<KeyPoint>& kpts, const Mat& homography, vector<Point3d>& projected)
+{
+	double m[9];
+	for (int k = 0; k < 9; k++)
+		m[k] = homography.at<double>(k / 3, k % 3);
+
+	projected.resize(kpts.size());
+	for (size_t i = 0; i < kpts.size(); i++) {
+		Point p = kpts[i].pt;
+		double x = (double)p.x, y = (double)p.y;
+		double X = m[0] * x + m[1] * y + m[2] * 1.0;
+		double Y = m[3] * x + m[4] * y + m[5] * 1.0;
+		double Z = m[6] * x + m[7] * y + m[8] * 1.0;
+		double scale = 1. / Z;
+		projected[i] = Point3d(X * scale, Y * scale, Z * scale);
+	}
+}
+
+GroundTruth::GroundTruth() : rowStart(1, 0), insideCount(0), matchable(0) {}
+
+//------------------------------------GroundTruth()------------------------------------
+// find the true correspondences of an image pair
+//Precondition: the following parameters must be correclty defined.
+//parameters:
+	//kpts1: keypoints of the first image
+	//kpts2: keypoints of the second image
+	//homography: 3x3 CV_64F map from the first image to the second
+	//imageSize: size of the second image
+//Postcondition: every pair of keypoints that correspond is recorded
+//-------------------------------------------------------------------------------------
+GroundTruth::GroundTruth(const vector<KeyPoint>& kpts1, const vector<KeyPoint>& kpts2, const Mat& homography, Size imageSize)
+	: inside(kpts1.size(), 0), rowStart(kpts1.size() + 1, 0), insideCount(0), matchable(0)
+{
+	// every keypoint is projected once, image 1 forward and image 2 back through the inverse
+	vector<Point3d> forward, backward;
+	projectKeyPoints(kpts1, homography, forward);
+	projectKeyPoints(kpts2, homography.inv(), backward);
+	projected.resize(kpts1.size());
+	for (size_t q = 0; q < kpts1.size(); q++)
+		projected[q] = Point2d(forward[q].x, forward[q].y);
+
+	// a keypoint of image 2 can only correspond to a projection closer than its size
+	// along x, so the ones to test are found in a window of the keypoints sorted by x
+	vector<pair<int, int> > byX(kpts2.size());
+	float maxSize = 0;
+	for (size_t t = 0; t < kpts2.size(); t++) {
+		byX[t] = make_pair(Point(kpts2[t].pt).x, (int)t);
+		maxSize = std::max(maxSize, kpts2[t].size);
+	}
+	std::sort(byX.begin(), byX.end());
+
+	for (size_t q = 0; q < kpts1.size(); q++) {
+		rowStart[q] = (int)trains.size();
+		const Point3d& h1 = forward[q];
+		if (h1.x < 0 || h1.x > imageSize.width || h1.y < 0 || h1.y > imageSize.height)
+			continue;
+		inside[q] = 1;
+		insideCount++;
+
+		// a projection at infinity counts as inside but corresponds to nothing
+		if (h1.x != h1.x || h1.y != h1.y)
+			continue;
+
+		Point p1 = kpts1[q].pt;
+		vector<pair<int, int> >::const_iterator it = std::lower_bound(byX.begin(), byX.end(),
+			make_pair((int)std::floor(h1.x - maxSize), INT_MIN));
+		for (; it != byX.end() && it->first <= h1.x + maxSize; ++it) {
+			int t = it->second;
+			Point p2 = kpts2[t].pt;
+
+			// checking reverse direction, too!
+			const Point3d& h2 = backward[t];
+			double dx = p2.x - h1.x, dy = p2.y - h1.y, dz = 1.0 - h1.z;
+			double dx2 = h2.x - p1.x, dy2 = h2.y - p1.y, dz2 = h2.z - 1.0;
+			if (std::sqrt(dx * dx + dy * dy + dz * dz) < kpts2[t].size && std::sqrt(dx2 * dx2 + dy2 * dy2 + dz2 * dz2) < kpts1[q].size)
+				trains.push_back(t);
+		}
+
+		std::sort(trains.begin() + rowStart[q], trains.end());
+		if ((int)trains.size() > rowStart[q])
+			matchable++;
+	}
+	rowStart[kpts1.size()] = (int)trains.size();
+}
+
+//------------------------------------projections()------------------------------------
+// where the keypoints of the first image land in the second one
+//Precondition: None
+//Postcondition: one position per keypoint of the first image is returned, in the
+//				 order of kpts1
+//-------------------------------------------------------------------------------------
+const vector<Point2d>& GroundTruth::projections() const
+{
+	return projected;
+}
+
+//------------------------------------inBounds()---------------------------------------
+// returns whether a keypoint of the first image maps inside the second one
+//Precondition: query indexes kpts1
+//Postcondition: the flag is returned
+//-------------------------------------------------------------------------------------
+bool GroundTruth::inBounds(int query) const
+{
+	return inside[query] != 0;
+}
+
+//------------------------------------isCorrect()--------------------------------------
+// returns whether two keypoints correspond
+//Precondition: query indexes kpts1 and train indexes kpts2
+//Postcondition: true is returned if matching them is correct
+//-------------------------------------------------------------------------------------
+bool GroundTruth::isCorrect(int query, int train) const
+{
+	return std::binary_search(trains.begin() + rowStart[query], trains.begin() + rowStart[query + 1], train);
+}
+
+int GroundTruth::inBoundsCount() const
+{
+	return insideCount;
+}
+
+int GroundTruth::matchableCount() const
+{
+	return matchable;
+}
+
+int GroundTruth::correspondenceCount() const
+{
+	return (int)trains.size();
+}
@@ -0,0 +1,99 @@
+//-------------------------------------------------------------------------
+// Name: GroundTruth.h
+// Description: The true correspondences between the keypoints of an image
+//  pair. Whether a match is correct depends only on the keypoint positions
+//  and sizes and on the homography between the images, not on the
+//  descriptor, so the table is built once per image pair and shared by
+//  every descriptor type that is matched on it. A keypoint of the first
+//  image corresponds to a keypoint of the second when each one lies within
+//  the size of the other after being mapped through the homography, in
+//  either direction. Keypoints of the first image that map outside the
+//  second one have no correspondence.
+// Methods:
+//			GroundTruth()
+//			projections()
+//			inBounds()
+//			isCorrect()
+//			inBoundsCount()
+//			matchableCount()
+//			correspondenceCount()
+//-------------------------------------------------------------------------
+
+#ifndef GROUND_TRUTH_H
+#define GROUND_TRUTH_H
+
+#include "opencv2/opencv.hpp"
+#include <vector>
+
+using namespace std;
+using namespace cv;
+
+#ifdef __cplusplus
+
+class GroundTruth
+{
+public:
+	GroundTruth();
+
+//------------------------------------GroundTruth()------------------------------------
+// find the true correspondences of an image pair
+//Precondition: the following parameters must be correclty defined.
+//parameters:
+	//kpts1: keypoints of the first image
+	//kpts2: keypoints of the second image
+	//homography: 3x3 CV_64F map from the first image to the second
+	//imageSize: size of the second image
+//Postcondition: every pair of keypoints that correspond is recorded
+//-------------------------------------------------------------------------------------
+	GroundTruth(const vector<KeyPoint>& kpts1, const vector<KeyPoint>& kpts2, const Mat& homography, Size imageSize);
+
+//------------------------------------projections()------------------------------------
+// where the keypoints of the first image land in the second one
+//Precondition: None
+//Postcondition: one position per keypoint of the first image is returned, in the
+//				 order of kpts1
+//-------------------------------------------------------------------------------------
+	const vector<Point2d>& projections() const;
+
+//------------------------------------inBounds()---------------------------------------
+// returns whether a keypoint of the first image maps inside the second one
+//Precondition: query indexes kpts1
+//Postcondition: the flag is returned
+//-------------------------------------------------------------------------------------
+	bool inBounds(int query) const;
+
+//------------------------------------isCorrect()--------------------------------------
+// returns whether two keypoints correspond
+//Precondition: query indexes kpts1 and train indexes kpts2
+//Postcondition: true is returned if matching them is correct
+//-------------------------------------------------------------------------------------
+	bool isCorrect(int query, int train) const;
+
+//------------------------------------inBoundsCount()----------------------------------
+// the number of keypoints of the first image that map inside the second one
+//-------------------------------------------------------------------------------------
+	int inBoundsCount() const;
+
+//------------------------------------matchableCount()---------------------------------
+// the number of keypoints of the first image that have at least one
+// correspondence, which is the most correct matches a matcher can return
+//-------------------------------------------------------------------------------------
+	int matchableCount() const;
+
+//------------------------------------correspondenceCount()----------------------------
+// the number of corresponding keypoint pairs
+//-------------------------------------------------------------------------------------
+	int correspondenceCount() const;
+
+private:
+	vector<Point2d> projected;	// per keypoint of the first image
+	vector<uchar> inside;		// per keypoint of the first image
+	vector<int> rowStart;		// correspondences of query q are trains[rowStart[q]..rowStart[q+1])
+	vector<int> trains;			// train indices, ascending within a query
+	int insideCount;
+	int matchable;
+};
+
+#endif /* __cplusplus */
+
+#endif
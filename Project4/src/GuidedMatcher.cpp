@@ -0,0 +1,225 @@
+#include "GuidedMatcher.h"
+#include <algorithm>
+#include <cmath>
+
+/*!
+	Train keypoints bucketed by position; cell (cx, cy) holds
+	index[start[cy * cols + cx] .. start[cy * cols + cx + 1]). Cells are at
+	least as wide as the search radius, so a search only visits 3x3 cells
+*/
+struct KeyPointGrid
+{
+	float cellSize;
+	float x0, y0;
+	int cols, rows;
+	vector<int> start;
+	vector<int> index;
+
+	KeyPointGrid(const vector<KeyPoint>& kpts, float _cellSize) : cellSize(_cellSize), x0(0), y0(0), cols(1), rows(1)
+	{
+		if (!kpts.empty())
+		{
+			float x1 = kpts[0].pt.x, y1 = kpts[0].pt.y;
+			x0 = x1;
+			y0 = y1;
+			for (size_t i = 1; i < kpts.size(); i++)
+			{
+				x0 = std::min(x0, kpts[i].pt.x);
+				y0 = std::min(y0, kpts[i].pt.y);
+				x1 = std::max(x1, kpts[i].pt.x);
+				y1 = std::max(y1, kpts[i].pt.y);
+			}
+			// cells may be wider than asked for, but no more numerous than a few per keypoint
+			cellSize = std::max(cellSize, std::sqrt((x1 - x0) * (y1 - y0) / (4.f * kpts.size())));
+			cols = (int)((x1 - x0) / cellSize) + 1;
+			rows = (int)((y1 - y0) / cellSize) + 1;
+		}
+
+		// counting sort of the keypoints by cell, keeping them in index order within a cell
+		vector<int> cell(kpts.size());
+		start.assign(cols * rows + 1, 0);
+		for (size_t i = 0; i < kpts.size(); i++)
+		{
+			cell[i] = cellOf(kpts[i].pt.y, y0, rows) * cols + cellOf(kpts[i].pt.x, x0, cols);
+			start[cell[i] + 1]++;
+		}
+		for (size_t c = 1; c < start.size(); c++)
+			start[c] += start[c - 1];
+
+		vector<int> next(start.begin(), start.end() - 1);
+		index.resize(kpts.size());
+		for (size_t i = 0; i < kpts.size(); i++)
+			index[next[cell[i]]++] = (int)i;
+	}
+
+	int cellOf(float v, float origin, int count) const
+	{
+		return std::min(std::max((int)((v - origin) / cellSize), 0), count - 1);
+	}
+};
+
+/*!
+	Matches a range of query rows against the train keypoints around their projections.
+	With secondDistances set the runner-up of every query is kept as well, and with
+	measured set every distance measured for a query is recorded with its train row
+*/
+class GuidedMatchBody : public ParallelLoopBody
+{
+public:
+	GuidedMatchBody(const Mat& _query, const Mat& _train, const vector<Point2d>& _projections, const vector<KeyPoint>& _trainKpts,
+		const KeyPointGrid& _grid, float _radius, vector<DMatch>& _matches, vector<float>* _secondDistances = NULL,
+		vector<vector<pair<int, float> > >* _measured = NULL)
+		: query(_query), train(_train), projections(_projections), trainKpts(_trainKpts), grid(_grid), radius(_radius),
+		matches(_matches), secondDistances(_secondDistances), measured(_measured) {}
+
+	virtual void operator()(const Range& range) const
+	{
+		Mat dist;
+		for (int i = range.start; i < range.end; i++)
+		{
+			matches[i] = DMatch(i, -1, 0, FLT_MAX);
+			if (secondDistances)
+				(*secondDistances)[i] = FLT_MAX;
+			const Point2d& p = projections[i];
+
+			// projections at infinity, or further than the radius from every cell, have nothing in reach
+			double fx = std::floor((p.x - grid.x0) / grid.cellSize);
+			double fy = std::floor((p.y - grid.y0) / grid.cellSize);
+			if (!(fx >= -1 && fx <= grid.cols && fy >= -1 && fy <= grid.rows))
+				continue;
+			int cx = (int)fx, cy = (int)fy;
+
+			// candidates are visited in train order, so equally distant ones resolve to the first
+			vector<int> near;
+			for (int y = std::max(cy - 1, 0); y <= std::min(cy + 1, grid.rows - 1); y++)
+			{
+				for (int x = std::max(cx - 1, 0); x <= std::min(cx + 1, grid.cols - 1); x++)
+				{
+					int c = y * grid.cols + x;
+					for (int k = grid.start[c]; k < grid.start[c + 1]; k++)
+					{
+						const Point2f& q = trainKpts[grid.index[k]].pt;
+						double dx = q.x - p.x, dy = q.y - p.y;
+						if (dx * dx + dy * dy <= (double)radius * radius)
+							near.push_back(grid.index[k]);
+					}
+				}
+			}
+			std::sort(near.begin(), near.end());
+
+			float second = FLT_MAX;
+			for (size_t k = 0; k < near.size(); k++)
+			{
+				batchDistance(query.row(i), train.row(near[k]), dist, CV_32F, noArray(), NORM_L2);
+				float d = dist.at<float>(0, 0);
+				if (measured)
+					(*measured)[i].push_back(make_pair(near[k], d));
+				if (d < matches[i].distance || matches[i].trainIdx < 0)
+				{
+					second = matches[i].distance;
+					matches[i] = DMatch(i, near[k], 0, d);
+				}
+				else if (d < second)
+					second = d;
+			}
+			if (secondDistances)
+				(*secondDistances)[i] = second;
+		}
+	}
+
+private:
+	const Mat& query;
+	const Mat& train;
+	const vector<Point2d>& projections;
+	const vector<KeyPoint>& trainKpts;
+	const KeyPointGrid& grid;
+	float radius;
+	vector<DMatch>& matches;
+	vector<float>* secondDistances;
+	vector<vector<pair<int, float> > >* measured;
+};
+
+//------------------------------------match()------------------------------------------
+// find the nearest train descriptor of every query descriptor among the train
+// keypoints near its projection
+//Precondition: the following parameters must be correclty defined.
+//parameters:
+	//query, train: descriptors of the same type and width, one row per keypoint
+	//projections: where each query keypoint lands in the second image
+	//trainKpts: keypoints of the train descriptors
+	//radius: how far from a projection a train keypoint may be, in pixels
+//Postcondition: matches holds, in query order, one match for every query that has
+//				 a train keypoint in reach, with its L2 distance
+//-------------------------------------------------------------------------------------
+void GuidedMatcher::match(const Mat& query, const Mat& train, const vector<Point2d>& projections,
+	const vector<KeyPoint>& trainKpts, float radius, vector<DMatch>& matches)
+{
+	matches.clear();
+	if (query.empty() || train.empty())
+		return;
+
+	CV_Assert(radius > 0 && (int)projections.size() == query.rows && (int)trainKpts.size() == train.rows);
+
+	KeyPointGrid grid(trainKpts, radius);
+	vector<DMatch> all(query.rows);
+	parallel_for_(Range(0, query.rows), GuidedMatchBody(query, train, projections, trainKpts, grid, radius, all));
+
+	for (size_t i = 0; i < all.size(); i++)
+		if (all[i].trainIdx >= 0)
+			matches.push_back(all[i]);
+}
+
+//------------------------------------matchTwoWay()------------------------------------
+// find the two nearest train descriptors of every query descriptor among the train
+// keypoints near its projection, and the nearest query descriptor of every train
+// descriptor among the queries that project near it
+//Precondition: as for match()
+//Postcondition: matches is what match() returns; secondDistances holds, for each of
+//				 them, the distance of the second nearest train row in reach, FLT_MAX
+//				 if there is only one; reverseMatches holds the nearest query row of
+//				 every train row, the first of equally distant ones, -1 if no query
+//				 projects near it
+//-------------------------------------------------------------------------------------
+void GuidedMatcher::matchTwoWay(const Mat& query, const Mat& train, const vector<Point2d>& projections,
+	const vector<KeyPoint>& trainKpts, float radius, vector<DMatch>& matches, vector<float>& secondDistances,
+	vector<int>& reverseMatches)
+{
+	matches.clear();
+	secondDistances.clear();
+	reverseMatches.assign(train.rows, -1);
+	if (query.empty() || train.empty())
+		return;
+
+	CV_Assert(radius > 0 && (int)projections.size() == query.rows && (int)trainKpts.size() == train.rows);
+
+	KeyPointGrid grid(trainKpts, radius);
+	vector<DMatch> all(query.rows);
+	vector<float> second(query.rows);
+	vector<vector<pair<int, float> > > measured(query.rows);
+	parallel_for_(Range(0, query.rows), GuidedMatchBody(query, train, projections, trainKpts, grid, radius, all, &second, &measured));
+
+	// a train keypoint is in reach of a query exactly when the query is in reach of it,
+	// so the reverse matches come from the same distances, visited in query order
+	vector<float> reverseBest(train.rows, FLT_MAX);
+	for (int i = 0; i < query.rows; i++)
+	{
+		for (size_t k = 0; k < measured[i].size(); k++)
+		{
+			int t = measured[i][k].first;
+			if (measured[i][k].second < reverseBest[t] || reverseMatches[t] < 0)
+			{
+				reverseBest[t] = measured[i][k].second;
+				reverseMatches[t] = i;
+			}
+		}
+	}
+
+	for (size_t i = 0; i < all.size(); i++)
+	{
+		if (all[i].trainIdx >= 0)
+		{
+			matches.push_back(all[i]);
+			secondDistances.push_back(second[i]);
+		}
+	}
+}
@@ -0,0 +1,66 @@
+//-------------------------------------------------------------------------
+// Name: GuidedMatcher.h
+// Description: Nearest neighbour matcher guided by the homography of an
+//  image pair. Every query keypoint is mapped into the second image, and
+//  its descriptor is only compared with those of the train keypoints
+//  within a radius of where it lands. The train keypoints are bucketed in
+//  a grid of cells as wide as the radius, so only the nine cells around a
+//  projection are visited and the work grows with the number of
+//  keypoints rather than its square. Queries with no train keypoint in
+//  reach get no match. Query rows are matched in parallel. The runner-up
+//  of every query and the nearest query of every train keypoint, which
+//  the ratio test and the mutual check need, can be kept from the same
+//  distances, so those strategies see the same candidates.
+// Methods:
+//			match()
+//			matchTwoWay()
+//-------------------------------------------------------------------------
+
+#ifndef GUIDED_MATCHER_H
+#define GUIDED_MATCHER_H
+
+#include "opencv2/opencv.hpp"
+#include <vector>
+
+using namespace std;
+using namespace cv;
+
+#ifdef __cplusplus
+
+class GuidedMatcher
+{
+public:
+//------------------------------------match()------------------------------------------
+// find the nearest train descriptor of every query descriptor among the train
+// keypoints near its projection
+//Precondition: the following parameters must be correclty defined.
+//parameters:
+	//query, train: descriptors of the same type and width, one row per keypoint
+	//projections: where each query keypoint lands in the second image
+	//trainKpts: keypoints of the train descriptors
+	//radius: how far from a projection a train keypoint may be, in pixels
+//Postcondition: matches holds, in query order, one match for every query that has
+//				 a train keypoint in reach, with its L2 distance
+//-------------------------------------------------------------------------------------
+	static void match(const Mat& query, const Mat& train, const vector<Point2d>& projections,
+		const vector<KeyPoint>& trainKpts, float radius, vector<DMatch>& matches);
+
+//------------------------------------matchTwoWay()------------------------------------
+// find the two nearest train descriptors of every query descriptor among the train
+// keypoints near its projection, and the nearest query descriptor of every train
+// descriptor among the queries that project near it
+//Precondition: as for match()
+//Postcondition: matches is what match() returns; secondDistances holds, for each of
+//				 them, the distance of the second nearest train row in reach, FLT_MAX
+//				 if there is only one; reverseMatches holds the nearest query row of
+//				 every train row, the first of equally distant ones, -1 if no query
+//				 projects near it
+//-------------------------------------------------------------------------------------
+	static void matchTwoWay(const Mat& query, const Mat& train, const vector<Point2d>& projections,
+		const vector<KeyPoint>& trainKpts, float radius, vector<DMatch>& matches, vector<float>& secondDistances,
+		vector<int>& reverseMatches);
+};
+
+#endif /* __cplusplus */
+
+#endif
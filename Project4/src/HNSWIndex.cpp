@@ -0,0 +1,240 @@
+#include "HNSWIndex.h"
+#include <algorithm>
+#include <functional>
+#include <queue>
+
+//------------------------------------HNSWIndex()--------------------------------------
+// build the graph over the rows of data
+//Precondition: the following parameters must be correclty defined.
+//parameters:
+	//data: CV_32F descriptors, one per row; the index keeps a reference to them
+	//M: links per node on the upper levels, twice as many on the bottom one
+	//efConstruction: search breadth used while linking a new node
+	//seed: seed of the level draws
+//Postcondition: every row is a node of the graph
+//-------------------------------------------------------------------------------------
+HNSWIndex::HNSWIndex(const Mat& _data, int _M, int efConstruction, uint64 seed)
+	: data(_data), M(std::max(_M, 2)), maxLevel(-1), entryPoint(-1)
+{
+	CV_Assert(data.type() == CV_32F && efConstruction >= 1);
+
+	RNG rng(seed);
+	double levelScale = 1.0 / std::log((double)M);
+	links.resize(data.rows);
+	VisitedNodes visited;
+
+	for (int node = 0; node < data.rows; node++)
+	{
+		double u = std::max(rng.uniform(0.0, 1.0), DBL_MIN);
+		int level = (int)(-std::log(u) * levelScale);
+		links[node].resize(level + 1);
+		if (entryPoint < 0)
+		{
+			entryPoint = node;
+			maxLevel = level;
+			continue;
+		}
+
+		int entry = entryPoint;
+		const float* query = data.ptr<float>(node);
+		for (int l = maxLevel; l > level; l--)
+			entry = greedyStep(query, entry, l);
+
+		vector<Candidate> found;
+		vector<int> picked;
+		for (int l = std::min(level, maxLevel); l >= 0; l--)
+		{
+			searchLevel(query, entry, efConstruction, l, found, visited);
+			selectNeighbours(found, M, picked);
+			links[node][l] = picked;
+
+			for (size_t k = 0; k < picked.size(); k++)
+			{
+				vector<int>& back = links[picked[k]][l];
+				back.push_back(node);
+
+				// keep the nearest links of a node that has too many
+				if ((int)back.size() > maxLinks(l))
+				{
+					const float* from = data.ptr<float>(picked[k]);
+					vector<Candidate> kept(back.size());
+					for (size_t b = 0; b < back.size(); b++)
+						kept[b] = Candidate(distance(from, back[b]), back[b]);
+					std::sort(kept.begin(), kept.end());
+					back.resize(maxLinks(l));
+					for (size_t b = 0; b < back.size(); b++)
+						back[b] = kept[b].second;
+				}
+			}
+			entry = found[0].second;
+		}
+
+		if (level > maxLevel)
+		{
+			maxLevel = level;
+			entryPoint = node;
+		}
+	}
+}
+
+//------------------------------------nearest()----------------------------------------
+// find the node nearest to a query
+//Precondition: query has as many values as a data row, ef >= 1; visited is
+//				only used by the calling thread
+//Postcondition: the row index of the nearest node found is returned, -1 if the
+//				 index is empty
+//-------------------------------------------------------------------------------------
+int HNSWIndex::nearest(const float* query, int ef, VisitedNodes& visited) const
+{
+	if (entryPoint < 0)
+		return -1;
+
+	int entry = entryPoint;
+	for (int l = maxLevel; l > 0; l--)
+		entry = greedyStep(query, entry, l);
+
+	vector<Candidate> found;
+	searchLevel(query, entry, std::max(ef, 1), 0, found, visited);
+	return found[0].second;
+}
+
+// squared L2 distance from a query to a node, branch free so it can be vectorised
+float HNSWIndex::distance(const float* query, int node) const
+{
+	const float* row = data.ptr<float>(node);
+	float sum = 0;
+	for (int k = 0; k < data.cols; k++)
+	{
+		float diff = query[k] - row[k];
+		sum += diff * diff;
+	}
+	return sum;
+}
+
+int HNSWIndex::maxLinks(int level) const
+{
+	return level == 0 ? 2 * M : M;
+}
+
+//------------------------------------greedyStep()-------------------------------------
+// walk to the neighbour nearest the query until no neighbour is nearer
+//-------------------------------------------------------------------------------------
+int HNSWIndex::greedyStep(const float* query, int entry, int level) const
+{
+	float best = distance(query, entry);
+	bool moved = true;
+
+	while (moved)
+	{
+		moved = false;
+		const vector<int>& next = links[entry][level];
+		for (size_t k = 0; k < next.size(); k++)
+		{
+			float d = distance(query, next[k]);
+			if (d < best)
+			{
+				best = d;
+				entry = next[k];
+				moved = true;
+			}
+		}
+	}
+	return entry;
+}
+
+//------------------------------------searchLevel()------------------------------------
+// best-first search of one level keeping the ef nearest nodes
+//Postcondition: found holds those nodes, nearest first
+//-------------------------------------------------------------------------------------
+void HNSWIndex::searchLevel(const float* query, int entry, int ef, int level, vector<Candidate>& found, VisitedNodes& visited) const
+{
+	visited.reset(data.rows);
+	priority_queue<Candidate, vector<Candidate>, greater<Candidate> > frontier;	// nearest on top
+	priority_queue<Candidate> nearest;												// furthest on top
+
+	Candidate start(distance(query, entry), entry);
+	visited.visit(entry);
+	frontier.push(start);
+	nearest.push(start);
+
+	while (!frontier.empty())
+	{
+		Candidate current = frontier.top();
+		if (current.first > nearest.top().first && (int)nearest.size() >= ef)
+			break;
+		frontier.pop();
+
+		const vector<int>& next = links[current.second][level];
+		for (size_t k = 0; k < next.size(); k++)
+		{
+			int node = next[k];
+			if (!visited.visit(node))
+				continue;
+
+			float d = distance(query, node);
+			if ((int)nearest.size() < ef || d < nearest.top().first)
+			{
+				frontier.push(Candidate(d, node));
+				nearest.push(Candidate(d, node));
+				if ((int)nearest.size() > ef)
+					nearest.pop();
+			}
+		}
+	}
+
+	found.resize(nearest.size());
+	for (int k = (int)found.size() - 1; k >= 0; k--)
+	{
+		found[k] = nearest.top();
+		nearest.pop();
+	}
+}
+
+//------------------------------------selectNeighbours()-------------------------------
+// pick up to count links among candidates sorted nearest first, preferring
+// candidates that are nearer to the node than to an already picked link
+//-------------------------------------------------------------------------------------
+void HNSWIndex::selectNeighbours(const vector<Candidate>& candidates, int count, vector<int>& picked) const
+{
+	vector<int> skipped;
+	picked.clear();
+
+	for (size_t k = 0; k < candidates.size() && (int)picked.size() < count; k++)
+	{
+		const float* candidate = data.ptr<float>(candidates[k].second);
+		bool keep = true;
+		for (size_t p = 0; p < picked.size() && keep; p++)
+			keep = distance(candidate, picked[p]) >= candidates[k].first;
+		if (keep)
+			picked.push_back(candidates[k].second);
+		else
+			skipped.push_back(candidates[k].second);
+	}
+
+	// links that cover the same direction are still better than none
+	for (size_t k = 0; k < skipped.size() && (int)picked.size() < count; k++)
+		picked.push_back(skipped[k]);
+}
+
+// start a search; the marks are only cleared when the tag wraps around
+void HNSWIndex::VisitedNodes::reset(int nodes)
+{
+	if ((int)marks.size() != nodes)
+	{
+		marks.assign(nodes, 0);
+		tag = 0;
+	}
+	if (++tag == 0)
+	{
+		std::fill(marks.begin(), marks.end(), 0u);
+		tag = 1;
+	}
+}
+
+bool HNSWIndex::VisitedNodes::visit(int node)
+{
+	if (marks[node] == tag)
+		return false;
+	marks[node] = tag;
+	return true;
+}
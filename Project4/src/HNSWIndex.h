@@ -0,0 +1,102 @@
+//-------------------------------------------------------------------------
+// Name: HNSWIndex.h
+// Description: Hierarchical navigable small world graph over a set of
+//  descriptors (Malkov and Yashunin). Every descriptor is a node linked to
+//  a few of its near neighbours; the nodes are also assigned to levels
+//  with exponentially falling probability, and the sparse upper levels
+//  let a search descend greedily to the right region before a breadth
+//  limited best-first search on the bottom level. Levels are drawn from a
+//  fixed seed, so the graph and the search results are repeatable.
+//  A search marks the nodes it has seen in a VisitedNodes scratch that is
+//  reused across searches, so it costs only the nodes it reaches.
+// Methods:
+//			HNSWIndex()
+//			nearest()
+//-------------------------------------------------------------------------
+
+#ifndef HNSW_INDEX_H
+#define HNSW_INDEX_H
+
+#include "opencv2/opencv.hpp"
+#include <utility>
+#include <vector>
+
+using namespace std;
+using namespace cv;
+
+#ifdef __cplusplus
+
+class HNSWIndex
+{
+public:
+	/*!
+		Nodes seen by the current search. A node is seen when its mark equals
+		the tag, so starting a search bumps the tag instead of clearing the
+		marks. One is needed per thread that searches the index
+	*/
+	class VisitedNodes
+	{
+	public:
+		VisitedNodes() : tag(0) {}
+		void reset(int nodes);		// start a search over an index of this many nodes
+		bool visit(int node);		// mark a node, false if it was already seen
+
+	private:
+		vector<unsigned> marks;
+		unsigned tag;
+	};
+
+//------------------------------------HNSWIndex()--------------------------------------
+// build the graph over the rows of data
+//Precondition: the following parameters must be correclty defined.
+//parameters:
+	//data: CV_32F descriptors, one per row; the index keeps a reference to them
+	//M: links per node on the upper levels, twice as many on the bottom one
+	//efConstruction: search breadth used while linking a new node
+	//seed: seed of the level draws
+//Postcondition: every row is a node of the graph
+//-------------------------------------------------------------------------------------
+	HNSWIndex(const Mat& data, int M, int efConstruction, uint64 seed = 1);
+
+//------------------------------------nearest()----------------------------------------
+// find the node nearest to a query
+//Precondition: query has as many values as a data row, ef >= 1; visited is
+//				only used by the calling thread
+//Postcondition: the row index of the nearest node found is returned, -1 if the
+//				 index is empty
+//-------------------------------------------------------------------------------------
+	int nearest(const float* query, int ef, VisitedNodes& visited) const;
+
+private:
+	typedef pair<float, int> Candidate;		// squared distance and node
+
+	Mat data;
+	int M;
+	int maxLevel;
+	int entryPoint;
+	vector<vector<vector<int> > > links;		// links[node][level]
+
+	float distance(const float* query, int node) const;
+	int maxLinks(int level) const;
+
+//------------------------------------greedyStep()-------------------------------------
+// walk to the neighbour nearest the query until no neighbour is nearer
+//-------------------------------------------------------------------------------------
+	int greedyStep(const float* query, int entry, int level) const;
+
+//------------------------------------searchLevel()------------------------------------
+// best-first search of one level keeping the ef nearest nodes
+//Postcondition: found holds those nodes, nearest first
+//-------------------------------------------------------------------------------------
+	void searchLevel(const float* query, int entry, int ef, int level, vector<Candidate>& found, VisitedNodes& visited) const;
+
+//------------------------------------selectNeighbours()-------------------------------
+// pick up to count links among candidates sorted nearest first, preferring
+// candidates that are nearer to the node than to an already picked link
+//-------------------------------------------------------------------------------------
+	void selectNeighbours(const vector<Candidate>& candidates, int count, vector<int>& picked) const;
+};
+
+#endif /* __cplusplus */
+
+#endif
@@ -9,6 +9,7 @@
 //			create()
 //			HoNC()
 //			operator()
+//			buildDescriptorPyramid()
 //			calcSIFTDescriptor()
 //-------------------------------------------------------------------------
 
@@ -32,6 +33,46 @@ static const int BUCKET_SIZE = 256 / SIZE;
 // Average standard deviation of three color bands for each keypoint
 static const float AVG_STD_DEV = 48.f;
 
+// turns a colour plane into lower-bin weights in place: each value is normalised,
+// v' = (v - bar) * gain + bar + bias, and weighted 1 - clamp((v' - 63.5) / 128, 0, 1).
+// Rounding v' - 63.5 to float before the exact division by 128 gives the same bits as
+// the double evaluation it replaces, and the SSE2 path orders min and max as std::min
+// and std::max do, so every path gives the same weights
+static void lowerBinWeights(float* v, int len, float bar, float gain, float bias)
+{
+	int k = 0;
+#if CV_SSE2
+	if (checkHardwareSupport(CV_CPU_SSE2))
+	{
+		__m128 vbar = _mm_set1_ps(bar), vgain = _mm_set1_ps(gain), vbias = _mm_set1_ps(bias);
+		__m128 mid = _mm_set1_ps(63.5f), inv128 = _mm_set1_ps(1.f / 128);
+		__m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1.f);
+		for (; k <= len - 4; k += 4)
+		{
+			__m128 x = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(v + k), vbar), vgain), vbar), vbias);
+			x = _mm_mul_ps(_mm_sub_ps(x, mid), inv128);
+			_mm_storeu_ps(v + k, _mm_sub_ps(one, _mm_min_ps(one, _mm_max_ps(zero, x))));
+		}
+	}
+#endif
+	for (; k < len; k++)
+	{
+		float x = (v[k] - bar) * gain + bar + bias;
+		v[k] = 1.0f - std::min(std::max((x - 63.5f) / 128, 0.f), 1.f);
+	}
+}
+
+#if CV_SSE2
+// adds ((v * r) * g) * b to the eight colour bins at h, in the order of the scalar votes;
+// r0 and r1 hold the red weights of bins 0-3 and 4-7, g and b those of both halves
+static inline void addColorVotes(float* h, float v, __m128 r0, __m128 r1, __m128 g, __m128 b)
+{
+	__m128 vv = _mm_set1_ps(v);
+	_mm_storeu_ps(h, _mm_add_ps(_mm_loadu_ps(h), _mm_mul_ps(_mm_mul_ps(_mm_mul_ps(vv, r0), g), b)));
+	_mm_storeu_ps(h + 4, _mm_add_ps(_mm_loadu_ps(h + 4), _mm_mul_ps(_mm_mul_ps(_mm_mul_ps(vv, r1), g), b)));
+}
+#endif
+
 // constructor
 HoNC::HoNC()
 {
@@ -130,7 +171,7 @@ void HoNC::operator()(InputArray _image, InputArray _mask, vector<KeyPoint>& key
 	if (_descriptors.needed())
 	{
 		//t = (double)getTickCount();
-		int dsize = descriptorSize();
+		int dsize = outputSize();
 		_descriptors.create((int)keypoints.size(), dsize, CV_32F);
 		Mat descriptors = _descriptors.getMat();
 
@@ -140,6 +181,22 @@ void HoNC::operator()(InputArray _image, InputArray _mask, vector<KeyPoint>& key
 	}
 }
 
+//------------------------------------buildDescriptorPyramid()-------------------------
+// build the color gaussian pyramid, the HoNC histogram reads BGR values
+//Precondition: the following parameters must be correclty defined.
+//parameters:
+	//image: 8-bit color image passed to the descriptor
+	//keypoints: keypoints whose descriptors will be computed
+	//firstOctave, nOctaves: octave range of the keypoints
+	//pyr: receives the pyramid
+//Postcondition: pyr holds the color gaussian pyramid
+//-------------------------------------------------------------------------------------
+void HoNC::buildDescriptorPyramid(const Mat& image, const std::vector<KeyPoint>& keypoints, int firstOctave, int nOctaves, std::vector<Mat>& pyr) const
+{
+	Mat colorBase = createInitialColorImage(image, firstOctave < 0, (float)sigma);
+	buildGaussianPyramid(colorBase, pyr, nOctaves);
+}
+
 //------------------------------------calcSIFTDescriptor-------------------------------
 //calculate colorhistsift descriptor with given information and assign descriptor to dst
 //Precondition: the following parameters must be correclty defined.
@@ -156,15 +213,10 @@ void HoNC::operator()(InputArray _image, InputArray _mask, vector<KeyPoint>& key
 void HoNC::calcSIFTDescriptor(const Mat& img, Point2f ptf, float ori, float scl, int d, int n, float* dst) const
 {
 	Point pt(cvRound(ptf.x), cvRound(ptf.y));	//point object
-	float cos_t = cosf(ori*(float)(CV_PI / 180));	
-	float sin_t = sinf(ori*(float)(CV_PI / 180));
-	float exp_scale = -1.f / (d * d * 0.5f);
 	float hist_width = SIFT_DESCR_SCL_FCTR * scl;
 	int radius = cvRound(hist_width * 1.4142135623730951f * (d + 1) * 0.5f);
 	// Clip the radius to the diagonal of the image to avoid autobuffer too large exception
 	radius = std::min(radius, (int)sqrt((double)img.cols*img.cols + img.rows*img.rows));
-	cos_t /= hist_width;
-	sin_t /= hist_width;
 
 	int i, j, k, len = (radius * 2 + 1)*(radius * 2 + 1), histlen = (d + 2)*(d + 2)*(n + 2);
 	int rows = img.rows, cols = img.cols;
@@ -176,6 +228,8 @@ void HoNC::calcSIFTDescriptor(const Mat& img, Point2f ptf, float ori, float scl,
 	// rotational weight
 	float *W = BlueBin + len;
 	float *hist = W + len;
+	AutoBuffer<int> pos(len * 2);
+	int *R = pos, *C = R + len;
 	//Vote for 8 color buckets
 	for (i = 0; i < d + 2; i++)
 	{
@@ -185,44 +239,27 @@ void HoNC::calcSIFTDescriptor(const Mat& img, Point2f ptf, float ori, float scl,
 	}
 	// variables to compute average and squared average for each color
 	float rbar = 0, gbar = 0, bbar = 0, r2bar = 0, g2bar = 0, b2bar = 0;
-	for (i = -radius, k = 0; i <= radius; i++)
-		for (j = -radius; j <= radius; j++)
-		{
-		// Calculate sample's histogram array coords rotated relative to ori.
-		// Subtract 0.5 so samples that fall e.g. in the center of row 1 (i.e.
-		// r_rot = 1.5) have full weight placed in row 1 after interpolation.
-		float c_rot = j * cos_t - i * sin_t;  // column after "rotation"
-		float r_rot = j * sin_t + i * cos_t;  // row after "rotation"
-		float rbin = r_rot + d / 2 - 0.5f;   // row index of 4x4 bin
-		float cbin = c_rot + d / 2 - 0.5f;   // col index of 4x4 bin
-		int r = pt.y + i, c = pt.x + j;      // row and column index in actual image
-			
-		//need a r array, g array , b array instead of X and Y.
-		if (rbin > -1 && rbin < d && cbin > -1 && cbin < d &&
-			r > 0 && r < rows - 1 && c > 0 && c < cols - 1)
-			{
-				W[k] = (c_rot * c_rot + r_rot * r_rot)*exp_scale; 
-				RBin[k] = rbin; CBin[k] = cbin;
-				//changes: color histogram
-				float red = img.at<Vec3f>(r, c)[2];
-				float green = img.at<Vec3f>(r, c)[1];
-				float blue = img.at<Vec3f>(r, c)[0];
-				RedBin[k] = red;
-				GreenBin[k] = green;
-				BlueBin[k] = blue;
-
-				rbar += red;
-				gbar += green;
-				bbar += blue;
-				r2bar += red * red;
-				g2bar += green * green;
-				b2bar += blue * blue;
-
-				k++;
-			}
-		}
+	// rotated bin coordinates and Gaussian weights of the window samples
+	len = SamplingPatternCache::collectSamples(pt, ori, hist_width, radius, d, rows, cols, R, C, RBin, CBin, W);
 
-	len = k;
+	for (k = 0; k < len; k++)
+	{
+		int r = R[k], c = C[k];
+		//changes: color histogram
+		float red = img.at<Vec3f>(r, c)[2];
+		float green = img.at<Vec3f>(r, c)[1];
+		float blue = img.at<Vec3f>(r, c)[0];
+		RedBin[k] = red;
+		GreenBin[k] = green;
+		BlueBin[k] = blue;
+
+		rbar += red;
+		gbar += green;
+		bbar += blue;
+		r2bar += red * red;
+		g2bar += green * green;
+		b2bar += blue * blue;
+	}
 
 	// Compute averages and standard deviations
 	rbar = rbar / (float) len;
@@ -262,32 +299,22 @@ void HoNC::calcSIFTDescriptor(const Mat& img, Point2f ptf, float ori, float scl,
 	rgain = ggain = bgain = 1;
 	*/
 
-	for (k = 0; k < len; k++) {
-		RedBin[k] = (RedBin[k] - rbar) * rgain + rbar + rbias;
-		GreenBin[k] = (GreenBin[k] - gbar) * ggain + gbar + gbias;
-		BlueBin[k] = (BlueBin[k] - bbar) * bgain + bbar + bbias;
-
-	}
-	
-	hal::exp(W, W, len);
+	// turn the colour planes into lower-bin weights in place
+	lowerBinWeights(RedBin, len, rbar, rgain, rbias);
+	lowerBinWeights(GreenBin, len, gbar, ggain, gbias);
+	lowerBinWeights(BlueBin, len, bbar, bgain, bbias);
 
+#if CV_SSE2
+	bool useSSE2 = checkHardwareSupport(CV_CPU_SSE2);
+#endif
 	// going through all enclosed pixels and vote for bucket
 	for (k = 0; k < len; k++)
 	{
 		float rbin = RBin[k], cbin = CBin[k];
-		// RGV color value for keypoint pixel k
-		float red = RedBin[k];
-		float blue = BlueBin[k];
-		float green = GreenBin[k];
-		// weight
-		float redWeight = 1.0f - (float) std::min(std::max((red - 63.5) / 128, 0.0), 1.0);
-		float blueWeight = 1.0f - (float) std::min(std::max((blue - 63.5) / 128, 0.0), 1.0);
-		float greenWeight = 1.0f - (float) std::min(std::max((green - 63.5) / 128, 0.0), 1.0);
-
 		// weight container
-		float rWeight[2] = { redWeight, (1.0f - redWeight) };
-		float bWeight[2] = { blueWeight, (1.0f - blueWeight) };
-		float gWeight[2] = { greenWeight, (1.0f - greenWeight) };
+		float rWeight[2] = { RedBin[k], 1.0f - RedBin[k] };
+		float gWeight[2] = { GreenBin[k], 1.0f - GreenBin[k] };
+		float bWeight[2] = { BlueBin[k], 1.0f - BlueBin[k] };
 
 		int r0 = cvFloor(rbin);
 		int c0 = cvFloor(cbin);
@@ -299,26 +326,33 @@ void HoNC::calcSIFTDescriptor(const Mat& img, Point2f ptf, float ori, float scl,
 		// (while vote is weighted by gradient magnitude in grediant orientation histogram)
 		float v_r1 = W[k] * rbin, v_r0 = W[k] - v_r1;
 		float v_rc11 = v_r1*cbin, v_rc10 = v_r1 - v_rc11;
-		float v_rc01 = v_r0*cbin, v_rc00 = v_r0 - v_rc01; 
-		float v_rco110 = v_rc11;
-		float v_rco100 = v_rc10;
-		float v_rco010 = v_rc01;
-		float v_rco000 = v_rc00;
-		for (int red = 0; red < 2; red++) 
+		float v_rc01 = v_r0*cbin, v_rc00 = v_r0 - v_rc01;
+
+		// colour bin 4 * red + 2 * green + blue
+		float *h00 = hist + ((r0 + 1)*(d + 2) + c0 + 1)*(n + 2);
+		float *h01 = h00 + (n + 2);
+		float *h10 = h00 + (d + 2)*(n + 2);
+		float *h11 = h00 + (d + 3)*(n + 2);
+#if CV_SSE2
+		if (useSSE2)
 		{
-			for (int green = 0; green < 2; green++) 
-			{
-				for (int blue = 0; blue < 2; blue++) 
-				{
-					//Voting
-					int binIndex = 4 * red + 2 * green + blue;
-					int idx = ((r0 + 1)*(d + 2) + c0 + 1)*(n + 2) + binIndex;
-					hist[idx] += v_rco000 * rWeight[red] * gWeight[green] * bWeight[blue];
-					hist[idx + (n + 2)] += v_rco010 * rWeight[red] * gWeight[green] * bWeight[blue];
-					hist[idx + (d + 2)*(n + 2)] += v_rco100 * rWeight[red] * gWeight[green] * bWeight[blue];
-					hist[idx + (d + 3)*(n + 2)] += v_rco110 * rWeight[red] * gWeight[green] * bWeight[blue];
-				}
-			}
+			__m128 wr0 = _mm_set1_ps(rWeight[0]), wr1 = _mm_set1_ps(rWeight[1]);
+			__m128 wg = _mm_setr_ps(gWeight[0], gWeight[0], gWeight[1], gWeight[1]);
+			__m128 wb = _mm_setr_ps(bWeight[0], bWeight[1], bWeight[0], bWeight[1]);
+			addColorVotes(h00, v_rc00, wr0, wr1, wg, wb);
+			addColorVotes(h01, v_rc01, wr0, wr1, wg, wb);
+			addColorVotes(h10, v_rc10, wr0, wr1, wg, wb);
+			addColorVotes(h11, v_rc11, wr0, wr1, wg, wb);
+		}
+		else
+#endif
+		for (int bin = 0; bin < 8; bin++)
+		{
+			float red = rWeight[bin >> 2], green = gWeight[(bin >> 1) & 1], blue = bWeight[bin & 1];
+			h00[bin] += v_rc00 * red * green * blue;
+			h01[bin] += v_rc01 * red * green * blue;
+			h10[bin] += v_rc10 * red * green * blue;
+			h11[bin] += v_rc11 * red * green * blue;
 		}
 	}
 //-------------------------------------------------------------------------------------
@@ -332,27 +366,7 @@ void HoNC::calcSIFTDescriptor(const Mat& img, Point2f ptf, float ori, float scl,
 		for (k = 0; k < n; k++)
 			dst[(i*d + j)*n + k] = hist[idx + k];
 		}
-	// copy histogram to the descriptor,
-	// apply hysteresis thresholding
-	// and scale the result, so that it can be easily converted
-	// to byte array
-	float nrm2 = 0;
-	len = d*d*n;
-	for (k = 0; k < len; k++)
-		nrm2 += dst[k] * dst[k];
-	float thr = std::sqrt(nrm2) * SIFT_DESCR_MAG_THR; 
-	for (i = 0, nrm2 = 0; i < k; i++)
-	{
-		float val = std::min(dst[i], thr);
-		dst[i] = val;
-		nrm2 += val*val;
-	}
-	nrm2 = SIFT_INT_DESCR_FCTR / std::max(std::sqrt(nrm2), FLT_EPSILON);
-	
-	for (k = 0; k < len; k++)
-	{
-		dst[k] = dst[k] * nrm2;
-	}
+	DescriptorNormalizer::normalize(dst, d*d*n);
 
 }
 
@@ -9,6 +9,7 @@
 //			create()
 //			HoNC()
 //			operator()
+//			buildDescriptorPyramid()
 //			calcSIFTDescriptor()
 //-------------------------------------------------------------------------
 
@@ -60,6 +61,18 @@ public:
 
 protected:
 
+//------------------------------------buildDescriptorPyramid()-------------------------
+// build the color gaussian pyramid, the HoNC histogram reads BGR values
+//Precondition: the following parameters must be correclty defined.
+//parameters:
+	//image: 8-bit color image passed to the descriptor
+	//keypoints: keypoints whose descriptors will be computed
+	//firstOctave, nOctaves: octave range of the keypoints
+	//pyr: receives the pyramid
+//Postcondition: pyr holds the color gaussian pyramid
+//-------------------------------------------------------------------------------------
+	virtual void buildDescriptorPyramid(const Mat& image, const std::vector<KeyPoint>& keypoints, int firstOctave, int nOctaves, std::vector<Mat>& pyr) const;
+
 //------------------------------------calcSIFTDescriptor-------------------------------
 //calculate colorhistsift descriptor with given information and assign descriptor to dst
 //Precondition: the following parameters must be correclty defined.
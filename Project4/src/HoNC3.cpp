@@ -9,7 +9,9 @@
 //			create()
 //			HoNC()
 //			operator()
+//			buildDescriptorPyramid()
 //			calcSIFTDescriptor()
+//			colorBinWeights()
 //-------------------------------------------------------------------------
 
 
@@ -22,6 +24,19 @@ Below is the original copyright.
 \**********************************************************************************************/
 #include "HoNC3.h"
 
+#if CV_SSE2
+// adds v times the colour weights to the DESCR_HIST_BINS bins at h
+static inline void addColorVotes(float* h, float v, const float* colorWeight)
+{
+	__m128 vv = _mm_set1_ps(v);
+	int bin = 0;
+	for (; bin <= DESCR_HIST_BINS - 4; bin += 4)
+		_mm_storeu_ps(h + bin, _mm_add_ps(_mm_loadu_ps(h + bin), _mm_mul_ps(vv, _mm_loadu_ps(colorWeight + bin))));
+	for (; bin < DESCR_HIST_BINS; bin++)
+		h[bin] += v * colorWeight[bin];
+}
+#endif
+
 // constructor
 HoNC3::HoNC3()
 {
@@ -120,7 +135,7 @@ void HoNC3::operator()(InputArray _image, InputArray _mask, vector<KeyPoint>& ke
 	if (_descriptors.needed())
 	{
 		//t = (double)getTickCount();
-		int dsize = descriptorSize();
+		int dsize = outputSize();
 		_descriptors.create((int)keypoints.size(), dsize, CV_32F);
 		Mat descriptors = _descriptors.getMat();
 
@@ -130,6 +145,22 @@ void HoNC3::operator()(InputArray _image, InputArray _mask, vector<KeyPoint>& ke
 	}
 }
 
+//------------------------------------buildDescriptorPyramid()-------------------------
+// build the color gaussian pyramid, the HoNC3 histogram reads BGR values
+//Precondition: the following parameters must be correclty defined.
+//parameters:
+	//image: 8-bit color image passed to the descriptor
+	//keypoints: keypoints whose descriptors will be computed
+	//firstOctave, nOctaves: octave range of the keypoints
+	//pyr: receives the pyramid
+//Postcondition: pyr holds the color gaussian pyramid
+//-------------------------------------------------------------------------------------
+void HoNC3::buildDescriptorPyramid(const Mat& image, const std::vector<KeyPoint>& keypoints, int firstOctave, int nOctaves, std::vector<Mat>& pyr) const
+{
+	Mat colorBase = createInitialColorImage(image, firstOctave < 0, (float)sigma);
+	buildGaussianPyramid(colorBase, pyr, nOctaves);
+}
+
 //------------------------------------calcDescriptors()--------------------------------
 // set up variables and call calcSIFTDescriptor() to compute descriptors
 //Precondition: the following parameters must be correclty defined.
@@ -182,15 +213,10 @@ void HoNC3::calcDescriptors(const std::vector<Mat>& gpyr, const std::vector<KeyP
 void HoNC3::calcSIFTDescriptor(const Mat& img, Point2f ptf, float ori, float scl, int d, int n, float* dst) const
 {
 	Point pt(cvRound(ptf.x), cvRound(ptf.y));	//point object
-	float cos_t = cosf(ori*(float)(CV_PI / 180));	
-	float sin_t = sinf(ori*(float)(CV_PI / 180));
-	float exp_scale = -1.f / (d * d * 0.5f);
 	float hist_width = SIFT_DESCR_SCL_FCTR * scl;
 	int radius = cvRound(hist_width * 1.4142135623730951f * (d + 1) * 0.5f);
 	// Clip the radius to the diagonal of the image to avoid autobuffer too large exception
 	radius = std::min(radius, (int)sqrt((double)img.cols*img.cols + img.rows*img.rows));
-	cos_t /= hist_width;
-	sin_t /= hist_width;
 
 	int i, j, k, len = (radius * 2 + 1)*(radius * 2 + 1), histlen = (d + 2)*(d + 2)*(n + 2);
 	int rows = img.rows, cols = img.cols;
@@ -202,6 +228,8 @@ void HoNC3::calcSIFTDescriptor(const Mat& img, Point2f ptf, float ori, float scl
 	// rotational weight
 	float *W = BlueBin + len;
 	float *hist = W + len;
+	AutoBuffer<int> pos(len * 2);
+	int *R = pos, *C = R + len;
 	
 	for (i = 0; i < d + 2; i++)
 	{
@@ -211,45 +239,28 @@ void HoNC3::calcSIFTDescriptor(const Mat& img, Point2f ptf, float ori, float scl
 	}
 	// variables to compute average and squared average for each color
 	float rbar = 0, gbar = 0, bbar = 0, r2bar = 0, g2bar = 0, b2bar = 0;
-	for (i = -radius, k = 0; i <= radius; i++)
-		for (j = -radius; j <= radius; j++)
-		{
-		// Calculate sample's histogram array coords rotated relative to ori.
-		// Subtract 0.5 so samples that fall e.g. in the center of row 1 (i.e.
-		// r_rot = 1.5) have full weight placed in row 1 after interpolation.
-		float c_rot = j * cos_t - i * sin_t;  // column after "rotation"
-		float r_rot = j * sin_t + i * cos_t;  // row after "rotation"
-		float rbin = r_rot + d / 2 - 0.5f;   // row index of 4x4 bin
-		float cbin = c_rot + d / 2 - 0.5f;   // col index of 4x4 bin
-		int r = pt.y + i, c = pt.x + j;      // row and column index in actual image
-			
-		//need a r array, g array , b array instead of X and Y.
-		if (rbin > -1 && rbin < d && cbin > -1 && cbin < d &&
-			r > 0 && r < rows - 1 && c > 0 && c < cols - 1)
-			{
-				W[k] = (c_rot * c_rot + r_rot * r_rot)*exp_scale; 
-				RBin[k] = rbin; CBin[k] = cbin;
-				//changes: color histogram
-				float red = img.at<Vec3f>(r, c)[2];
-				float green = img.at<Vec3f>(r, c)[1];
-				float blue = img.at<Vec3f>(r, c)[0];
-				//stores RGB info
-				RedBin[k] = red;
-				GreenBin[k] = green;
-				BlueBin[k] = blue;
-
-				rbar += red;
-				gbar += green;
-				bbar += blue;
-				r2bar += red * red;
-				g2bar += green * green;
-				b2bar += blue * blue;
-
-				k++;
-			}
-		}
+	// rotated bin coordinates and Gaussian weights of the window samples
+	len = SamplingPatternCache::collectSamples(pt, ori, hist_width, radius, d, rows, cols, R, C, RBin, CBin, W);
 
-	len = k;
+	for (k = 0; k < len; k++)
+	{
+		int r = R[k], c = C[k];
+		//changes: color histogram
+		float red = img.at<Vec3f>(r, c)[2];
+		float green = img.at<Vec3f>(r, c)[1];
+		float blue = img.at<Vec3f>(r, c)[0];
+		//stores RGB info
+		RedBin[k] = red;
+		GreenBin[k] = green;
+		BlueBin[k] = blue;
+
+		rbar += red;
+		gbar += green;
+		bbar += blue;
+		r2bar += red * red;
+		g2bar += green * green;
+		b2bar += blue * blue;
+	}
 
 	// Compute averages and standard deviations
 	rbar = rbar / (float) len;
@@ -287,151 +298,72 @@ void HoNC3::calcSIFTDescriptor(const Mat& img, Point2f ptf, float ori, float scl
 	for (k = 0; k < len; k++)
 	{
 		RedBin[k] = (RedBin[k] - rbar) * rgain + rbar + rbias;
-		BlueBin[k] = (BlueBin[k] - bbar) * ggain + bbar + gbias;
-		GreenBin[k] = (GreenBin[k] - gbar) * bgain + gbar + bbias;
+		GreenBin[k] = (GreenBin[k] - gbar) * ggain + gbar + gbias;
+		BlueBin[k] = (BlueBin[k] - bbar) * bgain + bbar + bbias;
 	}
-	
-	hal::exp(W, W, len);
 
-	// going through all enclosed pixels and vote for bucket
-	for (k = 0; k < len; k++)
+	// going through all enclosed pixels and vote for bucket, the bucket weights of a
+	// block of samples at a time
+#if CV_SSE2
+	bool useSSE2 = checkHardwareSupport(CV_CPU_SSE2);
+#endif
+	float rWeights[SIZE][WEIGHT_BLOCK], gWeights[SIZE][WEIGHT_BLOCK], bWeights[SIZE][WEIGHT_BLOCK];
+	for (int block = 0; block < len; block += WEIGHT_BLOCK)
 	{
-		float rbin = RBin[k], cbin = CBin[k];
-		// RGV color value for keypoint pixel k
-		float red = RedBin[k];
-		float blue = BlueBin[k];
-		float green = GreenBin[k];
-
-		// weight container, intialize all weight with 0s
-		float rWeight[3] = { 0.f, 0.f, 0.f };
-		float bWeight[3] = { 0.f, 0.f, 0.f };
-		float gWeight[3] = { 0.f, 0.f, 0.f };
-
-		//determin which bin it belongs to
-		int rBinNum = (int)(red / 85);  
-		int gBinNum = (int)(green / 85);
-		int bBinNum = (int)(blue / 85);
-		//compute red weight
-
-		//color value less than 85
-		if (rBinNum < 1)
-		{
-			rWeight[0] = 1.0f - (float)std::min(std::max((red - 42.5) / 85, 0.0), 1.0);
-			rWeight[1] = 1.0f - rWeight[0];
-		}
-		// color value between 85 and 170
-		else if (rBinNum = 1)
-		{
-			//color value between 85 and 127.5, note:if color value is 127.5, it is equivalent to no extrapolation
-			if (red <= 127.5)
-			{
-				rWeight[1] = (float)std::min(std::max((red - 42.5) / 85, 0.0), 1.0);
-				rWeight[0] = 1.0f - rWeight[0];
-			}
-			//color value between 127.5 and 170
-			else if (red > 127.5)
-			{
-				rWeight[1] = 1.0f - (float)std::min(std::max((red - 127.5) / 85, 0.0), 1.0);
-				rWeight[2] = 1.0f - rWeight[0];
-			}
-		}
-		// color value greater than 170
-		else
-		{
-			rWeight[2] = (float)std::min(std::max((red - 127.5 ) / 85, 0.0), 1.0);
-			rWeight[1] = 1.0f - rWeight[0];
-		}
+		int count = std::min(len - block, (int)WEIGHT_BLOCK);
+		colorBinWeightBlock(RedBin + block, count, rWeights);
+		colorBinWeightBlock(GreenBin + block, count, gWeights);
+		colorBinWeightBlock(BlueBin + block, count, bWeights);
 
-		//compute green weight
-		//color value less than 85
-		if (gBinNum < 1)
-		{
-			gWeight[0] = 1.0f - (float)std::min(std::max((green - 42.5) / 85, 0.0), 1.0);
-			gWeight[1] = 1.0f - gWeight[0];
-		}
-		// color value between 85 and 170
-		//color value between 85 and 127.5, note:if color value is 127.5, it is equivalent to no extrapolation
-		else if (gBinNum = 1)
+		for (int s = 0; s < count; s++)
 		{
-			if (green <= 127.5)
-			{
-				gWeight[1] = (float)std::min(std::max((green - 42.5) / 85, 0.0), 1.0);
-				gWeight[0] = 1.0f - gWeight[0];
-			}
-			//color value between 127.5 and 170
-			else if (green > 127.5)
-			{
-				gWeight[1] = 1.0f - (float)std::min(std::max((green - 127.5) / 85, 0.0), 1.0);
-				gWeight[2] = 1.0f - gWeight[0];
-			}
-		}
-				// color value greater than 170
-		else
-		{
-			gWeight[2] = (float)std::min(std::max((green - 127.5) / 85, 0.0), 1.0);
-			gWeight[1] = 1.0f - gWeight[0];
-		}
-		
-		//compute blue weight
-		//color value less than 85
-		if (bBinNum < 1)
-		{
-			bWeight[0] = 1.0f - (float)std::min(std::max((blue - 42.5) / 85, 0.0), 1.0);
-			bWeight[1] = 1.0f - bWeight[0];
-		}
-				// color value between 85 and 170
-		else if (bBinNum = 1)
-		{
-			//color value between 85 and 127.5, note:if color value is 127.5, it is equivalent to no extrapolation
-			if (blue <= 127.5)
-			{
-				bWeight[1] = (float)std::min(std::max((blue - 42.5) / 85, 0.0), 1.0);
-				bWeight[0] = 1.0f - bWeight[0];
-			}
-			//color value between 127.5 and 170
-			else if (blue > 127.5)
-			{
-				bWeight[1] = 1.0f - (float)std::min(std::max((blue - 127.5) / 85, 0.0), 1.0);
-				bWeight[2] = 1.0f - bWeight[0];
-			}
-		}
-		// color value greater than 170
-		else
-		{
-			bWeight[2] = (float)std::min(std::max((blue - 127.5) / 85, 0.0), 1.0);
-			bWeight[1] = 1.0f - bWeight[0];
-		}
+			k = block + s;
+			float rbin = RBin[k], cbin = CBin[k];
 
-		int r0 = cvFloor(rbin);
-		int c0 = cvFloor(cbin);
-		rbin -= r0;
-		cbin -= c0;
-
-		//// histogram update using tri-linear interpolation
-		// vote is weighted by 1 in colo histogram
-		// (while vote is weighted by gradient magnitude in grediant orientation histogram)
-		float v_r1 = W[k] * rbin, v_r0 = W[k] - v_r1;
-		float v_rc11 = v_r1*cbin, v_rc10 = v_r1 - v_rc11;
-		float v_rc01 = v_r0*cbin, v_rc00 = v_r0 - v_rc01; 
-		float v_rco110 = v_rc11;
-		float v_rco100 = v_rc10;
-		float v_rco010 = v_rc01;
-		float v_rco000 = v_rc00;
-		for (int red = 0; red < 3; red++) 
-		{   
-			for (int green = 0; green < 3; green++) 
-			{
-				for (int blue = 0; blue < 3; blue++) 
+			// colour bin 9 * red + 3 * green + blue
+			float colorWeight[DESCR_HIST_BINS];
+			for (int red = 0, bin = 0; red < SIZE; red++)
+				for (int green = 0; green < SIZE; green++)
 				{
-					//Voting
-					//trinary
-					int binIndex = 9 * red + 3 * green + blue;
-					int idx = ((r0 + 1)*(d + 2) + c0 + 1)*(n + 2) + binIndex;
-					hist[idx] += v_rco000 * rWeight[red] * gWeight[green] * bWeight[blue];
-					hist[idx + (n + 2)] += v_rco010 * rWeight[red] * gWeight[green] * bWeight[blue];
-					hist[idx + (d + 2)*(n + 2)] += v_rco100 * rWeight[red] * gWeight[green] * bWeight[blue];
-					hist[idx + (d + 3)*(n + 2)] += v_rco110 * rWeight[red] * gWeight[green] * bWeight[blue];
+					float rg = rWeights[red][s] * gWeights[green][s];
+					colorWeight[bin++] = rg * bWeights[0][s];
+					colorWeight[bin++] = rg * bWeights[1][s];
+					colorWeight[bin++] = rg * bWeights[2][s];
 				}
+
+			int r0 = cvFloor(rbin);
+			int c0 = cvFloor(cbin);
+			rbin -= r0;
+			cbin -= c0;
+
+			//// histogram update using tri-linear interpolation
+			// vote is weighted by 1 in colo histogram
+			// (while vote is weighted by gradient magnitude in grediant orientation histogram)
+			float v_r1 = W[k] * rbin, v_r0 = W[k] - v_r1;
+			float v_rc11 = v_r1*cbin, v_rc10 = v_r1 - v_rc11;
+			float v_rc01 = v_r0*cbin, v_rc00 = v_r0 - v_rc01;
+
+			// the four cells are each a contiguous run of DESCR_HIST_BINS floats
+			float *h00 = hist + ((r0 + 1)*(d + 2) + c0 + 1)*(n + 2);
+			float *h01 = h00 + (n + 2);
+			float *h10 = h00 + (d + 2)*(n + 2);
+			float *h11 = h00 + (d + 3)*(n + 2);
+#if CV_SSE2
+			if (useSSE2)
+			{
+				addColorVotes(h00, v_rc00, colorWeight);
+				addColorVotes(h01, v_rc01, colorWeight);
+				addColorVotes(h10, v_rc10, colorWeight);
+				addColorVotes(h11, v_rc11, colorWeight);
+			}
+			else
+#endif
+			for (int bin = 0; bin < DESCR_HIST_BINS; bin++)
+			{
+				h00[bin] += v_rc00 * colorWeight[bin];
+				h01[bin] += v_rc01 * colorWeight[bin];
+				h10[bin] += v_rc10 * colorWeight[bin];
+				h11[bin] += v_rc11 * colorWeight[bin];
 			}
 		}
 	}
@@ -446,29 +378,117 @@ void HoNC3::calcSIFTDescriptor(const Mat& img, Point2f ptf, float ori, float scl
 		for (k = 0; k < n; k++)
 			dst[(i*d + j)*n + k] = hist[idx + k];
 		}
-	// copy histogram to the descriptor,
-	// apply hysteresis thresholding
-	// and scale the result, so that it can be easily converted
-	// to byte array
-	float nrm2 = 0;
-	len = d * d * n;
-	for (k = 0; k < len; k++)
-		nrm2 += dst[k] * dst[k];
-	float thr = std::sqrt(nrm2) * SIFT_DESCR_MAG_THR;
-	for (i = 0, nrm2 = 0; i < k; i++)
+	DescriptorNormalizer::normalize(dst, d*d*n);
+}
+
+// The bucket weights are piecewise linear in the colour value, with one segment per
+// input range: below 85, 85 to 127.5 and above 127.5
+static const int COLOR_SEGMENTS = 3;
+
+// Parameters of one segment. With t = clamp((value - origin) / 85, 0, 1), the lead
+// bucket gets t (or 1 - t when flipped), the pair bucket gets one minus the lead
+// weight and the fixed bucket gets 1. The segments reproduce the weights the
+// descriptor has always used, including full weight on bucket 0 between 85 and
+// 127.5 and on bucket 2 above 127.5. The values are continuous, so the weights are
+// computed rather than looked up at quantised values, which would change them.
+struct ColorBinSegment
+{
+	double origin;
+	bool flip;
+	int lead, pair, fixed;		// bucket index, -1 if unused
+};
+
+static const ColorBinSegment COLOR_BIN_SEGMENTS[COLOR_SEGMENTS] =
+{
+	{ 42.5, true, 0, 1, -1 },
+	{ 42.5, false, 1, -1, 0 },
+	{ 127.5, true, 1, -1, 2 }
+};
+
+//------------------------------------colorBinWeights()--------------------------------
+// soft-assign one normalised colour value to the SIZE buckets of its channel
+//Precondition: the following parameters must be correclty defined.
+//parameters:
+	//value: normalised colour value of one channel
+	//weight: array of SIZE floats receiving the bucket weights
+//Postcondition: weight is assigned
+//-------------------------------------------------------------------------------------
+void HoNC3::colorBinWeights(float value, float* weight)
+{
+	int segment = (int)(value / 85) < 1 ? 0 : (value <= 127.5 ? 1 : 2);
+	const ColorBinSegment& s = COLOR_BIN_SEGMENTS[segment];
+
+	float t = (float)std::min(std::max((value - s.origin) / 85, 0.0), 1.0);
+	float lead = s.flip ? 1.0f - t : t;
+
+	weight[0] = weight[1] = weight[2] = 0.f;
+	weight[s.lead] = lead;
+	if (s.pair >= 0)
+		weight[s.pair] = 1.0f - lead;
+	if (s.fixed >= 0)
+		weight[s.fixed] = 1.0f;
+}
+
+//------------------------------------colorBinWeightBlock()----------------------------
+// soft-assign a block of normalised colour values of one channel to its SIZE buckets,
+// as colorBinWeights() does one value at a time. The SSE2 path takes four values at
+// a time without branches: it picks the segment of COLOR_BIN_SEGMENTS with the same
+// comparisons, truncation included, and computes t in double precision as well, so
+// the weights have the same bits
+//Precondition: the following parameters must be correclty defined.
+//parameters:
+	//value: count normalised colour values, count <= WEIGHT_BLOCK
+	//weight: receives weight[b][k], the weight of bucket b for value k
+//Postcondition: weight is assigned
+//-------------------------------------------------------------------------------------
+void HoNC3::colorBinWeightBlock(const float* value, int count, float (*weight)[WEIGHT_BLOCK])
+{
+	int k = 0;
+#if CV_SSE2
+	if (checkHardwareSupport(CV_CPU_SSE2))
 	{
-		float val = std::min(dst[i], thr);
-		dst[i] = val;
-		nrm2 += val*val;
+		const __m128 bucketf = _mm_set1_ps(85.f), onef = _mm_set1_ps(1.f), edge = _mm_set1_ps(127.5f);
+		const __m128d bucket = _mm_set1_pd(85.0), one = _mm_set1_pd(1.0), zero = _mm_setzero_pd();
+		const __m128d lowOrigin = _mm_set1_pd(42.5), highOrigin = _mm_set1_pd(127.5);
+		for (; k <= count - 4; k += 4)
+		{
+			__m128 v = _mm_loadu_ps(value + k);
+			// segment 0 where (int)(value / 85) < 1, segment 2 above 127.5, segment 1 in between
+			__m128 seg0 = _mm_castsi128_ps(_mm_cmplt_epi32(_mm_cvttps_epi32(_mm_div_ps(v, bucketf)), _mm_set1_epi32(1)));
+			__m128 seg2 = _mm_andnot_ps(seg0, _mm_cmpnle_ps(v, edge));
+			__m128 seg1 = _mm_andnot_ps(_mm_or_ps(seg0, seg2), _mm_castsi128_ps(_mm_set1_epi32(-1)));
+
+			// t = clamp((value - origin) / 85, 0, 1), two values per double register
+			__m128d seg2lo = _mm_castps_pd(_mm_unpacklo_ps(seg2, seg2)), seg2hi = _mm_castps_pd(_mm_unpackhi_ps(seg2, seg2));
+			__m128d originLo = _mm_or_pd(_mm_and_pd(seg2lo, highOrigin), _mm_andnot_pd(seg2lo, lowOrigin));
+			__m128d originHi = _mm_or_pd(_mm_and_pd(seg2hi, highOrigin), _mm_andnot_pd(seg2hi, lowOrigin));
+			__m128d tLo = _mm_div_pd(_mm_sub_pd(_mm_cvtps_pd(v), originLo), bucket);
+			__m128d tHi = _mm_div_pd(_mm_sub_pd(_mm_cvtps_pd(_mm_movehl_ps(v, v)), originHi), bucket);
+			tLo = _mm_min_pd(one, _mm_max_pd(zero, tLo));
+			tHi = _mm_min_pd(one, _mm_max_pd(zero, tHi));
+			__m128 t = _mm_movelh_ps(_mm_cvtpd_ps(tLo), _mm_cvtpd_ps(tHi));
+
+			// segments 0 and 2 are flipped; bucket 0 gets the lead weight, 1 or 0, bucket 1
+			// one minus the lead weight or the lead weight, bucket 2 nothing or 1
+			__m128 flip = _mm_or_ps(seg0, seg2);
+			__m128 lead = _mm_or_ps(_mm_and_ps(flip, _mm_sub_ps(onef, t)), _mm_andnot_ps(flip, t));
+			_mm_storeu_ps(weight[0] + k, _mm_or_ps(_mm_and_ps(seg0, lead), _mm_and_ps(seg1, onef)));
+			_mm_storeu_ps(weight[1] + k, _mm_or_ps(_mm_and_ps(seg0, _mm_sub_ps(onef, lead)), _mm_andnot_ps(seg0, lead)));
+			_mm_storeu_ps(weight[2] + k, _mm_and_ps(seg2, onef));
+		}
 	}
-	nrm2 = SIFT_INT_DESCR_FCTR / std::max(std::sqrt(nrm2), FLT_EPSILON);
-	
-	for (k = 0; k < len; k++)
+#endif
+	for (; k < count; k++)
 	{
-		dst[k] = dst[k] * nrm2;
+		float w[SIZE];
+		colorBinWeights(value[k], w);
+		weight[0][k] = w[0];
+		weight[1][k] = w[1];
+		weight[2][k] = w[2];
 	}
 }
 
+
 //------------------------------------findScaleSpaceExtrema()--------------------------
 // Detects features at extrema in DoG scale space.  Bad features are discarded
 // based on contrast and ratio of principal curvatures.
@@ -9,6 +9,7 @@
 //			create()
 //			HoNC()
 //			operator()
+//			buildDescriptorPyramid()
 //			calcSIFTDescriptor()
 //-------------------------------------------------------------------------
 
@@ -82,6 +83,18 @@ public:
 
 protected:
 
+//------------------------------------buildDescriptorPyramid()-------------------------
+// build the color gaussian pyramid, the HoNC3 histogram reads BGR values
+//Precondition: the following parameters must be correclty defined.
+//parameters:
+	//image: 8-bit color image passed to the descriptor
+	//keypoints: keypoints whose descriptors will be computed
+	//firstOctave, nOctaves: octave range of the keypoints
+	//pyr: receives the pyramid
+//Postcondition: pyr holds the color gaussian pyramid
+//-------------------------------------------------------------------------------------
+	virtual void buildDescriptorPyramid(const Mat& image, const std::vector<KeyPoint>& keypoints, int firstOctave, int nOctaves, std::vector<Mat>& pyr) const;
+
 //------------------------------------calcSIFTDescriptor-------------------------------
 //calculate colorhistsift descriptor with given information and assign descriptor to dst
 //Precondition: the following parameters must be correclty defined.
@@ -96,6 +109,31 @@ protected:
 //Postcondition: dst array is assigned with decriptors
 //-------------------------------------------------------------------------------------
 	virtual void calcSIFTDescriptor(const Mat& img, Point2f ptf, float ori, float scl, int d, int n, float* dst) const;
+
+//------------------------------------colorBinWeights()--------------------------------
+// soft-assign one normalised colour value to the SIZE buckets of its channel
+//Precondition: the following parameters must be correclty defined.
+//parameters:
+	//value: normalised colour value of one channel
+	//weight: array of SIZE floats receiving the bucket weights
+//Postcondition: weight is assigned
+//-------------------------------------------------------------------------------------
+	static void colorBinWeights(float value, float* weight);
+
+	// samples whose bucket weights are computed together
+	static const int WEIGHT_BLOCK = 64;
+
+//------------------------------------colorBinWeightBlock()----------------------------
+// soft-assign a block of normalised colour values of one channel to its SIZE buckets,
+// as colorBinWeights() does one value at a time, four values at a time with SSE2
+//Precondition: the following parameters must be correclty defined.
+//parameters:
+	//value: count normalised colour values, count <= WEIGHT_BLOCK
+	//weight: receives weight[b][k], the weight of bucket b for value k
+//Postcondition: weight is assigned
+//-------------------------------------------------------------------------------------
+	static void colorBinWeightBlock(const float* value, int count, float (*weight)[WEIGHT_BLOCK]);
+
 	virtual void calcDescriptors(const std::vector<Mat>& gpyr, const std::vector<KeyPoint>& keypoints,
 		Mat& descriptors, int nOctaveLayers, int firstOctave) const;
 
@@ -3,6 +3,7 @@
 #define __OPENCV_HONI_H__
 
 #include "VanillaSIFT.h"
+#include "IntensityHistogram.h"
 
 using namespace std;
 using namespace cv;
@@ -7,6 +7,7 @@
 //			HoWH()
 //			operator()
 //			createInitialColorImage()
+//			buildDescriptorPyramid()
 //			calcSIFTDescriptor()
 //-------------------------------------------------------------------------
 
@@ -60,6 +61,24 @@ Mat HoWH::createInitialColorImage(const Mat& img, bool doubleImageSize, float si
 	}
 }
 
+//------------------------------------buildDescriptorPyramid()-------------------------
+// build the hue/saturation levels that the keypoints refer to
+//Precondition: the following parameters must be correclty defined.
+//parameters:
+	//image: 8-bit color image passed to the descriptor
+	//keypoints: keypoints whose descriptors will be computed
+	//firstOctave, nOctaves: octave range of the keypoints
+	//pyr: receives the pyramid
+//Postcondition: pyr holds the hue/saturation levels, others are empty
+//-------------------------------------------------------------------------------------
+void HoWH::buildDescriptorPyramid(const Mat& image, const std::vector<KeyPoint>& keypoints, int firstOctave, int nOctaves, std::vector<Mat>& pyr) const
+{
+	vector<Mat> colorGpyr;
+	Mat colorBase = createInitialColorImage(image, firstOctave < 0, (float)sigma);
+	buildGaussianPyramid(colorBase, colorGpyr, nOctaves);
+	transformPyramidLevels(colorGpyr, keypoints, nOctaveLayers, firstOctave, ColorTransform::hueSaturation, pyr);
+}
+
 //------------------------------------operator()---------------------------------------
 // Overloading operator() to run the algorithm using color image:
 // 1. compute keypoints using local extrema of Dog space
@@ -102,28 +121,23 @@ void HoWH::operator()(InputArray _image, InputArray _mask, vector<KeyPoint>& key
 			CV_Assert(firstOctave >= -1 && actualNLayers <= nOctaveLayers);
 			actualNOctaves = maxOctave - firstOctave + 1;
 		}
-		// base is a grey image
-		Mat base = createInitialImage(image, firstOctave < 0, (float)sigma);
 		//initialize color image
 		Mat& colorBase = createInitialColorImage(image, firstOctave < 0, (float)sigma);
 		vector<Mat> gpyr, dogpyr, colorGpyr; // colorGpyr is a gaussian pyramid for color image
-		int nOctaves = actualNOctaves > 0 ? actualNOctaves : cvRound(log((double)std::min(base.cols, base.rows)) / log(2.) - 2) - firstOctave;
+		int nOctaves = actualNOctaves > 0 ? actualNOctaves : cvRound(log((double)std::min(colorBase.cols, colorBase.rows)) / log(2.) - 2) - firstOctave;
 
 		//double t, tf = getTickFrequency();
 		//t = (double)getTickCount();
-		buildGaussianPyramid(base, gpyr, nOctaves);
-		buildDoGPyramid(gpyr, dogpyr);
-		// build color gaussian pyramid
-		buildGaussianPyramid(colorBase, colorGpyr, nOctaves);
-
-		// convert each blurred BGR image to HSV in the pyramid
-		for (int o = 0; o < nOctaves; o++)
+		// the grey and DoG pyramids are only needed to detect keypoints
+		if (!useProvidedKeypoints)
 		{
-			for (int i = 0; i < nOctaveLayers + 3; i++)
-			{
-				cvtColor(colorGpyr[o*(nOctaveLayers + 3) + i], colorGpyr[o*(nOctaveLayers + 3) + i], COLOR_BGR2HSV);
-			}
+			// base is a grey image
+			Mat base = createInitialImage(image, firstOctave < 0, (float)sigma);
+			buildGaussianPyramid(base, gpyr, nOctaves);
+			buildDoGPyramid(gpyr, dogpyr);
 		}
+		// build color gaussian pyramid
+		buildGaussianPyramid(colorBase, colorGpyr, nOctaves);
 		//t = (double)getTickCount() - t;
 		//printf("pyramid construction time: %g\n", t*1000./tf);
 
@@ -161,11 +175,13 @@ void HoWH::operator()(InputArray _image, InputArray _mask, vector<KeyPoint>& key
 		if (_descriptors.needed())
 		{
 			//t = (double)getTickCount();
-			int dsize = descriptorSize();
+			int dsize = outputSize();
 			_descriptors.create((int)keypoints.size(), dsize, CV_32F);
 			Mat descriptors = _descriptors.getMat();
 
-			calcDescriptors(colorGpyr, keypoints, descriptors, nOctaveLayers, firstOctave);
+			vector<Mat> hueSatPyr;
+			transformPyramidLevels(colorGpyr, keypoints, nOctaveLayers, firstOctave, ColorTransform::hueSaturation, hueSatPyr);
+			calcDescriptors(hueSatPyr, keypoints, descriptors, nOctaveLayers, firstOctave);
 			//t = (double)getTickCount() - t;
 			//printf("descriptor extraction time: %g\n", t*1000./tf);
 		}
@@ -188,16 +204,11 @@ void HoWH::operator()(InputArray _image, InputArray _mask, vector<KeyPoint>& key
 void HoWH::calcSIFTDescriptor(const Mat& img, Point2f ptf, float ori, float scl, int d, int n, float* dst) const
 {
 	Point pt(cvRound(ptf.x), cvRound(ptf.y));	//point object
-	float cos_t = cosf(ori*(float)(CV_PI / 180));
-	float sin_t = sinf(ori*(float)(CV_PI / 180));
 	float bins_per_degree = n / 360.f;
-	float exp_scale = -1.f / (d * d * 0.5f);
 	float hist_width = SIFT_DESCR_SCL_FCTR * scl;
 	int radius = cvRound(hist_width * 1.4142135623730951f * (d + 1) * 0.5f);
 	// Clip the radius to the diagonal of the image to avoid autobuffer too large exception
 	radius = std::min(radius, (int)sqrt((double)img.cols*img.cols + img.rows*img.rows));
-	cos_t /= hist_width;
-	sin_t /= hist_width;
 
 	int i, j, k, len = (radius * 2 + 1)*(radius * 2 + 1), histlen = (d + 2)*(d + 2)*(n + 2); 
 	int rows = img.rows, cols = img.cols;
@@ -206,6 +217,8 @@ void HoWH::calcSIFTDescriptor(const Mat& img, Point2f ptf, float ori, float scl,
 	AutoBuffer<float> buf(len * 7 + histlen);
 	float *X = buf, *Y = X + len, *Sat = Y, *Hue = Sat + len, *W = Hue + len;
 	float *RBin = W + len, *CBin = RBin + len, *hist = CBin + len;
+	AutoBuffer<int> pos(len * 2);
+	int *R = pos, *C = R + len;
 
 	//initialize the histogram
 	for (i = 0; i < d + 2; i++)
@@ -215,34 +228,16 @@ void HoWH::calcSIFTDescriptor(const Mat& img, Point2f ptf, float ori, float scl,
 				hist[(i*(d + 2) + j)*(n + 2) + k] = 0.;
 	}
 
-	for (i = -radius, k = 0; i <= radius; i++)
-		for (j = -radius; j <= radius; j++)
-		{
-		// Calculate sample's histogram array coords rotated relative to ori.
-		// Subtract 0.5 so samples that fall e.g. in the center of row 1 (i.e.
-		// r_rot = 1.5) have full weight placed in row 1 after interpolation.
-		float c_rot = j * cos_t - i * sin_t;
-		float r_rot = j * sin_t + i * cos_t;
-		float rbin = r_rot + d / 2 - 0.5f;
-		float cbin = c_rot + d / 2 - 0.5f;
-		int r = pt.y + i, c = pt.x + j;
-
-		if (rbin > -1 && rbin < d && cbin > -1 && cbin < d &&
-			r > 0 && r < rows - 1 && c > 0 && c < cols - 1)
-		{
-			float dx = (float)(img.at<sift_wt>(r, c + 1) - img.at<sift_wt>(r, c - 1));
-			float dy = (float)(img.at<sift_wt>(r - 1, c) - img.at<sift_wt>(r + 1, c));
-			X[k] = dx; Y[k] = dy; RBin[k] = rbin; CBin[k] = cbin;
-			//assign hue and saturation value to storage
-			Hue[k] = img.at<Vec3f>(r, c)[0];
-			Sat[k] = img.at<Vec3f>(r, c)[1];
-			W[k] = (c_rot * c_rot + r_rot * r_rot)*exp_scale;
-			k++;
-		}
-		}
+	// rotated bin coordinates and Gaussian weights of the window samples
+	len = SamplingPatternCache::collectSamples(pt, ori, hist_width, radius, d, rows, cols, R, C, RBin, CBin, W);
 
-	len = k;
-	hal::exp(W, W, len);
+	for (k = 0; k < len; k++)
+	{
+		int r = R[k], c = C[k];
+		//assign hue and saturation value to storage
+		Hue[k] = img.at<Vec2f>(r, c)[0];
+		Sat[k] = img.at<Vec2f>(r, c)[1];
+	}
 
 	for (k = 0; k < len; k++)
 	{
@@ -295,27 +290,8 @@ void HoWH::calcSIFTDescriptor(const Mat& img, Point2f ptf, float ori, float scl,
 		for (k = 0; k < n; k++)
 			dst[(i*d + j)*n + k] = hist[idx + k];
 		}
-	// copy histogram to the descriptor,
-	// apply hysteresis thresholding
-	// and scale the result, so that it can be easily converted
-	// to byte array
-	float nrm2 = 0;
-	len = d*d*n;
-	for (k = 0; k < len; k++)
-		nrm2 += dst[k] * dst[k];
-	float thr = std::sqrt(nrm2)*SIFT_DESCR_MAG_THR; 
-	for (i = 0, nrm2 = 0; i < k; i++)
-	{
-		float val = std::min(dst[i], thr);
-		dst[i] = val;
-		nrm2 += val*val;
-	}
-	nrm2 = SIFT_INT_DESCR_FCTR / std::max(std::sqrt(nrm2), FLT_EPSILON);
-
-	for (k = 0; k < len; k++)
-	{
-		dst[k] = (0.6f * dst[k] * nrm2);	// cfolson: 0.6 weight helps  when stacked with SIFT + others
-	}
+	// cfolson: 0.6 weight helps  when stacked with SIFT + others
+	DescriptorNormalizer::normalize(dst, d*d*n, DescriptorNormalizer::GLOBAL, 1, 1.f, 0.6f);
 
 }
 
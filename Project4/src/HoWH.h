@@ -8,6 +8,7 @@
 //			HoWH()
 //			operator()
 //			createInitialColorImage()
+//			buildDescriptorPyramid()
 //			calcSIFTDescriptor()
 //-------------------------------------------------------------------------
 
@@ -69,11 +70,23 @@ protected:
 //-------------------------------------------------------------------------------------
 	virtual Mat createInitialColorImage(const Mat& img, bool doubleImageSize, float sigma) const;
 
+//------------------------------------buildDescriptorPyramid()-------------------------
+// build the hue/saturation levels that the keypoints refer to
+//Precondition: the following parameters must be correclty defined.
+//parameters:
+	//image: 8-bit color image passed to the descriptor
+	//keypoints: keypoints whose descriptors will be computed
+	//firstOctave, nOctaves: octave range of the keypoints
+	//pyr: receives the pyramid
+//Postcondition: pyr holds the hue/saturation levels, others are empty
+//-------------------------------------------------------------------------------------
+	virtual void buildDescriptorPyramid(const Mat& image, const std::vector<KeyPoint>& keypoints, int firstOctave, int nOctaves, std::vector<Mat>& pyr) const;
+
 //------------------------------------calcSIFTDescriptor-------------------------------
 //calculate HoWH descriptor with given information and assign descriptor to dst
 //Precondition: the following parameters must be correclty defined.
 //parameters:
-	//img: color image
+	//img: hue/saturation image
 	//ptf: keypoint
 	//ori: angle(degree) of the keypoint relative to the coordinates, clockwise
 	//scl: radius of meaningful neighborhood around the keypoint 
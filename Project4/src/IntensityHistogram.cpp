@@ -0,0 +1,155 @@
+#include "IntensityHistogram.h"
+
+const float IntensityHistogram::AVG_STD_DEV = 64.f;
+
+//------------------------------------gather()-----------------------------------------
+// copy the window samples of every channel into planar band arrays
+//Precondition: img is a CV_32F image with at most MAX_BANDS channels
+//Postcondition: bands[b][k] holds channel b of sample k
+//-------------------------------------------------------------------------------------
+void IntensityHistogram::gather(const Mat& img, const int* R, const int* C, int len, float* const* bands)
+{
+	CV_Assert(img.depth() == CV_32F && img.channels() <= MAX_BANDS);
+
+	int cn = img.channels();
+	if (cn == 1)
+	{
+		float* dst = bands[0];
+		for (int k = 0; k < len; k++)
+			dst[k] = img.ptr<float>(R[k])[C[k]];
+		return;
+	}
+
+	// one read of the pixel for all of its channels
+	for (int k = 0; k < len; k++)
+	{
+		const float* px = img.ptr<float>(R[k]) + C[k] * cn;
+		for (int b = 0; b < cn; b++)
+			bands[b][k] = px[b];
+	}
+}
+
+//------------------------------------normalize()--------------------------------------
+// normalise a band to mean 127.5 and standard deviation AVG_STD_DEV and convert it
+// to intensity bin coordinates
+//Precondition: band holds len > 0 intensities
+//Postcondition: band[k] holds the intensity bin coordinate of sample k
+//-------------------------------------------------------------------------------------
+void IntensityHistogram::normalize(float* band, int len, float bins_per_intensity)
+{
+	// the sums are kept in sample order; splitting them into lanes would move the
+	// mean by a rounding step and with it samples sitting on a bin edge
+	float ibar = 0, ibar2 = 0;
+	for (int k = 0; k < len; k++)
+	{
+		ibar += band[k];
+		ibar2 += band[k] * band[k];
+	}
+
+	ibar = ibar / (float)len;
+	ibar2 = ibar2 / (float)len;
+
+	float isig = sqrt(ibar2 - ibar*ibar);
+
+	float bias = 127.5f - ibar;
+	float gain = AVG_STD_DEV / isig;
+
+	// no dependence between samples, so the loop can be vectorised
+	for (int k = 0; k < len; k++)
+	{
+		float intensity = (band[k] - ibar)*gain + ibar + bias;
+		band[k] = intensity * bins_per_intensity;
+	}
+}
+
+//------------------------------------vote()-------------------------------------------
+// add the trilinear votes of the samples to one histogram per band
+//Precondition: the following parameters must be correclty defined.
+//parameters:
+	//RBin, CBin: rotated bin coordinates of the samples
+	//ibins: intensity bin coordinates of each band, as left by normalize()
+	//nbands: number of bands, at most MAX_BANDS
+	//len: number of samples
+	//d, n: histogram width and intensity bins
+	//hists: nbands cell-major histograms of (d + 2)*(d + 2)*(n + 2) floats, zeroed
+//Postcondition: the votes of every band are added to its histogram
+//-------------------------------------------------------------------------------------
+void IntensityHistogram::vote(const float* RBin, const float* CBin, const float* const* ibins, int nbands, int len,
+	int d, int n, float* const* hists)
+{
+	CV_Assert(nbands > 0 && nbands <= MAX_BANDS);
+
+	int rowStep = (d + 2)*(n + 2), cellStep = n + 2;
+#if CV_SSE2
+	bool useSSE2 = checkHardwareSupport(CV_CPU_SSE2);
+#endif
+
+	for (int k = 0; k < len; k++)
+	{
+		float rbin = RBin[k], cbin = CBin[k];
+
+		int r0 = cvFloor(rbin);
+		int c0 = cvFloor(cbin);
+
+		rbin -= r0;
+		cbin -= c0;
+
+		// spatial weights, shared by the bands
+		float v_r1 = rbin, v_r0 = 1 - v_r1;
+		float v_rc11 = v_r1*cbin, v_rc10 = v_r1 - v_rc11;
+		float v_rc01 = v_r0*cbin, v_rc00 = v_r0 - v_rc01;
+
+		int cell = ((r0 + 1)*(d + 2) + c0 + 1)*cellStep;
+
+#if CV_SSE2
+		if (useSSE2)
+		{
+			// lanes hold the four spatial corners; each unpack pairs a corner's lower and
+			// upper intensity bin, which sit next to each other in the histogram
+			__m128 rc = _mm_setr_ps(v_rc00, v_rc01, v_rc10, v_rc11);
+			for (int b = 0; b < nbands; b++)
+			{
+				float ibin = ibins[b][k];
+				int i0 = cvFloor(ibin);
+				ibin -= i0;
+
+				__m128 upper = _mm_mul_ps(rc, _mm_set1_ps(ibin)), lower = _mm_sub_ps(rc, upper);
+				__m128 v0 = _mm_unpacklo_ps(lower, upper), v1 = _mm_unpackhi_ps(lower, upper);
+
+				float* hist = hists[b] + cell + i0;
+				__m128 h0 = _mm_loadh_pi(_mm_loadl_pi(v0, (const __m64*)hist), (const __m64*)(hist + cellStep));
+				__m128 h1 = _mm_loadh_pi(_mm_loadl_pi(v1, (const __m64*)(hist + rowStep)),
+					(const __m64*)(hist + rowStep + cellStep));
+				h0 = _mm_add_ps(h0, v0);
+				h1 = _mm_add_ps(h1, v1);
+				_mm_storel_pi((__m64*)hist, h0);
+				_mm_storeh_pi((__m64*)(hist + cellStep), h0);
+				_mm_storel_pi((__m64*)(hist + rowStep), h1);
+				_mm_storeh_pi((__m64*)(hist + rowStep + cellStep), h1);
+			}
+			continue;
+		}
+#endif
+		for (int b = 0; b < nbands; b++)
+		{
+			float ibin = ibins[b][k];
+			int i0 = cvFloor(ibin);
+			ibin -= i0;
+
+			float v_rco111 = v_rc11*ibin, v_rco110 = v_rc11 - v_rco111;
+			float v_rco101 = v_rc10*ibin, v_rco100 = v_rc10 - v_rco101;
+			float v_rco011 = v_rc01*ibin, v_rco010 = v_rc01 - v_rco011;
+			float v_rco001 = v_rc00*ibin, v_rco000 = v_rc00 - v_rco001;
+
+			float* hist = hists[b] + cell + i0;
+			hist[0] += v_rco000;
+			hist[1] += v_rco001;
+			hist[cellStep] += v_rco010;
+			hist[cellStep + 1] += v_rco011;
+			hist[rowStep] += v_rco100;
+			hist[rowStep + 1] += v_rco101;
+			hist[rowStep + cellStep] += v_rco110;
+			hist[rowStep + cellStep + 1] += v_rco111;
+		}
+	}
+}
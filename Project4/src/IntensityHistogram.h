@@ -0,0 +1,69 @@
+//-------------------------------------------------------------------------
+// Name: IntensityHistogram.h
+// Description: Shared engine for the normalised intensity descriptors (HoNI,
+//  CHoNI). The samples of the rotated window are gathered once into planar
+//  band arrays, each band is bias/gain normalised and turned into intensity
+//  bin coordinates with straight loops over the arrays, and the trilinear
+//  votes are cast for all bands of a sample together, since the spatial
+//  weights of a sample are the same for every band.
+// Methods:
+//			gather()
+//			normalize()
+//			vote()
+//-------------------------------------------------------------------------
+
+#ifndef INTENSITY_HISTOGRAM_H
+#define INTENSITY_HISTOGRAM_H
+
+#include "opencv2/opencv.hpp"
+
+using namespace std;
+using namespace cv;
+
+#ifdef __cplusplus
+
+class IntensityHistogram
+{
+public:
+	static const int MAX_BANDS = 3;
+	static const float AVG_STD_DEV;		// standard deviation greylevels are normalised to
+
+//------------------------------------gather()-----------------------------------------
+// copy the window samples of every channel into planar band arrays
+//Precondition: the following parameters must be correclty defined.
+//parameters:
+	//img: CV_32F image with at most MAX_BANDS channels
+	//R, C: sample pixel coordinates
+	//len: number of samples
+	//bands: img.channels() arrays of len floats, in channel order
+//Postcondition: bands[b][k] holds channel b of sample k
+//-------------------------------------------------------------------------------------
+	static void gather(const Mat& img, const int* R, const int* C, int len, float* const* bands);
+
+//------------------------------------normalize()--------------------------------------
+// normalise a band to mean 127.5 and standard deviation AVG_STD_DEV and convert it
+// to intensity bin coordinates
+//Precondition: band holds len > 0 intensities
+//Postcondition: band[k] holds the intensity bin coordinate of sample k
+//-------------------------------------------------------------------------------------
+	static void normalize(float* band, int len, float bins_per_intensity);
+
+//------------------------------------vote()-------------------------------------------
+// add the trilinear votes of the samples to one histogram per band
+//Precondition: the following parameters must be correclty defined.
+//parameters:
+	//RBin, CBin: rotated bin coordinates of the samples
+	//ibins: intensity bin coordinates of each band, as left by normalize()
+	//nbands: number of bands, at most MAX_BANDS
+	//len: number of samples
+	//d, n: histogram width and intensity bins
+	//hists: nbands cell-major histograms of (d + 2)*(d + 2)*(n + 2) floats, zeroed
+//Postcondition: the votes of every band are added to its histogram
+//-------------------------------------------------------------------------------------
+	static void vote(const float* RBin, const float* CBin, const float* const* ibins, int nbands, int len,
+		int d, int n, float* const* hists);
+};
+
+#endif /* __cplusplus */
+
+#endif
@@ -0,0 +1,89 @@
+#include "LateFusionMatcher.h"
+
+/*!
+	Finds the nearest train row of a range of query rows under one weighting
+*/
+class FuseRowsBody : public ParallelLoopBody
+{
+public:
+	FuseRowsBody(const vector<Mat>& _distances, const vector<float>& _weights, vector<DMatch>& _matches)
+		: distances(_distances), weights(_weights), matches(_matches) {}
+
+	virtual void operator()(const Range& range) const
+	{
+		int cols = distances[0].cols;
+		vector<float> sum(cols);
+
+		for (int i = range.start; i < range.end; i++)
+		{
+			std::fill(sum.begin(), sum.end(), 0.f);
+			for (size_t k = 0; k < distances.size(); k++)
+			{
+				float w = weights[k];
+				if (w == 0)
+					continue;
+				const float* d = distances[k].ptr<float>(i);
+				for (int j = 0; j < cols; j++)
+					sum[j] += w * d[j];
+			}
+
+			// equally distant rows resolve to the first one, as with BFMatcher
+			int best = 0;
+			for (int j = 1; j < cols; j++)
+				if (sum[j] < sum[best])
+					best = j;
+			matches[i] = DMatch(i, best, 0, std::sqrt(std::max(sum[best], 0.f)));
+		}
+	}
+
+private:
+	const vector<Mat>& distances;
+	const vector<float>& weights;
+	vector<DMatch>& matches;
+};
+
+//------------------------------------LateFusionMatcher()------------------------------
+// measure every part of the query descriptors against the same part of the train ones
+//Precondition: query and train hold the parts in the same order; the parts of one
+//				side have the same number of rows, the two sides of one part the same
+//				type and number of columns
+//Postcondition: the squared distance matrix of every part is kept
+//-------------------------------------------------------------------------------------
+LateFusionMatcher::LateFusionMatcher(const vector<Mat>& query, const vector<Mat>& train)
+	: distances(query.size()), queryRows(0), trainRows(0)
+{
+	CV_Assert(query.size() == train.size() && !query.empty());
+	queryRows = query[0].rows;
+	trainRows = train[0].rows;
+	if (queryRows == 0 || trainRows == 0)
+		return;
+
+	for (size_t k = 0; k < query.size(); k++)
+	{
+		CV_Assert(query[k].rows == queryRows && train[k].rows == trainRows);
+		batchDistance(query[k], train[k], distances[k], CV_32F, noArray(), NORM_L2SQR);
+	}
+}
+
+//------------------------------------match()------------------------------------------
+// find the nearest train row of every query row under a weighting of the parts
+//Precondition: weights holds one non-negative weight per part
+//Postcondition: matches holds one match per query row in query order, whose
+//				 distance is sqrt(sum of weight * squared part distance); it is
+//				 empty if there are no query or no train rows
+//-------------------------------------------------------------------------------------
+void LateFusionMatcher::match(const vector<float>& weights, vector<DMatch>& matches) const
+{
+	CV_Assert(weights.size() == distances.size());
+	matches.clear();
+	if (queryRows == 0 || trainRows == 0)
+		return;
+
+	matches.resize(queryRows);
+	parallel_for_(Range(0, queryRows), FuseRowsBody(distances, weights, matches));
+}
+
+int LateFusionMatcher::parts() const
+{
+	return (int)distances.size();
+}
@@ -0,0 +1,62 @@
+//-------------------------------------------------------------------------
+// Name: LateFusionMatcher.h
+// Description: Matches the parts of a stacked descriptor (e.g. the SIFT,
+//  HoNC and HoWH of SIFT+HoNC+HoWH) separately and combines them at the
+//  distance level instead of concatenating them. The squared L2 distances
+//  between every query and every train row are computed once per part;
+//  a weighted combination is then the square root of the weighted sum of
+//  those matrices, so any number of weightings can be evaluated without
+//  touching the descriptors again. With every weight 1 the combined
+//  distance is the distance between the stacked descriptors.
+// Methods:
+//			LateFusionMatcher()
+//			match()
+//			parts()
+//-------------------------------------------------------------------------
+
+#ifndef LATE_FUSION_MATCHER_H
+#define LATE_FUSION_MATCHER_H
+
+#include "opencv2/opencv.hpp"
+#include <vector>
+
+using namespace std;
+using namespace cv;
+
+#ifdef __cplusplus
+
+class LateFusionMatcher
+{
+public:
+//------------------------------------LateFusionMatcher()------------------------------
+// measure every part of the query descriptors against the same part of the train ones
+//Precondition: query and train hold the parts in the same order; the parts of one
+//				side have the same number of rows, the two sides of one part the same
+//				type and number of columns
+//Postcondition: the squared distance matrix of every part is kept
+//-------------------------------------------------------------------------------------
+	LateFusionMatcher(const vector<Mat>& query, const vector<Mat>& train);
+
+//------------------------------------match()------------------------------------------
+// find the nearest train row of every query row under a weighting of the parts
+//Precondition: weights holds one non-negative weight per part
+//Postcondition: matches holds one match per query row in query order, whose
+//				 distance is sqrt(sum of weight * squared part distance); it is
+//				 empty if there are no query or no train rows
+//-------------------------------------------------------------------------------------
+	void match(const vector<float>& weights, vector<DMatch>& matches) const;
+
+//------------------------------------parts()------------------------------------------
+// the number of parts
+//-------------------------------------------------------------------------------------
+	int parts() const;
+
+private:
+	vector<Mat> distances;		// per part, CV_32F, query rows by train columns
+	int queryRows;
+	int trainRows;
+};
+
+#endif /* __cplusplus */
+
+#endif
@@ -0,0 +1,259 @@
+#include "NNMatcher.h"
+#include "BlockMatcher.h"
+#include "PartialDistanceMatcher.h"
+#include "ByteMatcher.h"
+#include "HNSWIndex.h"
+#include <sstream>
+
+// a knob of params, or its default when the config line leaves it out
+static int knob(const vector<int>& params, size_t index, int defaultValue)
+{
+	return index < params.size() && params[index] > 0 ? params[index] : defaultValue;
+}
+
+/*!
+	OpenCV's exhaustive matcher
+*/
+class BruteForceNNMatcher : public NNMatcher
+{
+public:
+	virtual void match(const NNQuery& query, const Mat& train, vector<DMatch>& matches) const
+	{
+		BFMatcher matcher;
+		matches.clear();
+		if (!query.descriptors.empty() && !train.empty())
+			matcher.match(query.descriptors, train, matches);
+	}
+
+	virtual bool isExact() const { return true; }
+	virtual string name() const { return BRUTE_MATCHER; }
+};
+
+/*!
+	Exhaustive matching on matrix products, see BlockMatcher.h, or on integer
+	sums for byte descriptors, see ByteMatcher.h
+*/
+class BlockedNNMatcher : public NNMatcher
+{
+public:
+	virtual void match(const NNQuery& query, const Mat& train, vector<DMatch>& matches) const
+	{
+		if (query.descriptors.type() == CV_32F)
+			BlockMatcher::match(query.converted, train, matches, query.squaredNorms);
+		else if (query.descriptors.type() == CV_8U)
+			ByteMatcher::match(query.descriptors, train, matches);
+		else
+			BruteForceNNMatcher().match(query, train, matches);
+	}
+
+	virtual bool isExact() const { return true; }
+	virtual string name() const { return BLOCKED_MATCHER; }
+};
+
+/*!
+	Exhaustive matching that abandons pairs early, see PartialDistanceMatcher.h
+*/
+class PartialNNMatcher : public NNMatcher
+{
+public:
+	virtual void match(const NNQuery& query, const Mat& train, vector<DMatch>& matches) const
+	{
+		if (query.descriptors.type() == CV_32F)
+			PartialDistanceMatcher::match(query.converted, train, matches);
+		else if (query.descriptors.type() == CV_8U)
+			ByteMatcher::match(query.descriptors, train, matches);
+		else
+			BruteForceNNMatcher().match(query, train, matches);
+	}
+
+	virtual bool isExact() const { return true; }
+	virtual string name() const { return PARTIAL_MATCHER; }
+};
+
+/*!
+	Forest of randomised kd-trees searched with a budget of leaf checks
+*/
+class KDForestNNMatcher : public NNMatcher
+{
+public:
+	KDForestNNMatcher(int _trees, int _checks) : trees(_trees), checks(_checks) {}
+
+	virtual void match(const NNQuery& query, const Mat& train, vector<DMatch>& matches) const
+	{
+		matches.clear();
+		if (query.descriptors.empty() || train.empty())
+			return;
+
+		FlannBasedMatcher matcher(makePtr<flann::KDTreeIndexParams>(trees), makePtr<flann::SearchParams>(checks));
+		Mat train32;
+		train.convertTo(train32, CV_32F);
+		// the forest is built by the first match, from rand(), so every train set gets the same draws
+		cvflann::seed_random(1);
+		matcher.match(query.converted, train32, matches);
+		measure(query.descriptors, train, matches);
+	}
+
+	virtual bool isExact() const { return false; }
+
+	virtual bool isRandomised() const { return true; }
+
+	virtual string name() const
+	{
+		stringstream text;
+		text << KDFOREST_MATCHER << "(trees=" << trees << ", checks=" << checks << ")";
+		return text.str();
+	}
+
+private:
+	int trees, checks;
+};
+
+/*!
+	Searches the HNSW graph of the train descriptors for a range of queries
+*/
+class HNSWSearchBody : public ParallelLoopBody
+{
+public:
+	HNSWSearchBody(const HNSWIndex& _index, const Mat& _query, int _ef, vector<DMatch>& _matches)
+		: index(_index), query(_query), ef(_ef), matches(_matches) {}
+
+	virtual void operator()(const Range& range) const
+	{
+		HNSWIndex::VisitedNodes visited;
+		for (int i = range.start; i < range.end; i++)
+			matches[i] = DMatch(i, index.nearest(query.ptr<float>(i), ef, visited), 0, 0.f);
+	}
+
+private:
+	const HNSWIndex& index;
+	const Mat& query;
+	int ef;
+	vector<DMatch>& matches;
+};
+
+/*!
+	Hierarchical navigable small world graph, see HNSWIndex.h
+*/
+class HNSWNNMatcher : public NNMatcher
+{
+public:
+	HNSWNNMatcher(int _M, int _ef, int _efConstruction) : M(_M), ef(_ef), efConstruction(_efConstruction) {}
+
+	virtual void match(const NNQuery& query, const Mat& train, vector<DMatch>& matches) const
+	{
+		matches.clear();
+		if (query.descriptors.empty() || train.empty())
+			return;
+
+		// the graph is over the train descriptors, so it is built for every pair
+		Mat train32;
+		train.convertTo(train32, CV_32F);
+
+		HNSWIndex index(train32, M, efConstruction);
+		matches.resize(query.converted.rows);
+		parallel_for_(Range(0, query.converted.rows), HNSWSearchBody(index, query.converted, ef, matches));
+		measure(query.descriptors, train, matches);
+	}
+
+	virtual bool isExact() const { return false; }
+
+	virtual string name() const
+	{
+		stringstream text;
+		text << HNSW_MATCHER << "(M=" << M << ", ef=" << ef << ", efConstruction=" << efConstruction << ")";
+		return text.str();
+	}
+
+private:
+	int M, ef, efConstruction;
+};
+
+//------------------------------------create()-----------------------------------------
+// create the backend of the given name
+//Precondition: the following parameters must be correclty defined.
+//parameters:
+	//name: one of brute, blocked, partial, kdforest, hnsw
+	//params: accuracy knobs of the backend, missing ones take their defaults
+		//kdforest: number of trees (4), leaves checked per query (32)
+		//hnsw: links per node (16), search breadth (64), construction breadth (200)
+//Postcondition: the backend is returned; an unknown name is an error
+//-------------------------------------------------------------------------------------
+Ptr<NNMatcher> NNMatcher::create(const string& name, const vector<int>& params)
+{
+	if (name == BRUTE_MATCHER)
+		return makePtr<BruteForceNNMatcher>();
+	if (name == BLOCKED_MATCHER)
+		return makePtr<BlockedNNMatcher>();
+	if (name == PARTIAL_MATCHER)
+		return makePtr<PartialNNMatcher>();
+	if (name == KDFOREST_MATCHER)
+		return makePtr<KDForestNNMatcher>(knob(params, 0, 4), knob(params, 1, 32));
+	if (name == HNSW_MATCHER)
+		return makePtr<HNSWNNMatcher>(knob(params, 0, 16), knob(params, 1, 64), knob(params, 2, 200));
+
+	CV_Error(CV_StsBadArg, "Unknown matcher: " + name);
+	return Ptr<NNMatcher>();
+}
+
+//------------------------------------prepare()----------------------------------------
+// build the shared forms of query descriptors
+//Precondition: None
+//Postcondition: the prepared query is returned
+//-------------------------------------------------------------------------------------
+NNQuery NNMatcher::prepare(const Mat& query)
+{
+	NNQuery prepared;
+	prepared.descriptors = query;
+	if (query.type() == CV_32F)
+		prepared.converted = query;
+	else
+		query.convertTo(prepared.converted, CV_32F);
+	if (!prepared.converted.empty())
+		prepared.squaredNorms = BlockMatcher::squaredNorms(prepared.converted);
+	return prepared;
+}
+
+//------------------------------------match()------------------------------------------
+// find the nearest train descriptor of every query descriptor
+//Precondition: query and train have the same type and number of columns
+//Postcondition: matches holds one match per query row in query order, with its
+//				 exact L2 distance; it is empty if either matrix is empty
+//-------------------------------------------------------------------------------------
+void NNMatcher::match(const Mat& query, const Mat& train, vector<DMatch>& matches) const
+{
+	match(prepare(query), train, matches);
+}
+
+//------------------------------------recall()-----------------------------------------
+// the fraction of queries whose match is as near as the exact one
+//Precondition: approximate and exact hold one match per query, in query order
+//Postcondition: the recall is returned, 1 if there are no queries
+//-------------------------------------------------------------------------------------
+double NNMatcher::recall(const vector<DMatch>& approximate, const vector<DMatch>& exact)
+{
+	CV_Assert(approximate.size() == exact.size());
+	if (exact.empty())
+		return 1.0;
+
+	// a different train row at the same distance is an equally good answer
+	size_t found = 0;
+	for (size_t i = 0; i < exact.size(); i++)
+		if (approximate[i].trainIdx == exact[i].trainIdx || approximate[i].distance <= exact[i].distance)
+			found++;
+	return (double)found / exact.size();
+}
+
+//------------------------------------measure()----------------------------------------
+// replace the distances of the matches by exactly measured ones
+//Precondition: the matches refer to rows of query and train
+//Postcondition: every distance is the one BFMatcher would report for the pair
+//-------------------------------------------------------------------------------------
+void NNMatcher::measure(const Mat& query, const Mat& train, vector<DMatch>& matches)
+{
+	Mat dist;
+	for (size_t i = 0; i < matches.size(); i++)
+	{
+		batchDistance(query.row(matches[i].queryIdx), train.row(matches[i].trainIdx), dist, CV_32F, noArray(), NORM_L2);
+		matches[i].distance = dist.at<float>(0, 0);
+	}
+}
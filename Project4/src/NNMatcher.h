@@ -0,0 +1,134 @@
+//-------------------------------------------------------------------------
+// Name: NNMatcher.h
+// Description: Nearest neighbour backends used by DescriptorUtil::match().
+//  A backend finds, for every query descriptor, its nearest train
+//  descriptor under L2. The exact backends are OpenCV's BFMatcher, the
+//  BlockMatcher and the PartialDistanceMatcher, both of which hand byte
+//  descriptors to the ByteMatcher; the approximate ones are a forest of
+//  randomised kd-trees (FLANN) and a hierarchical navigable small world
+//  graph (HNSW), whose accuracy knobs trade recall for speed. The
+//  kd-trees are split on randomly drawn dimensions, seeded the same way
+//  for every match. Whatever the backend, the distance of a returned
+//  match is measured exactly, so matches from different backends are
+//  ranked the same way. The query descriptors can be prepared once and
+//  matched against several train sets.
+// Methods:
+//			create()
+//			prepare()
+//			match()
+//			isExact()
+//			isRandomised()
+//			name()
+//			recall()
+//-------------------------------------------------------------------------
+
+#ifndef NN_MATCHER_H
+#define NN_MATCHER_H
+
+#include "opencv2/opencv.hpp"
+#include <string>
+#include <vector>
+
+using namespace std;
+using namespace cv;
+
+#ifdef __cplusplus
+
+static const string BRUTE_MATCHER = "brute";
+static const string BLOCKED_MATCHER = "blocked";
+static const string PARTIAL_MATCHER = "partial";
+static const string KDFOREST_MATCHER = "kdforest";
+static const string HNSW_MATCHER = "hnsw";
+
+/*!
+	Query descriptors in the forms the backends read them, built once by
+	NNMatcher::prepare() and shared by every match against them
+*/
+struct NNQuery
+{
+	Mat descriptors;		// as computed
+	Mat converted;			// CV_32F, the same data when the descriptors already are
+	Mat squaredNorms;		// of the converted rows, for the blocked backend
+};
+
+class NNMatcher
+{
+public:
+	virtual ~NNMatcher() {}
+
+//------------------------------------create()-----------------------------------------
+// create the backend of the given name
+//Precondition: the following parameters must be correclty defined.
+//parameters:
+	//name: one of brute, blocked, partial, kdforest, hnsw
+	//params: accuracy knobs of the backend, missing ones take their defaults
+		//kdforest: number of trees (4), leaves checked per query (32)
+		//hnsw: links per node (16), search breadth (64), construction breadth (200)
+//Postcondition: the backend is returned; an unknown name is an error
+//-------------------------------------------------------------------------------------
+	static Ptr<NNMatcher> create(const string& name, const vector<int>& params = vector<int>());
+
+//------------------------------------prepare()----------------------------------------
+// build the shared forms of query descriptors
+//Precondition: None
+//Postcondition: the prepared query is returned
+//-------------------------------------------------------------------------------------
+	static NNQuery prepare(const Mat& query);
+
+//------------------------------------match()------------------------------------------
+// find the nearest train descriptor of every query descriptor
+//Precondition: query and train have the same type and number of columns
+//Postcondition: matches holds one match per query row in query order, with its
+//				 exact L2 distance; it is empty if either matrix is empty
+//-------------------------------------------------------------------------------------
+	void match(const Mat& query, const Mat& train, vector<DMatch>& matches) const;
+
+//------------------------------------match()------------------------------------------
+// as above, for a query prepared beforehand
+//Precondition: query comes from prepare(); its descriptors and train have the
+//				same type and number of columns
+//Postcondition: see above
+//-------------------------------------------------------------------------------------
+	virtual void match(const NNQuery& query, const Mat& train, vector<DMatch>& matches) const = 0;
+
+//------------------------------------isExact()----------------------------------------
+// returns whether the backend always finds the true nearest neighbour
+//Precondition: None
+//Postcondition: false is returned for the approximate backends
+//-------------------------------------------------------------------------------------
+	virtual bool isExact() const = 0;
+
+//------------------------------------isRandomised()-----------------------------------
+// returns whether the backend draws from the C library random numbers, which all
+// threads share, so only one match at a time is repeatable
+//Precondition: None
+//Postcondition: true is returned for the kdforest backend
+//-------------------------------------------------------------------------------------
+	virtual bool isRandomised() const { return false; }
+
+//------------------------------------name()-------------------------------------------
+// returns the backend name with its knobs, as written to the results
+//Precondition: None
+//Postcondition: the name is returned
+//-------------------------------------------------------------------------------------
+	virtual string name() const = 0;
+
+//------------------------------------recall()-----------------------------------------
+// the fraction of queries whose match is as near as the exact one
+//Precondition: approximate and exact hold one match per query, in query order
+//Postcondition: the recall is returned, 1 if there are no queries
+//-------------------------------------------------------------------------------------
+	static double recall(const vector<DMatch>& approximate, const vector<DMatch>& exact);
+
+protected:
+//------------------------------------measure()----------------------------------------
+// replace the distances of the matches by exactly measured ones
+//Precondition: the matches refer to rows of query and train
+//Postcondition: every distance is the one BFMatcher would report for the pair
+//-------------------------------------------------------------------------------------
+	static void measure(const Mat& query, const Mat& train, vector<DMatch>& matches);
+};
+
+#endif /* __cplusplus */
+
+#endif
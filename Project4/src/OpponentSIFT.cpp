@@ -75,7 +75,7 @@ namespace cv
 //------------------------------------operator()---------------------------------------
 // Overloading operator() to run the algorithm using color image:
 // 1. compute keypoints using local extrema of Dog space
-// 2. compute descriptors with keypoints and color pyramid
+// 2. compute descriptors with keypoints and the opponent levels of the color pyramid
 //Precondition: the following parameters must be correclty defined.
 //parameters:
 	//_image: color image base
@@ -120,19 +120,14 @@ namespace cv
 		}
 		// base is a grey image
 		Mat base = createInitialImage(image, firstOctave < 0, (float)sigma);
-		//initialize color image
-		Mat colorBase = createInitialColorImage(image, firstOctave < 0, (float)sigma);
-		convertBGRImageToOpponentColorSpace(colorBase);
 
-		vector<Mat> gpyr, dogpyr, colorGpyr; // colorGpyr is a gaussian pyramid for color image
+		vector<Mat> gpyr, dogpyr;
 		int nOctaves = actualNOctaves > 0 ? actualNOctaves : cvRound(log((double)std::min(base.cols, base.rows)) / log(2.) - 2) - firstOctave;
 
 		//double t, tf = getTickFrequency();
 		//t = (double)getTickCount();
 		buildGaussianPyramid(base, gpyr, nOctaves);
 		buildDoGPyramid(gpyr, dogpyr);
-		// build color gaussian pyramid
-		buildGaussianPyramid(colorBase, colorGpyr, nOctaves);
 		//t = (double)getTickCount() - t;
 		//printf("pyramid construction time: %g\n", t*1000./tf);
 
@@ -169,16 +164,27 @@ namespace cv
 		if (_descriptors.needed())
 		{
 			//t = (double)getTickCount();
-			int dsize = descriptorSize();
+			int dsize = outputSize();
 			_descriptors.create((int)keypoints.size(), dsize, CV_32F);
 			Mat descriptors = _descriptors.getMat();
-			calcDescriptors(colorGpyr, keypoints, descriptors, nOctaveLayers, firstOctave);
+			vector<Mat> opponentGpyr;
+			buildDescriptorPyramid(image, keypoints, firstOctave, nOctaves, opponentGpyr);
+			calcDescriptors(opponentGpyr, keypoints, descriptors, nOctaveLayers, firstOctave);
 			//t = (double)getTickCount() - t;
 			//printf("descriptor extraction time: %g\n", t*1000./tf);
 		}
 	}
 
 
+// the opponent transform is linear, so the opponent levels are derived from the
+// shared RGB pyramid once the keypoints are known
+	void OpponentSIFT::buildDescriptorPyramid(const Mat& image, const std::vector<KeyPoint>& keypoints, int firstOctave, int nOctaves, std::vector<Mat>& pyr) const
+	{
+		Ptr<vector<Mat> > colorGpyr = getColorPyramid(image, firstOctave, nOctaves);
+		transformPyramidLevels(*colorGpyr, keypoints, nOctaveLayers, firstOctave, ColorTransform::opponent, pyr);
+	}
+
+
 //------------------------------ convertBGRImageToOpponentColorSpace ----------
 // Convert the BGR image to opponent color space 
 // Preconditions:  1. bgrImage must be valid
@@ -189,44 +195,12 @@ namespace cv
 	{
 		if (bgrImage.type() != CV_32FC3)
 			CV_Error(CV_StsBadArg, "input image must be an BGR image of type CV_32FC3");
-		
-		for (int y = 0; y < bgrImage.rows; ++y) {
-			for (int x = 0; x < bgrImage.cols; ++x) {
-				Vec3f v = bgrImage.at<Vec3f>(y, x);
-				float& b = v[0];
-				float& g = v[1];
-				float& r = v[2];
-
-				bgrImage.at<Vec3f>(y, x)[0] = ((r - g) / sqrtf(2));	
-				bgrImage.at<Vec3f>(y, x)[1] = ((r + g - 2 * b) / sqrtf(6));
-				bgrImage.at<Vec3f>(y, x)[2] = ((r + g + b) / sqrtf(3));
-			}
-		}
+
+		ColorTransform::opponent(bgrImage, bgrImage);
 	}
 }
 
 void OpponentSIFT::normalizeHistogram(float *dst, int d, int n) const {
-	float nrm1sqr = 0, nrm2sqr = 0, nrm3sqr = 0;
-	int len = d*d*n;
-	for (int k = 0; k < len; k++) {
-		nrm1sqr += dst[k] * dst[k];
-		nrm2sqr += dst[k + len] * dst[k + len];
-		nrm3sqr += dst[k + 2 * len] * dst[k + 2 * len];
-	}
-	float nrm2 = max(nrm1sqr, max(nrm2sqr, nrm3sqr));
-	float thr = std::sqrt(nrm2)*SIFT_DESCR_MAG_THR;
-
-	nrm2 = 0;
-	for (int i = 0; i < 3 * len; i++)
-	{
-		float val = std::min(dst[i], thr);
-		dst[i] = val;
-		nrm2 += val * val;
-	}
-	nrm2 = SIFT_INT_DESCR_FCTR / std::max(std::sqrt(nrm2), FLT_EPSILON);
-
-	for (int k = 0; k < 3 * len; k++)
-	{
-		dst[k] = dst[k] * nrm2;
-	}
+	// the longest channel sets the clipping threshold, the stack is rescaled as a whole
+	DescriptorNormalizer::normalize(dst, 3 * d*d*n, DescriptorNormalizer::MAX_BLOCK_THRESHOLD, 3);
 }
\ No newline at end of file
@@ -38,7 +38,7 @@ namespace cv
 //------------------------------------operator()---------------------------------------
 // Overloading operator() to run the algorithm using color image:
 // 1. compute keypoints using local extrema of Dog space
-// 2. compute descriptors with keypoints and color pyramid
+// 2. compute descriptors with keypoints and the opponent levels of the color pyramid
 //Precondition: the following parameters must be correclty defined.
 //parameters:
 	//_image: color image base
@@ -63,6 +63,8 @@ namespace cv
 		static void convertBGRImageToOpponentColorSpace(Mat& bgrImage);
 
 	protected:
+		// opponent levels of the shared RGB pyramid
+		virtual void buildDescriptorPyramid(const Mat& image, const std::vector<KeyPoint>& keypoints, int firstOctave, int nOctaves, std::vector<Mat>& pyr) const;
 		virtual void normalizeHistogram(float *dst, int d, int n) const;
 	};
 
@@ -0,0 +1,118 @@
+#include "OrientationHistogram.h"
+
+//------------------------------------accumulate()-------------------------------------
+// vote the window samples of every channel and copy out the folded histograms
+//Precondition: the following parameters must be correclty defined.
+//parameters:
+	//RBin, CBin: rotated bin coordinates of the samples
+	//W: Gaussian weight of each sample
+	//Obin: per channel, the unwrapped orientation bin of each sample
+	//Mag: per channel, the gradient magnitude of each sample
+	//len: number of samples
+	//d: descr_width, 4 in this case
+	//n: descr_hist_bins, 8 in this case
+	//channels: number of gradient channels, 1 to MAX_CHANNELS
+	//dst: receives channels blocks of d*d*n values, before normalisation
+//Postcondition: dst is assigned
+//-------------------------------------------------------------------------------------
+void OrientationHistogram::accumulate(const float* RBin, const float* CBin, const float* W,
+	const float* const* Obin, const float* const* Mag, int len, int d, int n, int channels, float* dst)
+{
+	CV_Assert(channels >= 1 && channels <= MAX_CHANNELS);
+
+	if (d == 4 && n == 8)
+	{
+		// the shipped geometries, histograms on the stack
+		float hist[MAX_CHANNELS*(4 + 2)*(4 + 2)*(8 + 2)];
+
+		if (channels == 1)
+			accumulateGeometry<4, 8, 1>(RBin, CBin, W, Obin, Mag, len, d, n, channels, hist, dst);
+		else if (channels == 2)
+			accumulateGeometry<4, 8, 2>(RBin, CBin, W, Obin, Mag, len, d, n, channels, hist, dst);
+		else
+			accumulateGeometry<4, 8, 3>(RBin, CBin, W, Obin, Mag, len, d, n, channels, hist, dst);
+		return;
+	}
+
+	AutoBuffer<float> hist(channels*(d + 2)*(d + 2)*(n + 2));
+	accumulateGeometry<0, 0, 0>(RBin, CBin, W, Obin, Mag, len, d, n, channels, hist, dst);
+}
+
+//------------------------------------accumulateGeometry()-----------------------------
+// accumulate() for one geometry; a zero template argument means the size is
+// taken from the runtime argument instead
+//Precondition: hist holds channels*(d+2)*(d+2)*(n+2) floats
+//Postcondition: dst is assigned
+//-------------------------------------------------------------------------------------
+template<int D, int N, int CH>
+void OrientationHistogram::accumulateGeometry(const float* RBin, const float* CBin, const float* W,
+	const float* const* Obin, const float* const* Mag, int len, int d, int n, int channels,
+	float* hist, float* dst)
+{
+	// with constant template sizes these fold to constants
+	const int dd = D ? D : d, nn = N ? N : n, ch = CH ? CH : channels;
+	const int histlen = (dd + 2)*(dd + 2)*(nn + 2);
+	int i, j, k, c;
+
+	for (i = 0; i < ch*histlen; i++)
+		hist[i] = 0.;
+
+	for (k = 0; k < len; k++)
+	{
+		float rbin = RBin[k], cbin = CBin[k];
+		int r0 = cvFloor(rbin);
+		int c0 = cvFloor(cbin);
+		rbin -= r0;
+		cbin -= c0;
+		int cell = ((r0 + 1)*(dd + 2) + c0 + 1)*(nn + 2);
+
+		for (c = 0; c < ch; c++)
+		{
+			float obin = Obin[c][k];
+			float mag = Mag[c][k] * W[k];
+			int o0 = cvFloor(obin);
+			obin -= o0;
+
+			if (o0 < 0)
+				o0 += nn;
+			if (o0 >= nn)
+				o0 -= nn;
+
+			// histogram update using tri-linear interpolation
+			float v_r1 = mag*rbin, v_r0 = mag - v_r1;
+			float v_rc11 = v_r1*cbin, v_rc10 = v_r1 - v_rc11;
+			float v_rc01 = v_r0*cbin, v_rc00 = v_r0 - v_rc01;
+			float v_rco111 = v_rc11*obin, v_rco110 = v_rc11 - v_rco111;
+			float v_rco101 = v_rc10*obin, v_rco100 = v_rc10 - v_rco101;
+			float v_rco011 = v_rc01*obin, v_rco010 = v_rc01 - v_rco011;
+			float v_rco001 = v_rc00*obin, v_rco000 = v_rc00 - v_rco001;
+
+			float* h = hist + c*histlen + cell + o0;
+			h[0] += v_rco000;
+			h[1] += v_rco001;
+			h[(nn + 2)] += v_rco010;
+			h[(nn + 3)] += v_rco011;
+			h[(dd + 2)*(nn + 2)] += v_rco100;
+			h[(dd + 2)*(nn + 2) + 1] += v_rco101;
+			h[(dd + 3)*(nn + 2)] += v_rco110;
+			h[(dd + 3)*(nn + 2) + 1] += v_rco111;
+		}
+	}
+
+	// finalize histogram, since the orientation histograms are circular
+	for (c = 0; c < ch; c++)
+	{
+		float* h = hist + c*histlen;
+		float* out = dst + c*dd*dd*nn;
+
+		for (i = 0; i < dd; i++)
+			for (j = 0; j < dd; j++)
+			{
+				int idx = ((i + 1)*(dd + 2) + (j + 1))*(nn + 2);
+				h[idx] += h[idx + nn];
+				h[idx + 1] += h[idx + nn + 1];
+				for (k = 0; k < nn; k++)
+					out[(i*dd + j)*nn + k] = h[idx + k];
+			}
+	}
+}
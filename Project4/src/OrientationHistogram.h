@@ -0,0 +1,63 @@
+//-------------------------------------------------------------------------
+// Name: OrientationHistogram.h
+// Description: Tri-linear voting of the SIFT-family descriptors. The
+//  samples of a descriptor window vote their weighted gradient magnitude
+//  into a d x d grid of n orientation bins, one grid per gradient channel,
+//  and the circular orientation bins are folded when the grids are copied
+//  out. The voting loop is a template on (d, n, channels). The geometries
+//  shipped with the descriptors (4 x 4 x 8 with one, two or three
+//  channels) are instantiated with constant sizes, so the index maths
+//  folds and the histograms live on the stack; any other geometry runs
+//  the same code with runtime sizes.
+// Methods:
+//			accumulate()
+//-------------------------------------------------------------------------
+
+#ifndef ORIENTATION_HISTOGRAM_H
+#define ORIENTATION_HISTOGRAM_H
+
+#include "opencv2/opencv.hpp"
+
+using namespace cv;
+
+#ifdef __cplusplus
+
+class OrientationHistogram
+{
+public:
+	static const int MAX_CHANNELS = 3;		// gradient channels of the largest descriptor
+
+//------------------------------------accumulate()-------------------------------------
+// vote the window samples of every channel and copy out the folded histograms
+//Precondition: the following parameters must be correclty defined.
+//parameters:
+	//RBin, CBin: rotated bin coordinates of the samples
+	//W: Gaussian weight of each sample
+	//Obin: per channel, the unwrapped orientation bin of each sample
+	//Mag: per channel, the gradient magnitude of each sample
+	//len: number of samples
+	//d: descr_width, 4 in this case
+	//n: descr_hist_bins, 8 in this case
+	//channels: number of gradient channels, 1 to MAX_CHANNELS
+	//dst: receives channels blocks of d*d*n values, before normalisation
+//Postcondition: dst is assigned
+//-------------------------------------------------------------------------------------
+	static void accumulate(const float* RBin, const float* CBin, const float* W,
+		const float* const* Obin, const float* const* Mag, int len, int d, int n, int channels, float* dst);
+
+private:
+//------------------------------------accumulateGeometry()-----------------------------
+// accumulate() for one geometry; a zero template argument means the size is
+// taken from the runtime argument instead
+//Precondition: hist holds channels*(d+2)*(d+2)*(n+2) floats
+//Postcondition: dst is assigned
+//-------------------------------------------------------------------------------------
+	template<int D, int N, int CH>
+	static void accumulateGeometry(const float* RBin, const float* CBin, const float* W,
+		const float* const* Obin, const float* const* Mag, int len, int d, int n, int channels,
+		float* hist, float* dst);
+};
+
+#endif /* __cplusplus */
+
+#endif
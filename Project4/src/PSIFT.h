@@ -1,4 +1,4 @@
-/* RG SIFT generates descriptors by stacking SIFT descriptors for the R/(R+G+B) and G/(R+G+B) channels. */
+/* PSIFT generates 128-float descriptors by pooling (summing) the R, G and B blocks of RGB SIFT. */
 #ifndef __OPENCV_P_SIFT_H__
 #define __OPENCV_P_SIFT_H__
 
@@ -18,10 +18,6 @@ namespace cv
 			return makePtr<PSIFT>(PSIFT());
 		};
 		CV_WRAP explicit PSIFT();
-
-	protected:
-		void calcSIFTDescriptor(const Mat& img, Point2f ptf, float ori, float scl, int d, int n, float* dst) const;
-		void normalizePoolHist(float *dst, int d, int n) const;
 	};
 
 } /* namespace cv */
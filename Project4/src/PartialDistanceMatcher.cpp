@@ -0,0 +1,161 @@
+#include "PartialDistanceMatcher.h"
+#include <algorithm>
+
+// Bound, in units of FLT_EPSILON per descriptor dimension, on the relative
+// difference between two orders of summing the same squared differences, taken
+// twice since both this matcher's sum and BFMatcher's are off by up to it
+static const float SUMMATION_ERROR = 4.f;
+static const float SUMMATION_ERROR_SLACK = 16.f;
+
+/*!
+	Matches a range of query rows, abandoning train rows on their partial sums
+*/
+class PartialDistanceBody : public ParallelLoopBody
+{
+public:
+	PartialDistanceBody(const Mat& _query, const Mat& _train, const Mat& _sortedQuery, const Mat& _sortedTrain,
+		vector<DMatch>& _matches)
+		: query(_query), train(_train), sortedQuery(_sortedQuery), sortedTrain(_sortedTrain), matches(_matches) {}
+
+	virtual void operator()(const Range& range) const
+	{
+		int cols = sortedQuery.cols;
+		float errorScale = (SUMMATION_ERROR * cols + SUMMATION_ERROR_SLACK) * FLT_EPSILON;
+		vector<pair<int, float> > cand;
+		Mat dist;
+
+		for (int i = range.start; i < range.end; i++)
+		{
+			const float* q = sortedQuery.ptr<float>(i);
+			float best = FLT_MAX, limit = FLT_MAX;
+			cand.clear();
+
+			for (int j = 0; j < sortedTrain.rows; j++)
+			{
+				const float* t = sortedTrain.ptr<float>(j);
+				float sum = 0;
+				int k = 0;
+
+				// the sum only grows, so once past the limit the row cannot be kept
+				for (; k < cols; k += PartialDistanceMatcher::CHUNK)
+				{
+					int end = std::min(k + PartialDistanceMatcher::CHUNK, cols);
+					for (int c = k; c < end; c++)
+					{
+						float diff = q[c] - t[c];
+						sum += diff * diff;
+					}
+					if (sum > limit)
+						break;
+				}
+				if (k < cols)
+					continue;
+
+				cand.push_back(make_pair(j, sum));
+				if (sum < best)
+				{
+					best = sum;
+					limit = best + best * errorScale;
+
+					size_t kept = 0;
+					for (size_t n = 0; n < cand.size(); n++)
+						if (cand[n].second <= limit)
+							cand[kept++] = cand[n];
+					cand.resize(kept);
+				}
+			}
+
+			// measure the candidates like BFMatcher, in train order
+			int bestIdx = -1;
+			float bestDist = FLT_MAX;
+			for (size_t n = 0; n < cand.size(); n++)
+			{
+				batchDistance(query.row(i), train.row(cand[n].first), dist, CV_32F, noArray(), NORM_L2);
+				float d = dist.at<float>(0, 0);
+				if (d < bestDist || bestIdx < 0)
+				{
+					bestDist = d;
+					bestIdx = cand[n].first;
+				}
+			}
+			matches[i] = DMatch(i, bestIdx, 0, bestDist);
+		}
+	}
+
+private:
+	const Mat& query;
+	const Mat& train;
+	const Mat& sortedQuery;
+	const Mat& sortedTrain;
+	vector<DMatch>& matches;
+};
+
+//------------------------------------match()------------------------------------------
+// find the nearest train descriptor of every query descriptor
+//Precondition: query and train are CV_32F with the same number of columns
+//Postcondition: matches holds one match per query row in query order, as
+//				 BFMatcher(NORM_L2).match() would return; it is empty if either
+//				 matrix is empty
+//-------------------------------------------------------------------------------------
+void PartialDistanceMatcher::match(const Mat& query, const Mat& train, vector<DMatch>& matches)
+{
+	matches.clear();
+	if (query.empty() || train.empty())
+		return;
+
+	CV_Assert(query.type() == CV_32F && train.type() == CV_32F && query.cols == train.cols);
+
+	vector<int> order = dimensionOrder(train);
+	Mat sortedQuery = permuteColumns(query, order), sortedTrain = permuteColumns(train, order);
+
+	matches.resize(query.rows);
+	parallel_for_(Range(0, query.rows), PartialDistanceBody(query, train, sortedQuery, sortedTrain, matches));
+}
+
+//------------------------------------dimensionOrder()---------------------------------
+// the columns of the train descriptors by decreasing variance
+//Precondition: train is CV_32F and not empty
+//Postcondition: a permutation of the column indices is returned
+//-------------------------------------------------------------------------------------
+vector<int> PartialDistanceMatcher::dimensionOrder(const Mat& train)
+{
+	vector<double> sum(train.cols, 0.0), sumSq(train.cols, 0.0);
+	for (int j = 0; j < train.rows; j++)
+	{
+		const float* row = train.ptr<float>(j);
+		for (int c = 0; c < train.cols; c++)
+		{
+			sum[c] += row[c];
+			sumSq[c] += (double)row[c] * row[c];
+		}
+	}
+
+	vector<pair<double, int> > variance(train.cols);
+	for (int c = 0; c < train.cols; c++)
+	{
+		double mean = sum[c] / train.rows;
+		variance[c] = make_pair(-(sumSq[c] / train.rows - mean * mean), c);
+	}
+	std::sort(variance.begin(), variance.end());
+
+	vector<int> order(train.cols);
+	for (int c = 0; c < train.cols; c++)
+		order[c] = variance[c].second;
+	return order;
+}
+
+//------------------------------------permuteColumns()---------------------------------
+// a copy of descriptors with its columns in the given order
+//-------------------------------------------------------------------------------------
+Mat PartialDistanceMatcher::permuteColumns(const Mat& descriptors, const vector<int>& order)
+{
+	Mat permuted(descriptors.rows, descriptors.cols, CV_32F);
+	for (int i = 0; i < descriptors.rows; i++)
+	{
+		const float* src = descriptors.ptr<float>(i);
+		float* dst = permuted.ptr<float>(i);
+		for (int c = 0; c < descriptors.cols; c++)
+			dst[c] = src[order[c]];
+	}
+	return permuted;
+}
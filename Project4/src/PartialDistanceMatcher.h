@@ -0,0 +1,58 @@
+//-------------------------------------------------------------------------
+// Name: PartialDistanceMatcher.h
+// Description: Brute-force nearest neighbour matcher for float descriptors
+//  that stops measuring a pair as soon as it cannot be the nearest. The
+//  squared distance is accumulated a few dimensions at a time, with the
+//  dimensions of most variance over the train descriptors first, and a
+//  train row is abandoned once its partial sum passes the best full one
+//  found so far for the query. Long stacked descriptors are mostly
+//  rejected after a fraction of their dimensions. The summation order is
+//  not BFMatcher's, so rows within rounding of the best are kept and
+//  measured again with batchDistance(); the matches are the same as
+//  BFMatcher's. Query rows are matched in parallel.
+// Methods:
+//			match()
+//-------------------------------------------------------------------------
+
+#ifndef PARTIAL_DISTANCE_MATCHER_H
+#define PARTIAL_DISTANCE_MATCHER_H
+
+#include "opencv2/opencv.hpp"
+#include <vector>
+
+using namespace std;
+using namespace cv;
+
+#ifdef __cplusplus
+
+class PartialDistanceMatcher
+{
+public:
+	static const int CHUNK = 16;		// dimensions summed between two checks
+
+//------------------------------------match()------------------------------------------
+// find the nearest train descriptor of every query descriptor
+//Precondition: query and train are CV_32F with the same number of columns
+//Postcondition: matches holds one match per query row in query order, as
+//				 BFMatcher(NORM_L2).match() would return; it is empty if either
+//				 matrix is empty
+//-------------------------------------------------------------------------------------
+	static void match(const Mat& query, const Mat& train, vector<DMatch>& matches);
+
+private:
+//------------------------------------dimensionOrder()---------------------------------
+// the columns of the train descriptors by decreasing variance
+//Precondition: train is CV_32F and not empty
+//Postcondition: a permutation of the column indices is returned
+//-------------------------------------------------------------------------------------
+	static vector<int> dimensionOrder(const Mat& train);
+
+//------------------------------------permuteColumns()---------------------------------
+// a copy of descriptors with its columns in the given order
+//-------------------------------------------------------------------------------------
+	static Mat permuteColumns(const Mat& descriptors, const vector<int>& order);
+};
+
+#endif /* __cplusplus */
+
+#endif
@@ -91,6 +91,28 @@ namespace cv
 		}
 	}
 
+	// the RGB pyramid only depends on the image and the pyramid parameters, so
+	// every colour descriptor of the same image can share it
+	Ptr<vector<Mat> > RGBSIFT::getColorPyramid(const Mat& img, int firstOctave, int nOctaves) const
+	{
+		ColorPyramidKey key = { firstOctave, nOctaves, nOctaveLayers, sigma };
+
+		Ptr<vector<Mat> > colorGpyr = ColorPyramidCache::find(img, key);
+		if (colorGpyr.empty())
+		{
+			colorGpyr = makePtr<vector<Mat> >();
+			Mat colorBase = createInitialColorImage(img, firstOctave < 0, (float)sigma);
+			buildGaussianPyramid(colorBase, *colorGpyr, nOctaves);
+			ColorPyramidCache::store(img, key, colorGpyr);
+		}
+		return colorGpyr;
+	}
+
+	void RGBSIFT::buildDescriptorPyramid(const Mat& image, const std::vector<KeyPoint>& keypoints, int firstOctave, int nOctaves, std::vector<Mat>& pyr) const
+	{
+		pyr = *getColorPyramid(image, firstOctave, nOctaves);
+	}
+
 
 
 
@@ -110,183 +132,46 @@ namespace cv
 		//s< "d : " << d << " n: " << n << endl;
 		
 		Point pt(cvRound(ptf.x), cvRound(ptf.y));
-		float cos_t = cosf(ori*(float)(CV_PI / 180));
-		float sin_t = sinf(ori*(float)(CV_PI / 180));
-		float bins_per_rad = n / 360.f;
-		float exp_scale = -1.f / (d * d * 0.5f);
 		float hist_width = SIFT_DESCR_SCL_FCTR * scl;
 		int radius = cvRound(hist_width * 1.4142135623730951f * (d + 1) * 0.5f);
 		// Clip the radius to the diagonal of the image to avoid autobuffer too large exception
 		radius = std::min(radius, (int)sqrt((double)img.cols*img.cols + img.rows*img.rows));
-		cos_t /= hist_width;
-		sin_t /= hist_width;
 
-		int i, j, k, len = (radius * 2 + 1)*(radius * 2 + 1), histlen = (d + 2)*(d + 2)*(n + 2);
+		int k, len = (radius * 2 + 1)*(radius * 2 + 1);
 		int rows = img.rows, cols = img.cols;
 
-		AutoBuffer<float> buf(len * 12 + histlen * 3);
+		AutoBuffer<float> buf(len * 12);
 		float *X1 = buf, *Y1 = X1 + len, *X2 = Y1 + len, *Y2 = X2 + len, *X3 = Y2 + len, *Y3 = X3 + len;
-		float *Mag1 = Y1, *Mag2 = Y2, *Mag3 = Y3, *Ori1 = Mag3 + len, *Ori2 = Ori1 + len, *Ori3 = Ori2 + len, *W = Ori3 + len;
-		float *RBin = W + len, *CBin = RBin + len, *hist1 = CBin + len, *hist2 = hist1 + histlen, *hist3 = hist2 + histlen;
+		float *Mag1 = Y1, *Mag2 = Y2, *Mag3 = Y3, *Obin1 = Mag3 + len, *Obin2 = Obin1 + len, *Obin3 = Obin2 + len, *W = Obin3 + len;
+		float *RBin = W + len, *CBin = RBin + len;
+		AutoBuffer<int> pos(len * 2);
+		int *R = pos, *C = R + len;
 
 		//float *pooledHist = new float[128];
 
-		for (i = 0; i < d + 2; i++)
-		{
-			for (j = 0; j < d + 2; j++) {
-				for (k = 0; k < n + 2; k++) {
-					hist1[(i*(d + 2) + j)*(n + 2) + k] = 0.;
-					hist2[(i*(d + 2) + j)*(n + 2) + k] = 0.;
-					hist3[(i*(d + 2) + j)*(n + 2) + k] = 0.;
-				}
-			}
-		}
-
-		for (i = -radius, k = 0; i <= radius; i++)
-			for (j = -radius; j <= radius; j++)
-			{
-				// Calculate sample's histogram array coords rotated relative to ori.
-				// Subtract 0.5 so samples that fall e.g. in the center of row 1 (i.e.
-				// r_rot = 1.5) have full weight placed in row 1 after interpolation.
-				float c_rot = j * cos_t - i * sin_t;
-				float r_rot = j * sin_t + i * cos_t;
-				float rbin = r_rot + d / 2 - 0.5f;
-				float cbin = c_rot + d / 2 - 0.5f;
-				int r = pt.y + i, c = pt.x + j;
-
-				if (rbin > -1 && rbin < d && cbin > -1 && cbin < d &&
-					r > 0 && r < rows - 1 && c > 0 && c < cols - 1)
-				{
-					X1[k] = (img.at<Vec3f>(r, c + 1)[0] - img.at<Vec3f>(r, c - 1)[0]);
-					Y1[k] = (img.at<Vec3f>(r - 1, c)[0] - img.at<Vec3f>(r + 1, c)[0]);
-					X2[k] = (img.at<Vec3f>(r, c + 1)[1] - img.at<Vec3f>(r, c - 1)[1]);
-					Y2[k] = (img.at<Vec3f>(r - 1, c)[1] - img.at<Vec3f>(r + 1, c)[1]);
-					X3[k] = (img.at<Vec3f>(r, c + 1)[2] - img.at<Vec3f>(r, c - 1)[2]);
-					Y3[k] = (img.at<Vec3f>(r - 1, c)[2] - img.at<Vec3f>(r + 1, c)[2]);
-					RBin[k] = rbin; CBin[k] = cbin;
-					W[k] = (c_rot * c_rot + r_rot * r_rot)*exp_scale;
-					k++;
-				}
-			}
-
-		len = k;
-		hal::fastAtan2(Y1, X1, Ori1, len, true);
-		hal::magnitude(X1, Y1, Mag1, len);
-		hal::fastAtan2(Y2, X2, Ori2, len, true);
-		hal::magnitude(X2, Y2, Mag2, len);
-		hal::fastAtan2(Y3, X3, Ori3, len, true);
-		hal::magnitude(X3, Y3, Mag3, len);
-		hal::exp(W, W, len);
+		// rotated bin coordinates and Gaussian weights of the window samples
+		len = SamplingPatternCache::collectSamples(pt, ori, hist_width, radius, d, rows, cols, R, C, RBin, CBin, W);
 
 		for (k = 0; k < len; k++)
 		{
-			float rbin = RBin[k], cbin = CBin[k];
-			float obin1 = (Ori1[k] - ori)*bins_per_rad;
-			float mag1 = Mag1[k] * W[k];
-			float obin2 = (Ori2[k] - ori)*bins_per_rad;
-			float mag2 = Mag2[k] * W[k];
-			float obin3 = (Ori3[k] - ori)*bins_per_rad;
-			float mag3 = Mag3[k] * W[k];
-
-			int r0 = cvFloor(rbin);
-			int c0 = cvFloor(cbin);
-			int o01 = cvFloor(obin1);
-			int o02 = cvFloor(obin2);
-			int o03 = cvFloor(obin3);
-			rbin -= r0;
-			cbin -= c0;
-			obin1 -= o01;
-			obin2 -= o02;
-			obin3 -= o03;
-
-			if (o01 < 0)
-				o01 += n;
-			if (o01 >= n)
-				o01 -= n;
-			if (o02 < 0)
-				o02 += n;
-			if (o02 >= n)
-				o02 -= n;
-			if (o03 < 0)
-				o03 += n;
-			if (o03 >= n)
-				o03 -= n;
-
-			// histogram update using tri-linear interpolation
-			float v1_r1 = mag1*rbin, v1_r0 = mag1 - v1_r1;
-			float v1_rc11 = v1_r1*cbin, v1_rc10 = v1_r1 - v1_rc11;
-			float v1_rc01 = v1_r0*cbin, v1_rc00 = v1_r0 - v1_rc01;
-			float v1_rco111 = v1_rc11*obin1, v1_rco110 = v1_rc11 - v1_rco111;
-			float v1_rco101 = v1_rc10*obin1, v1_rco100 = v1_rc10 - v1_rco101;
-			float v1_rco011 = v1_rc01*obin1, v1_rco010 = v1_rc01 - v1_rco011;
-			float v1_rco001 = v1_rc00*obin1, v1_rco000 = v1_rc00 - v1_rco001;
-
-			float v2_r1 = mag2*rbin, v2_r0 = mag2 - v2_r1;
-			float v2_rc11 = v2_r1*cbin, v2_rc10 = v2_r1 - v2_rc11;
-			float v2_rc01 = v2_r0*cbin, v2_rc00 = v2_r0 - v2_rc01;
-			float v2_rco111 = v2_rc11*obin2, v2_rco110 = v2_rc11 - v2_rco111;
-			float v2_rco101 = v2_rc10*obin2, v2_rco100 = v2_rc10 - v2_rco101;
-			float v2_rco011 = v2_rc01*obin2, v2_rco010 = v2_rc01 - v2_rco011;
-			float v2_rco001 = v2_rc00*obin2, v2_rco000 = v2_rc00 - v2_rco001;
-
-			float v3_r1 = mag3*rbin, v3_r0 = mag3 - v3_r1;
-			float v3_rc11 = v3_r1*cbin, v3_rc10 = v3_r1 - v3_rc11;
-			float v3_rc01 = v3_r0*cbin, v3_rc00 = v3_r0 - v3_rc01;
-			float v3_rco111 = v3_rc11*obin3, v3_rco110 = v3_rc11 - v3_rco111;
-			float v3_rco101 = v3_rc10*obin3, v3_rco100 = v3_rc10 - v3_rco101;
-			float v3_rco011 = v3_rc01*obin3, v3_rco010 = v3_rc01 - v3_rco011;
-			float v3_rco001 = v3_rc00*obin3, v3_rco000 = v3_rc00 - v3_rco001;
-
-			int idx = ((r0 + 1)*(d + 2) + c0 + 1)*(n + 2) + o01;
-			hist1[idx] += v1_rco000;
-			hist1[idx + 1] += v1_rco001;
-			hist1[idx + (n + 2)] += v1_rco010;
-			hist1[idx + (n + 3)] += v1_rco011;
-			hist1[idx + (d + 2)*(n + 2)] += v1_rco100;
-			hist1[idx + (d + 2)*(n + 2) + 1] += v1_rco101;
-			hist1[idx + (d + 3)*(n + 2)] += v1_rco110;
-			hist1[idx + (d + 3)*(n + 2) + 1] += v1_rco111;
-			idx = ((r0 + 1)*(d + 2) + c0 + 1)*(n + 2) + o02;
-			hist2[idx] += v2_rco000;
-			hist2[idx + 1] += v2_rco001;
-			hist2[idx + (n + 2)] += v2_rco010;
-			hist2[idx + (n + 3)] += v2_rco011;
-			hist2[idx + (d + 2)*(n + 2)] += v2_rco100;
-			hist2[idx + (d + 2)*(n + 2) + 1] += v2_rco101;
-			hist2[idx + (d + 3)*(n + 2)] += v2_rco110;
-			hist2[idx + (d + 3)*(n + 2) + 1] += v2_rco111;
-			idx = ((r0 + 1)*(d + 2) + c0 + 1)*(n + 2) + o03;
-			hist3[idx] += v3_rco000;
-			hist3[idx + 1] += v3_rco001;
-			hist3[idx + (n + 2)] += v3_rco010;
-			hist3[idx + (n + 3)] += v3_rco011;
-			hist3[idx + (d + 2)*(n + 2)] += v3_rco100;
-			hist3[idx + (d + 2)*(n + 2) + 1] += v3_rco101;
-			hist3[idx + (d + 3)*(n + 2)] += v3_rco110;
-			hist3[idx + (d + 3)*(n + 2) + 1] += v3_rco111;
+			int r = R[k], c = C[k];
+			X1[k] = (img.at<Vec3f>(r, c + 1)[0] - img.at<Vec3f>(r, c - 1)[0]);
+			Y1[k] = (img.at<Vec3f>(r - 1, c)[0] - img.at<Vec3f>(r + 1, c)[0]);
+			X2[k] = (img.at<Vec3f>(r, c + 1)[1] - img.at<Vec3f>(r, c - 1)[1]);
+			Y2[k] = (img.at<Vec3f>(r - 1, c)[1] - img.at<Vec3f>(r + 1, c)[1]);
+			X3[k] = (img.at<Vec3f>(r, c + 1)[2] - img.at<Vec3f>(r, c - 1)[2]);
+			Y3[k] = (img.at<Vec3f>(r - 1, c)[2] - img.at<Vec3f>(r + 1, c)[2]);
 		}
 
-		// finalize histogram, since the orientation histograms are circular
-		//d = 4
-		//n = 8
-		for (i = 0; i < d; i++)
-			for (j = 0; j < d; j++)
-			{
-				int idx = ((i + 1)*(d + 2) + (j + 1))*(n + 2);
-				hist1[idx] += hist1[idx + n];
-				hist1[idx + 1] += hist1[idx + n + 1];
-				hist2[idx] += hist2[idx + n];
-				hist2[idx + 1] += hist2[idx + n + 1];
-				hist3[idx] += hist3[idx + n];
-				hist3[idx + 1] += hist3[idx + n + 1];
-				for (k = 0; k < n; k++) {
-					dst[(i*d + j)*n + k] = hist1[idx + k];
-					dst[(i*d + j)*n + k + d * d * n] = hist2[idx + k];
-					dst[(i*d + j)*n + k + d * d * n * 2] = hist3[idx + k];
-
-			//pooledHist[(i*d + j)*n + k] = hist1[idx + k] + hist2[idx + k] + hist3[idx + k];
-				}
-			}
+		GradientBins::compute(X1, Y1, len, ori, n, Obin1, Mag1);
+		GradientBins::compute(X2, Y2, len, ori, n, Obin2, Mag2);
+		GradientBins::compute(X3, Y3, len, ori, n, Obin3, Mag3);
+
+		// tri-linear voting of the three channels, folded into dst channel after channel
+		const float* Obin[3] = { Obin1, Obin2, Obin3 };
+		const float* Mag[3] = { Mag1, Mag2, Mag3 };
+		OrientationHistogram::accumulate(RBin, CBin, W, Obin, Mag, len, d, n, 3, dst);
+
 		// copy histogram to the descriptor,
 		// apply hysteresis thresholding
 		// and scale the result, so that it can be easily converted
@@ -328,42 +213,9 @@ namespace cv
 	} */
 
 	void RGBSIFT::normalizeHistogram(float *dst, int d, int n) const {
-
-		float nrm1sqr = 0, nrm2sqr = 0, nrm3sqr = 0;
-		int len = d*d*n; //128
-		for (int k = 0; k < len; k++) {
-			nrm1sqr += dst[k] * dst[k];
-			nrm2sqr += dst[k + len] * dst[k + len];
-			nrm3sqr += dst[k + 2 * len] * dst[k + 2 * len];
-		}
-		float thr1 = std::sqrt(nrm1sqr)*SIFT_DESCR_MAG_THR;
-		float thr2 = std::sqrt(nrm2sqr)*SIFT_DESCR_MAG_THR;
-		float thr3 = std::sqrt(nrm3sqr)*SIFT_DESCR_MAG_THR;
-		nrm1sqr = nrm2sqr = nrm3sqr = 0;
-		for (int k = 0; k < len; k++)
-		{
-			float val = std::min(dst[k], thr1);
-			dst[k] = val;
-			nrm1sqr += val*val;
-			val = std::min(dst[k + len], thr2);
-			dst[k + len] = val;
-			nrm2sqr += val*val;
-			val = std::min(dst[k + 2 * len], thr3);
-			dst[k + 2 * len] = val;
-			nrm3sqr += val*val;
-		}
-
-		// Factor of three added below to make vector lengths comparable with SIFT
-		nrm1sqr = SIFT_INT_DESCR_FCTR / std::max(std::sqrt(3 * nrm1sqr), FLT_EPSILON);
-		nrm2sqr = SIFT_INT_DESCR_FCTR / std::max(std::sqrt(3 * nrm2sqr), FLT_EPSILON);
-		nrm3sqr = SIFT_INT_DESCR_FCTR / std::max(std::sqrt(3 * nrm3sqr), FLT_EPSILON);
-		for (int k = 0; k < len; k++)
-		{
-			dst[k] = (dst[k] * nrm1sqr);
-			dst[k + len] = (dst[k + len] * nrm2sqr);
-			dst[k + 2 * len] = (dst[k + 2 * len] * nrm3sqr);
-		}
-
+		// each channel is normalised on its own; the factor of three makes the
+		// stacked vector length comparable with SIFT
+		DescriptorNormalizer::normalize(dst, 3 * d*d*n, DescriptorNormalizer::PER_BLOCK, 3, 3.f);
 	}
 
 
@@ -378,6 +230,11 @@ namespace cv
 		return 3 * SIFT_DESCR_WIDTH * SIFT_DESCR_WIDTH * SIFT_DESCR_HIST_BINS;
 	}
 
+	int RGBSIFT::descriptorChannels() const
+	{
+		return 3;
+	}
+
 	void RGBSIFT::operator()(InputArray _image, InputArray _mask,
 		vector<KeyPoint>& keypoints,
 		OutputArray _descriptors,
@@ -413,18 +270,14 @@ namespace cv
 		}
 		// base is a grey image
 		Mat base = createInitialImage(image, firstOctave < 0, (float)sigma);
-		//initialize color image
-		Mat colorBase = createInitialColorImage(image, firstOctave < 0, (float)sigma);
 
-		vector<Mat> gpyr, dogpyr, colorGpyr; // colorGpyr is a gaussian pyramid for color image
+		vector<Mat> gpyr, dogpyr;
 		int nOctaves = actualNOctaves > 0 ? actualNOctaves : cvRound(log((double)std::min(base.cols, base.rows)) / log(2.) - 2) - firstOctave;
 
 		double t, tf = getTickFrequency();
 		t = (double)getTickCount();
 		buildGaussianPyramid(base, gpyr, nOctaves);
 		buildDoGPyramid(gpyr, dogpyr);
-		// build color gaussian pyramid
-		buildGaussianPyramid(colorBase, colorGpyr, nOctaves);
 		t = (double)getTickCount() - t;
 		printf("pyramid construction time: %g\n", t*1000./tf);
 
@@ -461,9 +314,12 @@ namespace cv
 		if (_descriptors.needed())
 		{
 			t = (double)getTickCount();
-			int dsize = descriptorSize();
+			int dsize = outputSize();
 			_descriptors.create((int)keypoints.size(), dsize, CV_32F);
 			Mat descriptors = _descriptors.getMat();
+			// color gaussian pyramid, shared with the other colour descriptors of this image
+			vector<Mat> colorGpyr;
+			buildDescriptorPyramid(image, keypoints, firstOctave, nOctaves, colorGpyr);
 			calcDescriptors(colorGpyr, keypoints, descriptors, nOctaveLayers, firstOctave);
 			t = (double)getTickCount() - t;
 			printf("descriptor extraction time: %g\n", t*1000./tf);
@@ -3,6 +3,7 @@
 #define __OPENCV_RGB_SIFT_H__
 
 #include "VanillaSIFT.h"
+#include "ColorPyramid.h"
 using namespace std;
 using namespace cv;
 #ifdef __cplusplus
@@ -31,8 +32,14 @@ namespace cv
 
 	protected:
 		virtual Mat createInitialColorImage(const Mat& img, bool doubleImageSize, float sigma) const;
+		// returns the shared RGB gaussian pyramid of img, building it on first use
+		Ptr<vector<Mat> > getColorPyramid(const Mat& img, int firstOctave, int nOctaves) const;
+		// descriptors are computed from the shared RGB pyramid
+		virtual void buildDescriptorPyramid(const Mat& image, const std::vector<KeyPoint>& keypoints, int firstOctave, int nOctaves, std::vector<Mat>& pyr) const;
 		virtual void calcSIFTDescriptor(const Mat& img, Point2f ptf, float ori, float scl, int d, int n, float* dst) const;
 		virtual void normalizeHistogram(float *dst, int d, int n) const;
+		// one block per colour channel
+		virtual int descriptorChannels() const;
 	};
 
 } /* namespace cv */
@@ -165,7 +165,7 @@ namespace cv
 		if (_descriptors.needed())
 		{
 			//t = (double)getTickCount();
-			int dsize = descriptorSize();
+			int dsize = outputSize();
 			_descriptors.create((int)keypoints.size(), dsize, CV_32F);
 			Mat descriptors = _descriptors.getMat();
 
@@ -190,45 +190,20 @@ namespace cv
 		if (bgrImage.type() != CV_32FC3)
 			CV_Error(CV_StsBadArg, "input image must be an BGR image of type CV_32FC3");
 
-		for (int y = 0; y < bgrImage.rows; ++y) {
-			for (int x = 0; x < bgrImage.cols; ++x) {
-				Vec3f v = bgrImage.at<Vec3f>(y, x);
-				float b = v[0];
-				float g = v[1];
-				float r = v[2];
-
-				bgrImage.at<Vec3f>(y, x)[0] = (r / (r + g + b));
-				bgrImage.at<Vec3f>(y, x)[1] = (g / (r + g + b));
-				bgrImage.at<Vec3f>(y, x)[2] = (0);
-			}
-		}
+		ColorTransform::normalizedRG(bgrImage, bgrImage);
 	}
 
 
-	void RGSIFT::normalizeHistogram(float *dst, int d, int n) const {
-		float nrm1sqr = 0, nrm2sqr = 0, nrm3sqr = 0;
-		int len = d*d*n;
-		for (int k = 0; k < len; k++) {
-			nrm1sqr += dst[k] * dst[k];
-			nrm2sqr += dst[k + len] * dst[k + len];
-			nrm3sqr += dst[k + 2 * len] * dst[k + 2 * len];
-		}
-		float nrm2 = max(nrm1sqr, max(nrm2sqr, nrm3sqr));
-		float thr = std::sqrt(nrm2)*SIFT_DESCR_MAG_THR;
+	void RGSIFT::buildDescriptorPyramid(const Mat& image, const std::vector<KeyPoint>& keypoints, int firstOctave, int nOctaves, std::vector<Mat>& pyr) const
+	{
+		Mat colorBase = createInitialColorImage(image, firstOctave < 0, (float)sigma);
+		convertBGRImage(colorBase);
+		buildGaussianPyramid(colorBase, pyr, nOctaves);
+	}
 
-		nrm2 = 0;
-		for (int i = 0; i < 3 * len; i++)
-		{
-			float val = std::min(dst[i], thr);
-			dst[i] = val;
-			nrm2 += val * val;
-		}
-		nrm2 = SIFT_INT_DESCR_FCTR / std::max(std::sqrt(nrm2), FLT_EPSILON);
 
-		for (int k = 0; k < 3 * len; k++)
-		{
-			dst[k] = dst[k] * nrm2;
-		}
+	void RGSIFT::normalizeHistogram(float *dst, int d, int n) const {
+		DescriptorNormalizer::normalize(dst, 3 * d*d*n, DescriptorNormalizer::MAX_BLOCK_THRESHOLD, 3);
 	}
 
 }
@@ -29,6 +29,8 @@ namespace cv
 			OutputArray _descriptors,
 			bool useProvidedKeypoints) const;
 		void convertBGRImage(Mat& bgrImage) const;
+		// normalised rg is not linear, so it keeps a pyramid of its own
+		virtual void buildDescriptorPyramid(const Mat& image, const std::vector<KeyPoint>& keypoints, int firstOctave, int nOctaves, std::vector<Mat>& pyr) const;
 		void normalizeHistogram(float *dst, int d, int n) const;
 	};
 
@@ -41,36 +41,26 @@ void SPIN::calcSIFTDescriptor(const Mat& img, Point2f ptf, float ori, float scl,
 	// Clip the radius to the diagonal of the image to avoid autobuffer too large exception
 	radius = std::min(radius, (int)sqrt((double)img.cols*img.cols + img.rows*img.rows));
 
-	// this is the number of intensity bins per unit
-	float bins_per_intensity = (float)intensity_bins / 255.f;
+	int i, k;
 
-	// this is the number of distance bins per pixel
-	float bins_per_distance = (float)distance_bins / circ_radius;
+	// distance bins and distance terms of the window, shared by all keypoints of this size
+	Ptr<SpinWindow> window = SpinKernel::getWindow(radius, circ_radius, distance_bins);
 
-	// the "soft widths" of the histograms
-	float alpha = (float)circ_radius / (float)distance_bins;
-	float beta = 255.f / (float)intensity_bins;
+	int len = (int)window->rowOffset.size();
 
-	int i;
-	int j;
-	int k;
-
-	int len = (radius * 2 + 1)*(radius * 2 + 1);
-
-	int histlen = intensity_bins*distance_bins;
 	int rows = img.rows, cols = img.cols;
 
-	AutoBuffer<float> buf(len * 2 + distance_bins);
-
-	// the distance histogram
-	float *dist = buf;
+	AutoBuffer<float> buf(len + distance_bins);
+	AutoBuffer<int> pos(len * 3);
 
 	// the intensity histogram
-	float *intensity = dist + len;
+	float *intensity = buf;
 
 	// array for tracking the sum of weights in each bin
 	float *sums = intensity + len;
 
+	int *R = pos, *C = R + len, *index = C + len;
+
 	for (int i = 0; i < distance_bins; i++) {
 		sums[i] = 0;
 	}
@@ -81,29 +71,16 @@ void SPIN::calcSIFTDescriptor(const Mat& img, Point2f ptf, float ori, float scl,
 
 	float ibar = 0, ibar2 = 0;
 
-	for (i = -radius, k = 0; i <= radius; i++) {
-		for (j = -radius; j <= radius; j++) {
-
-			int r = pt.y + i, c = pt.x + j;
+	len = SpinKernel::collectSamples(*window, pt, rows, cols, R, C, index);
 
-			float distance = (float)sqrt(i*i + j*j);
-
-			if (r > -1 && c > -1 && r < rows - 1 && c < cols - 1 && distance <= radius) {
-				dist[k] = distance;
-
-				// setting the intensity value of each pixel 
-				intensity[k] = img.at<VanillaSIFT::sift_wt>(r, c);
-
-				ibar += intensity[k];
-				ibar2 += intensity[k] * intensity[k];
+	for (k = 0; k < len; k++) {
+		// setting the intensity value of each pixel 
+		intensity[k] = img.at<VanillaSIFT::sift_wt>(R[k], C[k]);
 
-				k++;
-			}
-		}
+		ibar += intensity[k];
+		ibar2 += intensity[k] * intensity[k];
 	}
 
-	len = k;
-
 	ibar = ibar / (float)len;
 	ibar2 = ibar2 / (float)len;
 
@@ -115,86 +92,12 @@ void SPIN::calcSIFTDescriptor(const Mat& img, Point2f ptf, float ori, float scl,
 	for (k = 0; k < len; k++) {
 		// Normalize intensity
 		intensity[k] = (intensity[k] - ibar)*gain + ibar + bias;
-
-		int distance_bin = (int)(dist[k] * bins_per_distance);
-		// this handles edge case when distance_bin is at the radius length
-		distance_bin = min(distance_bins - 1, distance_bin);
-
-		int intensity_bin = (int)(intensity[k] * bins_per_intensity);
-		// this handles edge case when intensity_bin is at the radius length
-		intensity_bin = min(intensity_bins - 1, intensity_bin);
-
-		int imin = max(0, distance_bin - 1);
-		// subtracting 1 because distance_bins is bin index and we need bin location
-		int imax = min(distance_bins - 1, distance_bin + 1);
-
-		int jmin = max(0, intensity_bin - 1);
-		// subtracting 1 because intensity_bins is bin index and we need bin location
-		int jmax = min(intensity_bins - 1, intensity_bin + 1);
-
-
-		for (i = imin; i <= imax; i++) {
-			for (j = jmin; j <= jmax; j++) {
-
-				// index in destination (dst) histogram
-				int index = i * intensity_bins + j;
-
-				// calculate the denominators
-				float distanceDenominator = 2 * alpha * alpha;
-				float intensityDenominator = 2 * beta * beta;
-
-				// calculate distance from keypoint
-				float i_dist = (i + 0.5f) * alpha;
-				float j_dist = (j + 0.5f) * beta;
-
-				// calculate numerators
-				float distanceNumerator = pow(dist[k] - i_dist, 2);
-				float intensityNumerator = pow(intensity[k] - j_dist, 2);
-
-				float distanceCalculation = distanceNumerator / distanceDenominator;
-				float intensityCalculation = intensityNumerator / intensityDenominator;
-
-				// calculate the exponential
-				float expo = exp(-distanceCalculation - intensityCalculation);
-
-				// add final calculation to sums array for normalization of weights
-				sums[i] += expo;
-
-				// add final calculation to the destination array
-				dst[index] += expo;
-
-			}
-		}
 	}
 
-	for (int i = 0; i < distance_bins; i++) {
-		for (int j = 0; j < intensity_bins; j++) {
-			dst[i * intensity_bins + j] /= std::max(sums[i], FLT_EPSILON);
-		}
-	}
-
-
-	// copy histogram to the descriptor,
-	// apply hysteresis thresholding
-	// and scale the result, so that it can be easily converted
-	// to byte array
-	float nrm2 = 0;
-	len = distance_bins * intensity_bins;
-	for (k = 0; k < len; k++)
-		nrm2 += dst[k] * dst[k];
-	float thr = std::sqrt(nrm2)*VanillaSIFT::SIFT_DESCR_MAG_THR;
-	for (i = 0, nrm2 = 0; i < k; i++)
-	{
-		float val = std::min(dst[i], thr);
-		dst[i] = val;
-		nrm2 += val*val;
-	}
-	nrm2 = VanillaSIFT::SIFT_INT_DESCR_FCTR / std::max(std::sqrt(nrm2), FLT_EPSILON);
+	SpinKernel::vote(*window, index, intensity, len, distance_bins, intensity_bins, dst, sums);
+	SpinKernel::normalizeRows(dst, sums, distance_bins, intensity_bins);
 
-	for (k = 0; k < len; k++)
-	{
-		dst[k] = dst[k] * nrm2;
-	}
+	DescriptorNormalizer::normalize(dst, distance_bins * intensity_bins);
 }
 
 //------------------------------------calcDescriptors()--------------------------------
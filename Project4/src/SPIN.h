@@ -3,6 +3,7 @@
 #define SPIN_H
 
 #include "VanillaSIFT.h"
+#include "SpinKernel.h"
 #include <cmath>
 
 using namespace std;
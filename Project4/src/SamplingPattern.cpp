@@ -0,0 +1,321 @@
+#include "SamplingPattern.h"
+
+bool SamplingPatternCache::enabled = false;
+int SamplingPatternCache::sampleLimit = 0;
+size_t SamplingPatternCache::cachedSamples = 0;
+std::mutex SamplingPatternCache::cacheLock;
+map<long long, Ptr<SamplingPattern> > SamplingPatternCache::patterns;
+thread_local bool SamplingPatternCache::shareWindow = false;
+thread_local SharedWindow SamplingPatternCache::lastWindow;
+
+//------------------------------------setEnabled()-------------------------------------
+// turn the pattern cache on or off for every descriptor in the process
+//Precondition: None
+//Postcondition: collectSamples() uses cached patterns if enabled is true, otherwise
+//				 it computes the exact window for every keypoint
+//-------------------------------------------------------------------------------------
+void SamplingPatternCache::setEnabled(bool _enabled)
+{
+	enabled = _enabled;
+}
+
+//------------------------------------isEnabled()--------------------------------------
+// returns whether cached patterns are used
+//Precondition: None
+//Postcondition: the cache state is returned
+//-------------------------------------------------------------------------------------
+bool SamplingPatternCache::isEnabled()
+{
+	return enabled;
+}
+
+//------------------------------------setSampleLimit()---------------------------------
+// cap the number of samples of a descriptor window for every descriptor in the process
+//Precondition: maxSamples >= 0
+//Postcondition: windows of more than maxSamples pixels are listed on a grid of
+//				 stride s, the smallest that keeps them within maxSamples, and each
+//				 sample stands for the s*s pixels around it; 0 lists every pixel
+//-------------------------------------------------------------------------------------
+void SamplingPatternCache::setSampleLimit(int maxSamples)
+{
+	CV_Assert(maxSamples >= 0);
+	sampleLimit = maxSamples;
+}
+
+//------------------------------------getSampleLimit()---------------------------------
+// returns the sample limit of a descriptor window
+//Precondition: None
+//Postcondition: the limit is returned, 0 if windows are not capped
+//-------------------------------------------------------------------------------------
+int SamplingPatternCache::getSampleLimit()
+{
+	return sampleLimit;
+}
+
+//------------------------------------clear()------------------------------------------
+// release all cached patterns
+//Precondition: None
+//Postcondition: the cache is empty
+//-------------------------------------------------------------------------------------
+void SamplingPatternCache::clear()
+{
+	std::lock_guard<std::mutex> lock(cacheLock);
+	patterns.clear();
+	cachedSamples = 0;
+}
+
+//------------------------------------setWindowSharing()-------------------------------
+// turn reuse of the last listed window on or off for the calling thread, used when
+// several descriptors of the same keypoint are computed one after another
+//Precondition: None
+//Postcondition: while sharing is on, a call to collectSamples() with the same
+//				 arguments as the previous call copies the previous result
+//-------------------------------------------------------------------------------------
+void SamplingPatternCache::setWindowSharing(bool share)
+{
+	shareWindow = share;
+	lastWindow.valid = false;
+}
+
+//------------------------------------collectSamples()---------------------------------
+// list the samples of the rotated descriptor window around a keypoint
+//Precondition: the following parameters must be correclty defined.
+//parameters:
+	//pt: keypoint location in the pyramid level
+	//ori: angle(degree) of the keypoint relative to the coordinates, clockwise
+	//hist_width: width of one spatial bin in pixels
+	//radius: window radius, possibly clipped to the image diagonal
+	//d: descr_width, 4 in this case
+	//rows, cols: size of the pyramid level
+	//R, C: buffers of (2*radius+1)^2 ints receiving the sample pixel coordinates
+	//RBin, CBin: buffers of (2*radius+1)^2 floats receiving the rotated bin coordinates
+	//W: buffer of (2*radius+1)^2 floats receiving the Gaussian weights, may be NULL
+//Postcondition: the number of samples is returned; samples are listed in raster
+//				 order and exclude the one pixel image border. With a sample limit
+//				 set, large windows are listed with a stride and W is scaled by the
+//				 pixels each sample stands for
+//-------------------------------------------------------------------------------------
+int SamplingPatternCache::collectSamples(Point pt, float ori, float hist_width, int radius, int d, int rows, int cols,
+	int* R, int* C, float* RBin, float* CBin, float* W)
+{
+	if (!shareWindow)
+		return listSamples(pt, ori, hist_width, radius, d, rows, cols, R, C, RBin, CBin, W);
+
+	SharedWindow& last = lastWindow;
+	int len;
+
+	if (last.valid && last.pt == pt && last.ori == ori && last.hist_width == hist_width &&
+		last.radius == radius && last.d == d && last.rows == rows && last.cols == cols &&
+		(W == NULL || last.hasWeights))
+	{
+		len = (int)last.R.size();
+		std::copy(last.R.begin(), last.R.end(), R);
+		std::copy(last.C.begin(), last.C.end(), C);
+		std::copy(last.RBin.begin(), last.RBin.end(), RBin);
+		std::copy(last.CBin.begin(), last.CBin.end(), CBin);
+		if (W)
+			std::copy(last.W.begin(), last.W.end(), W);
+		return len;
+	}
+
+	len = listSamples(pt, ori, hist_width, radius, d, rows, cols, R, C, RBin, CBin, W);
+
+	last.valid = true;
+	last.hasWeights = (W != NULL);
+	last.pt = pt; last.ori = ori; last.hist_width = hist_width;
+	last.radius = radius; last.d = d; last.rows = rows; last.cols = cols;
+	last.R.assign(R, R + len);
+	last.C.assign(C, C + len);
+	last.RBin.assign(RBin, RBin + len);
+	last.CBin.assign(CBin, CBin + len);
+	if (W)
+		last.W.assign(W, W + len);
+
+	return len;
+}
+
+//------------------------------------listSamples()------------------------------------
+// list the samples of the window, see collectSamples()
+//-------------------------------------------------------------------------------------
+int SamplingPatternCache::listSamples(Point pt, float ori, float hist_width, int radius, int d, int rows, int cols,
+	int* R, int* C, float* RBin, float* CBin, float* W)
+{
+	int i, j, k;
+	int stride = sampleStride(radius);
+
+	// a clipped window no longer matches the radius it was keyed by, so only
+	// unclipped windows are served from the cache
+	int fullRadius = cvRound(hist_width * 1.4142135623730951f * (d + 1) * 0.5f);
+
+	if (enabled && radius > 0 && radius == fullRadius)
+	{
+		int oriStep = cvRound(ori * (ORIENTATION_STEPS / 360.f));
+		if (oriStep >= ORIENTATION_STEPS)
+			oriStep -= ORIENTATION_STEPS;
+		if (oriStep < 0)
+			oriStep += ORIENTATION_STEPS;
+
+		Ptr<SamplingPattern> pattern = getPattern(d, radius, oriStep, stride);
+		const int *rowOffset = &pattern->rowOffset[0], *colOffset = &pattern->colOffset[0];
+		const float *rowBin = &pattern->rowBin[0], *colBin = &pattern->colBin[0], *weight = &pattern->weight[0];
+		int total = (int)pattern->rowOffset.size();
+
+		for (i = 0, k = 0; i < total; i++)
+		{
+			int r = pt.y + rowOffset[i], c = pt.x + colOffset[i];
+
+			if (r > 0 && r < rows - 1 && c > 0 && c < cols - 1)
+			{
+				R[k] = r; C[k] = c;
+				RBin[k] = rowBin[i]; CBin[k] = colBin[i];
+				if (W)
+					W[k] = weight[i];
+				k++;
+			}
+		}
+		return k;
+	}
+
+	float cos_t = cosf(ori*(float)(CV_PI / 180));
+	float sin_t = sinf(ori*(float)(CV_PI / 180));
+	float exp_scale = -1.f / (d * d * 0.5f);
+	cos_t /= hist_width;
+	sin_t /= hist_width;
+
+	// the grid keeps the keypoint pixel whatever the stride
+	int first = -(radius / stride)*stride;
+
+	for (i = first, k = 0; i <= radius; i += stride)
+		for (j = first; j <= radius; j += stride)
+		{
+			// Calculate sample's histogram array coords rotated relative to ori.
+			// Subtract 0.5 so samples that fall e.g. in the center of row 1 (i.e.
+			// r_rot = 1.5) have full weight placed in row 1 after interpolation.
+			float c_rot = j * cos_t - i * sin_t;
+			float r_rot = j * sin_t + i * cos_t;
+			float rbin = r_rot + d / 2 - 0.5f;
+			float cbin = c_rot + d / 2 - 0.5f;
+			int r = pt.y + i, c = pt.x + j;
+
+			if (rbin > -1 && rbin < d && cbin > -1 && cbin < d &&
+				r > 0 && r < rows - 1 && c > 0 && c < cols - 1)
+			{
+				R[k] = r; C[k] = c;
+				RBin[k] = rbin; CBin[k] = cbin;
+				if (W)
+					W[k] = (c_rot * c_rot + r_rot * r_rot)*exp_scale;
+				k++;
+			}
+		}
+
+	if (W)
+	{
+		hal::exp(W, W, k);
+
+		// each sample of a strided grid stands for stride*stride pixels
+		if (stride > 1)
+		{
+			float area = (float)(stride*stride);
+			for (i = 0; i < k; i++)
+				W[i] *= area;
+		}
+	}
+
+	return k;
+}
+
+//------------------------------------sampleStride()-----------------------------------
+// the grid stride of a window under the sample limit
+//Precondition: radius >= 0
+//Postcondition: the smallest stride keeping the window within the limit is
+//				 returned, 1 if there is no limit
+//-------------------------------------------------------------------------------------
+int SamplingPatternCache::sampleStride(int radius)
+{
+	int side = radius * 2 + 1, stride = 1;
+
+	if (sampleLimit > 0)
+		while ((double)((side + stride - 1) / stride)*((side + stride - 1) / stride) > sampleLimit)
+			stride++;
+
+	return stride;
+}
+
+//------------------------------------getPattern()-------------------------------------
+// find or build the pattern for a quantised window radius and orientation
+//Precondition: radius > 0, 0 <= oriStep < ORIENTATION_STEPS, stride >= 1
+//Postcondition: the shared pattern is returned
+//-------------------------------------------------------------------------------------
+Ptr<SamplingPattern> SamplingPatternCache::getPattern(int d, int radius, int oriStep, int stride)
+{
+	long long key = ((long long)d << 48) | ((long long)stride << 40) | ((long long)radius << 16) | (long long)oriStep;
+
+	std::lock_guard<std::mutex> lock(cacheLock);
+
+	map<long long, Ptr<SamplingPattern> >::iterator it = patterns.find(key);
+	if (it != patterns.end())
+		return it->second;
+
+	// the bin width that the integer radius stands for
+	float hist_width = radius / (1.4142135623730951f * (d + 1) * 0.5f);
+	float ori = oriStep * (360.f / ORIENTATION_STEPS);
+	float cos_t = cosf(ori*(float)(CV_PI / 180)) / hist_width;
+	float sin_t = sinf(ori*(float)(CV_PI / 180)) / hist_width;
+
+	Ptr<SamplingPattern> pattern = makePtr<SamplingPattern>();
+	buildPattern(*pattern, d, radius, stride, cos_t, sin_t);
+
+	// patterns already handed out stay alive through their Ptr
+	if (cachedSamples + pattern->weight.size() > MAX_CACHED_SAMPLES)
+	{
+		patterns.clear();
+		cachedSamples = 0;
+	}
+	patterns[key] = pattern;
+	cachedSamples += pattern->weight.size();
+
+	return pattern;
+}
+
+//------------------------------------buildPattern()-----------------------------------
+// compute the rotated bin coordinates and Gaussian weights of a whole window
+//Precondition: cos_t and sin_t are already divided by the bin width
+//Postcondition: the pattern is filled with the samples of a grid of the given stride
+//-------------------------------------------------------------------------------------
+void SamplingPatternCache::buildPattern(SamplingPattern& pattern, int d, int radius, int stride, float cos_t, float sin_t)
+{
+	float exp_scale = -1.f / (d * d * 0.5f);
+	int first = -(radius / stride)*stride;
+	size_t side = (radius - first) / stride + 1, len = side*side;
+
+	pattern.rowOffset.reserve(len);
+	pattern.colOffset.reserve(len);
+	pattern.rowBin.reserve(len);
+	pattern.colBin.reserve(len);
+	pattern.weight.reserve(len);
+
+	for (int i = first; i <= radius; i += stride)
+		for (int j = first; j <= radius; j += stride)
+		{
+			float c_rot = j * cos_t - i * sin_t;
+			float r_rot = j * sin_t + i * cos_t;
+			float rbin = r_rot + d / 2 - 0.5f;
+			float cbin = c_rot + d / 2 - 0.5f;
+
+			if (rbin > -1 && rbin < d && cbin > -1 && cbin < d)
+			{
+				pattern.rowOffset.push_back(i);
+				pattern.colOffset.push_back(j);
+				pattern.rowBin.push_back(rbin);
+				pattern.colBin.push_back(cbin);
+				pattern.weight.push_back((c_rot * c_rot + r_rot * r_rot)*exp_scale);
+			}
+		}
+
+	if (!pattern.weight.empty())
+		hal::exp(&pattern.weight[0], &pattern.weight[0], (int)pattern.weight.size());
+
+	if (stride > 1)
+		for (size_t k = 0; k < pattern.weight.size(); k++)
+			pattern.weight[k] *= (float)(stride*stride);
+}
@@ -0,0 +1,178 @@
+//-------------------------------------------------------------------------
+// Name: SamplingPattern.h
+// Description: Cache of rotated descriptor sampling windows shared by the
+//  SIFT-family descriptors. A sampling pattern holds, for every pixel offset
+//  of the (2r+1)^2 window that lands inside the d x d spatial grid, its
+//  rotated row/column bin coordinates and its Gaussian window weight.
+//  Patterns are keyed by the integer window radius (the quantised scale)
+//  and a quantised keypoint orientation, so descriptors of keypoints with
+//  similar geometry reuse the same tables instead of recomputing the
+//  rotation and calling exp() for every sample. With a sample limit set,
+//  the windows of large keypoints are sampled on a coarser grid so that
+//  every descriptor reads about the same number of pixels.
+// Methods:
+//			setEnabled()
+//			isEnabled()
+//			setSampleLimit()
+//			getSampleLimit()
+//			clear()
+//			setWindowSharing()
+//			collectSamples()
+//-------------------------------------------------------------------------
+
+#ifndef SAMPLING_PATTERN_H
+#define SAMPLING_PATTERN_H
+
+#include "opencv2/opencv.hpp"
+#include <map>
+#include <mutex>
+#include <vector>
+
+using namespace std;
+using namespace cv;
+
+#ifdef __cplusplus
+
+/*!
+	One precomputed rotated sampling window
+*/
+struct SamplingPattern
+{
+	vector<int> rowOffset;		// sample row offset relative to the keypoint
+	vector<int> colOffset;		// sample column offset relative to the keypoint
+	vector<float> rowBin;		// rotated row coordinate in histogram bins
+	vector<float> colBin;		// rotated column coordinate in histogram bins
+	vector<float> weight;		// Gaussian window weight, exp() already applied
+};
+
+/*!
+	The last window listed by collectSamples(), with the arguments it was listed for
+*/
+struct SharedWindow
+{
+	bool valid;					// false until a window has been listed
+	bool hasWeights;			// W was requested and is stored
+	Point pt;
+	float ori, hist_width;
+	int radius, d, rows, cols;
+	vector<int> R, C;
+	vector<float> RBin, CBin, W;
+
+	SharedWindow() : valid(false), hasWeights(false) {}
+};
+
+class SamplingPatternCache
+{
+public:
+	static const int ORIENTATION_STEPS = 360;		// orientation quantisation, 1 degree
+	static const size_t MAX_CACHED_SAMPLES = 1 << 22;	// total samples kept before the cache is flushed
+
+//------------------------------------setEnabled()-------------------------------------
+// turn the pattern cache on or off for every descriptor in the process
+//Precondition: None
+//Postcondition: collectSamples() uses cached patterns if enabled is true, otherwise
+//				 it computes the exact window for every keypoint
+//-------------------------------------------------------------------------------------
+	static void setEnabled(bool enabled);
+
+//------------------------------------isEnabled()--------------------------------------
+// returns whether cached patterns are used
+//Precondition: None
+//Postcondition: the cache state is returned
+//-------------------------------------------------------------------------------------
+	static bool isEnabled();
+
+//------------------------------------setSampleLimit()---------------------------------
+// cap the number of samples of a descriptor window for every descriptor in the process
+//Precondition: maxSamples >= 0
+//Postcondition: windows of more than maxSamples pixels are listed on a grid of
+//				 stride s, the smallest that keeps them within maxSamples, and each
+//				 sample stands for the s*s pixels around it; 0 lists every pixel
+//-------------------------------------------------------------------------------------
+	static void setSampleLimit(int maxSamples);
+
+//------------------------------------getSampleLimit()---------------------------------
+// returns the sample limit of a descriptor window
+//Precondition: None
+//Postcondition: the limit is returned, 0 if windows are not capped
+//-------------------------------------------------------------------------------------
+	static int getSampleLimit();
+
+//------------------------------------clear()------------------------------------------
+// release all cached patterns
+//Precondition: None
+//Postcondition: the cache is empty
+//-------------------------------------------------------------------------------------
+	static void clear();
+
+//------------------------------------setWindowSharing()-------------------------------
+// turn reuse of the last listed window on or off for the calling thread, used when
+// several descriptors of the same keypoint are computed one after another
+//Precondition: None
+//Postcondition: while sharing is on, a call to collectSamples() with the same
+//				 arguments as the previous call copies the previous result
+//-------------------------------------------------------------------------------------
+	static void setWindowSharing(bool share);
+
+//------------------------------------collectSamples()---------------------------------
+// list the samples of the rotated descriptor window around a keypoint
+//Precondition: the following parameters must be correclty defined.
+//parameters:
+	//pt: keypoint location in the pyramid level
+	//ori: angle(degree) of the keypoint relative to the coordinates, clockwise
+	//hist_width: width of one spatial bin in pixels
+	//radius: window radius, possibly clipped to the image diagonal
+	//d: descr_width, 4 in this case
+	//rows, cols: size of the pyramid level
+	//R, C: buffers of (2*radius+1)^2 ints receiving the sample pixel coordinates
+	//RBin, CBin: buffers of (2*radius+1)^2 floats receiving the rotated bin coordinates
+	//W: buffer of (2*radius+1)^2 floats receiving the Gaussian weights, may be NULL
+//Postcondition: the number of samples is returned; samples are listed in raster
+//				 order and exclude the one pixel image border. With a sample limit
+//				 set, large windows are listed with a stride and W is scaled by the
+//				 pixels each sample stands for
+//-------------------------------------------------------------------------------------
+	static int collectSamples(Point pt, float ori, float hist_width, int radius, int d, int rows, int cols,
+		int* R, int* C, float* RBin, float* CBin, float* W);
+
+private:
+	static bool enabled;
+	static int sampleLimit;
+	static size_t cachedSamples;
+	static std::mutex cacheLock;
+	static map<long long, Ptr<SamplingPattern> > patterns;
+	static thread_local bool shareWindow;
+	static thread_local SharedWindow lastWindow;
+
+//------------------------------------listSamples()------------------------------------
+// list the samples of the window, see collectSamples()
+//-------------------------------------------------------------------------------------
+	static int listSamples(Point pt, float ori, float hist_width, int radius, int d, int rows, int cols,
+		int* R, int* C, float* RBin, float* CBin, float* W);
+
+//------------------------------------sampleStride()-----------------------------------
+// the grid stride of a window under the sample limit
+//Precondition: radius >= 0
+//Postcondition: the smallest stride keeping the window within the limit is
+//				 returned, 1 if there is no limit
+//-------------------------------------------------------------------------------------
+	static int sampleStride(int radius);
+
+//------------------------------------getPattern()-------------------------------------
+// find or build the pattern for a quantised window radius and orientation
+//Precondition: radius > 0, 0 <= oriStep < ORIENTATION_STEPS, stride >= 1
+//Postcondition: the shared pattern is returned
+//-------------------------------------------------------------------------------------
+	static Ptr<SamplingPattern> getPattern(int d, int radius, int oriStep, int stride);
+
+//------------------------------------buildPattern()-----------------------------------
+// compute the rotated bin coordinates and Gaussian weights of a whole window
+//Precondition: cos_t and sin_t are already divided by the bin width
+//Postcondition: the pattern is filled with the samples of a grid of the given stride
+//-------------------------------------------------------------------------------------
+	static void buildPattern(SamplingPattern& pattern, int d, int radius, int stride, float cos_t, float sin_t);
+};
+
+#endif /* __cplusplus */
+
+#endif
@@ -1,6 +1,59 @@
 #include "ScriptData.h"
 #include "DescriptorUtil.h"
 #include <opencv2/opencv.hpp>
+#include <algorithm>
+
+
+/*!
+	Matches the first image of the active image set against a range of the others
+*/
+class MatchPairsBody : public ParallelLoopBody
+{
+public:
+	MatchPairsBody(DescriptorUtil* _descriptorUtil, const NNQuery& _query, Mat* _descriptors, vector<KeyPoint>* _kpts, Mat* _images,
+		const vector<GroundTruth>& _truths, const vector<string>& _outFilenames, bool _drawMatches, const Ptr<NNMatcher>& _matcher,
+		bool _ratioStrategy, bool _mutualStrategy, float _guidedRadius, const vector<float>& _fusionWeights, const vector<Mat>& _fusionQuery,
+		const vector<vector<Mat> >& _fusionTrain, vector<string>& _logs)
+		: descriptorUtil(_descriptorUtil), query(_query), descriptors(_descriptors), kpts(_kpts), images(_images), truths(_truths),
+		outFilenames(_outFilenames), drawMatches(_drawMatches), matcher(_matcher), ratioStrategy(_ratioStrategy), mutualStrategy(_mutualStrategy),
+		guidedRadius(_guidedRadius), fusionWeights(_fusionWeights), fusionQuery(_fusionQuery), fusionTrain(_fusionTrain), logs(_logs) {}
+
+	virtual void operator()(const Range& range) const
+	{
+		for (int j = range.start; j < range.end; j++)
+		{
+			// each pair reports to its own buffer, printed in pair order once all are done
+			stringstream log;
+			descriptorUtil->match(query, descriptors[j + 1], kpts[0], kpts[j + 1], images[0], images[j + 1], truths[j], outFilenames[j],
+				log, drawMatches, matcher, ratioStrategy, mutualStrategy, guidedRadius);
+
+			// the parts of a stacked descriptor can also be matched on their own
+			if (!fusionQuery.empty()) {
+				log << ">> Late fusion for " << outFilenames[j] << endl;
+				descriptorUtil->matchLateFusion(fusionQuery, fusionTrain[j], truths[j], outFilenames[j], log, fusionWeights);
+			}
+			logs[j] = log.str();
+		}
+	}
+
+private:
+	DescriptorUtil* descriptorUtil;
+	const NNQuery& query;
+	Mat* descriptors;
+	vector<KeyPoint>* kpts;
+	Mat* images;
+	const vector<GroundTruth>& truths;
+	const vector<string>& outFilenames;
+	bool drawMatches;
+	Ptr<NNMatcher> matcher;
+	bool ratioStrategy;
+	bool mutualStrategy;
+	float guidedRadius;
+	const vector<float>& fusionWeights;
+	const vector<Mat>& fusionQuery;			// parts of the first image, empty without late fusion
+	const vector<vector<Mat> >& fusionTrain;	// parts of the other image of every pair
+	vector<string>& logs;
+};
 
 
 ScriptData::ScriptData() {}
@@ -13,6 +66,19 @@ ScriptData::ScriptData(ConfigurationManager configs) {
 		isRunningFromConsole = configs.isRunningFromConsole;
 		saveData = configs.save;
 		drawMatches = configs.display;
+		benchmark = configs.benchmark;
+		fusedExtraction = configs.fusedExtraction;
+		pooledChannels = configs.pooledChannels;
+		matcher = NNMatcher::create(configs.matcher, configs.matcherParams);
+		ratioStrategy = configs.ratioStrategy;
+		mutualStrategy = configs.mutualStrategy;
+		fusionWeights = configs.fusionWeights;
+		guidedRadius = configs.guidedRadius;
+		if(configs.maxFeatures > 0) { maxFeatures = configs.maxFeatures; }
+		byteDescriptors = configs.byteDescriptors;
+		SamplingPatternCache::setEnabled(configs.cachedSampling);
+		GradientBins::setOctantBinning(configs.octantGradients);
+		SamplingPatternCache::setSampleLimit(configs.maxSamples);
 		dataset = DataSet(configs.dataset, configs.imageset, projectDirectory, configs.resetImageNames, isRunningFromConsole);
 		setNumberOfImages((int)configs.images.size());
 		setImageNames(configs.images);
@@ -52,6 +118,20 @@ ScriptData::ScriptData(const ScriptData& copy) {
 		this->numberOfDescriptors = copy.numberOfDescriptors;
 		this->homographyFlag = copy.homographyFlag;
 		this->saveData = copy.saveData;
+		this->benchmark = copy.benchmark;
+		this->descriptorTicks = copy.descriptorTicks;
+		this->descriptorKeypoints = copy.descriptorKeypoints;
+		this->fusedExtraction = copy.fusedExtraction;
+		this->pooledChannels = copy.pooledChannels;
+		this->matcher = copy.matcher;
+		this->ratioStrategy = copy.ratioStrategy;
+		this->mutualStrategy = copy.mutualStrategy;
+		this->fusionWeights = copy.fusionWeights;
+		this->guidedRadius = copy.guidedRadius;
+		this->maxFeatures = copy.maxFeatures;
+		this->byteDescriptors = copy.byteDescriptors;
+		this->stackedTicks = copy.stackedTicks;
+		this->stackedKeypoints = copy.stackedKeypoints;
 		this->featureExtractor = copy.featureExtractor;
 		this->featureExtractorText = copy.featureExtractorText;
 		this->descriptorTypes = copy.descriptorTypes;
@@ -73,8 +153,15 @@ ScriptData::~ScriptData()
 }
 
 void ScriptData::run() {
+	descriptorTicks.assign(descriptorTableSize, 0);
+	descriptorKeypoints.assign(descriptorTableSize, 0);
+	stackedTicks.assign(numberOfDescriptors, 0);
+	stackedKeypoints.assign(numberOfDescriptors, 0);
+
 	if(dataset.imageSetNames.size() > 1) { runAllImageSets(); } 
 	else { runActiveImageSet(); }
+
+	if(benchmark) { outputBenchmark(); }
 }
 
 //------------------------------------runSingleImageSet()--------------------------------------------
@@ -100,7 +187,10 @@ void ScriptData::runActiveImageSet()
 	initTable(descriptorTable);
 	initDescriptors(descriptors);
 	computeKeypoints(kpts, images, imageNames);
-	computeDescriptors(descriptors, descriptorTable, kpts, images, imageNames);
+	// the correct matches of an image pair are the same for every descriptor type
+	vector<GroundTruth> truths;
+	computeGroundTruth(kpts, images, truths);
+	computeDescriptors(descriptors, descriptorTable, kpts, images, imageNames, truths);
 	freeMemory(descriptorTable, descriptors, kpts, images, imageNames);
 }
 
@@ -158,7 +248,7 @@ void ScriptData::computeKeypoints(vector<KeyPoint> *kpts, Mat *images, string* i
 		// Load from file or detect new features
 		ScriptData temp(*this);
 		descriptorUtil->detectFeatures(images[i], kpts[i], temp);
-		KeyPointsFilter::retainBest(kpts[i], MAX_FEATURES);
+		KeyPointsFilter::retainBest(kpts[i], maxFeatures);
 	}
 
 	cout << ">> Finished computing all keypoints" << endl;
@@ -185,7 +275,39 @@ void ScriptData::writeKeypointsToFile(vector<KeyPoint> *kpts, string* imageNames
 		descriptorUtil->writeKeyPoints(kpts, imageNames, dataset.activeImageSet.count, keyPs.str());
 }
 
-void ScriptData::computeDescriptors(Mat **descriptors, Mat*** table, vector<KeyPoint> *kpts, Mat *images, string* imageNames) {
+//------------------------------------computeGroundTruth()-----------------------------
+//find the true correspondences between the first image and each other image
+//Precondition: the keypoints and images of the active image set are loaded
+//Postcondition: truths holds one table per image pair, none without homographies;
+//				 if the save flag is set, the number of correspondences of each pair
+//				 is written to the output directory
+//-------------------------------------------------------------------------------------
+void ScriptData::computeGroundTruth(vector<KeyPoint> *kpts, Mat *images, vector<GroundTruth>& truths) {
+	truths.clear();
+	if (!homographyFlag) { return; }
+
+	string outputDir = (isRunningFromConsole) ? TWO_STEPS + projectDirectory + OUTPUT_DIRECTORY : OUTPUT_DIRECTORY;
+
+	for (int j = 0; j < dataset.activeImageSet.count - 1; ++j) {
+		truths.push_back(GroundTruth(kpts[0], kpts[j + 1], homographies[j], images[j + 1].size()));
+		const GroundTruth& truth = truths.back();
+
+		if (!saveData) { continue; }
+
+		string comparedImages = removeFileExtension(dataset.activeImageSet.imageNames[0]) + "-" + removeFileExtension(dataset.activeImageSet.imageNames[j + 1]);
+		stringstream outFilename;
+		outFilename << outputDir << "GroundTruth_" << dataset.activeImageSet.name << "_" << comparedImages << ".txt";
+
+		// keypoints, keypoints inside image 2, keypoints with a correspondence, corresponding pairs
+		ofstream outFile(outFilename.str().c_str());
+		outFile << kpts[0].size() << "\t" << truth.inBoundsCount() << "\t" << truth.matchableCount() << "\t" << truth.correspondenceCount() << endl;
+		outFile.close();
+
+		printf(">> %s: %d of %d keypoints have a true correspondence\n", comparedImages.c_str(), truth.matchableCount(), (int)kpts[0].size());
+	}
+}
+
+void ScriptData::computeDescriptors(Mat **descriptors, Mat*** table, vector<KeyPoint> *kpts, Mat *images, string* imageNames, const vector<GroundTruth>& truths) {
 	// Compute descriptors
 
 	for(int i = 0; i < numberOfDescriptors; ++i) {
@@ -198,7 +320,7 @@ void ScriptData::computeDescriptors(Mat **descriptors, Mat*** table, vector<KeyP
 		if(saveData) { writeDescriptorToFile(descriptors, imageNames, i); }
 		double t, tf = getTickFrequency();
 		t = (double)getTickCount();
-		performMatching(descriptors, table, kpts, images, i);
+		performMatching(descriptors, table, kpts, images, i, truths);
 		t = (double)getTickCount() - t;
 		printf("perform matching time: %g\n", t*1000. / tf);
 	}
@@ -210,13 +332,22 @@ Mat ScriptData::computeDescriptor(int descIndex, int imagesetIndex, Mat*** table
 
 	cout << ">> Computing " << descriptorTypes[descIndex].name << " descriptor for " << dataset.activeImageSet.imageNames[imagesetIndex] << endl;
 
+	// plain SIFT on the same keypoints is the reference cost for the benchmark
+	if (benchmark && table[_SIFT][imagesetIndex] == NULL) {
+		table[_SIFT][imagesetIndex] = new Mat(timeDescriptor(imagesetIndex, _SIFT, kpts, images));
+	}
+
+	if (fusedExtraction && descriptorTypes[descIndex].descs.size() > 1) {
+		computeFusedParts(descIndex, imagesetIndex, table, kpts, images);
+	}
+
 	for(int k = 0; k < descriptorTypes[descIndex].descs.size(); k++) {
 
 		int type = (int)descriptorTypes[descIndex].descs[k].type;
 
 		// compute descriptor if not yet computed
 		if (table[type][imagesetIndex] == NULL) {
-			descriptorArray[k] = descriptorUtil->computeDescriptors(images[imagesetIndex], kpts[imagesetIndex], descriptorTypes[descIndex].descs[k].type);
+			descriptorArray[k] = timeDescriptor(imagesetIndex, descriptorTypes[descIndex].descs[k].type, kpts, images);
 			table[type][imagesetIndex] = new Mat(descriptorArray[k]);
 		} else { // descriptor has been computed
 			descriptorArray[k] = Mat(*table[type][imagesetIndex]);
@@ -229,6 +360,93 @@ Mat ScriptData::computeDescriptor(int descIndex, int imagesetIndex, Mat*** table
 	return(descriptorArray[0]);
 }
 
+//------------------------------------timeDescriptor()---------------------------------
+// compute one descriptor type for an image, recording its cost if benchmarking
+//Precondition: kpts and images hold the keypoints and image of imagesetIndex
+//Postcondition: the descriptors are returned, as bytes if byteDescriptors is set;
+//				 with benchmark set, the time and the number of keypoints are added
+//				 to the totals of type
+//-------------------------------------------------------------------------------------
+Mat ScriptData::timeDescriptor(int imagesetIndex, DESC_TYPES type, vector<KeyPoint> *kpts, Mat *images) {
+	Mat result;
+	if(!benchmark) {
+		result = descriptorUtil->computeDescriptors(images[imagesetIndex], kpts[imagesetIndex], type, pooledChannels);
+	} else {
+		double t = (double)getTickCount();
+		result = descriptorUtil->computeDescriptors(images[imagesetIndex], kpts[imagesetIndex], type, pooledChannels);
+		descriptorTicks[type] += (double)getTickCount() - t;
+		descriptorKeypoints[type] += (double)kpts[imagesetIndex].size();
+	}
+
+	if(byteDescriptors) { result = DescriptorUtil::quantizeDescriptors(result, type); }
+	return(result);
+}
+
+
+//------------------------------------computeFusedParts()------------------------------
+// compute the parts of a stacked descriptor that are not in the table yet in one pass,
+// recording the cost under the stack if benchmarking
+//Precondition: kpts and images hold the keypoints and image of imagesetIndex
+//Postcondition: if at least two parts were missing, every part has its own entry in table,
+//				 as bytes if byteDescriptors is set
+//-------------------------------------------------------------------------------------
+void ScriptData::computeFusedParts(int descIndex, int imagesetIndex, Mat*** table, vector<KeyPoint> *kpts, Mat *images) {
+	vector<DESC_TYPES> missing;
+
+	for(int k = 0; k < descriptorTypes[descIndex].descs.size(); k++) {
+		DESC_TYPES type = descriptorTypes[descIndex].descs[k].type;
+		if(table[type][imagesetIndex] == NULL && find(missing.begin(), missing.end(), type) == missing.end()) {
+			missing.push_back(type);
+		}
+	}
+	// a single part gains nothing from fusing
+	if(missing.size() < 2) { return; }
+
+	double t = (double)getTickCount();
+	vector<int> widths;
+	Mat stacked = descriptorUtil->computeFusedDescriptors(images[imagesetIndex], kpts[imagesetIndex], missing, widths, pooledChannels);
+
+	if(benchmark) {
+		stackedTicks[descIndex] += (double)getTickCount() - t;
+		stackedKeypoints[descIndex] += (double)kpts[imagesetIndex].size();
+	}
+
+	for(int k = 0, col = 0; k < missing.size(); col += widths[k], k++) {
+		Mat part = stacked.colRange(col, col + widths[k]);
+		part = byteDescriptors ? DescriptorUtil::quantizeDescriptors(part, missing[k]) : part.clone();
+		table[missing[k]][imagesetIndex] = new Mat(part);
+	}
+}
+
+//------------------------------------outputBenchmark()--------------------------------
+// print the per-keypoint cost of every descriptor type that was computed, relative
+// to plain SIFT on the same keypoints
+//Precondition: run() has finished with benchmark set
+//Postcondition: the timings are printed to the console
+//-------------------------------------------------------------------------------------
+void ScriptData::outputBenchmark() {
+	double tf = getTickFrequency();
+	double siftCost = (descriptorKeypoints[_SIFT] > 0) ? descriptorTicks[_SIFT] / descriptorKeypoints[_SIFT] : 0;
+
+	cout << ">> Descriptor cost per keypoint" << endl;
+	for(int type = 0; type < descriptorTableSize; type++) {
+		if(descriptorKeypoints[type] == 0) { continue; }
+
+		double cost = descriptorTicks[type] / descriptorKeypoints[type];
+		printf("%-14s %10.2f us %8.2f x SIFT\n", DescriptorType::getDescriptorName((DESC_TYPES)type).c_str(),
+			cost * 1e6 / tf, (siftCost > 0) ? cost / siftCost : 0.);
+	}
+
+	for(int i = 0; i < numberOfDescriptors; i++) {
+		if(stackedKeypoints[i] == 0) { continue; }
+
+		double cost = stackedTicks[i] / stackedKeypoints[i];
+		printf("%-14s %10.2f us %8.2f x SIFT (fused)\n", descriptorTypes[i].name.c_str(),
+			cost * 1e6 / tf, (siftCost > 0) ? cost / siftCost : 0.);
+	}
+}
+
+
 void ScriptData::writeDescriptorToFile(Mat **descriptors, string* imageNames, int descIndex) {
 	stringstream descriptorFilePath;
 	string outputDir = (isRunningFromConsole) ? TWO_STEPS + projectDirectory + OUTPUT_DIRECTORY : OUTPUT_DIRECTORY;
@@ -253,10 +471,19 @@ void ScriptData::writeDescriptorToFile(Mat **descriptors, string* imageNames, in
 }
 
 
-void ScriptData::performMatching(Mat **descriptors, Mat*** table, vector<KeyPoint> *kpts, Mat *images, int descIndex) {
+//------------------------------------performMatching()--------------------------------
+//match the descriptors of the first image against those of every other image
+//Precondition: the descriptors of descIndex are computed for every image, and truths
+//				holds the ground truth of every pair
+//Postcondition: the results of every pair are written to the output directory
+//-------------------------------------------------------------------------------------
+void ScriptData::performMatching(Mat **descriptors, Mat*** table, vector<KeyPoint> *kpts, Mat *images, int descIndex, const vector<GroundTruth>& truths) {
 
 	if (homographyFlag) {
-		for (int j = 0; j < dataset.activeImageSet.count - 1; ++j) {
+		int pairs = dataset.activeImageSet.count - 1;
+		vector<string> outFilenames(pairs);
+
+		for (int j = 0; j < pairs; ++j) {
 			stringstream outFilename;
 			
 			string comparedImages = removeFileExtension(dataset.activeImageSet.imageNames[0]) + "-" + removeFileExtension(dataset.activeImageSet.imageNames[j + 1]);
@@ -264,9 +491,32 @@ void ScriptData::performMatching(Mat **descriptors, Mat*** table, vector<KeyPoin
 			string outputDir = (isRunningFromConsole) ? TWO_STEPS + projectDirectory + OUTPUT_DIRECTORY : OUTPUT_DIRECTORY;
 
 			outFilename << outputDir << descriptorTypes[descIndex].name << "_" << dataset.activeImageSet.name << "_" << comparedImages << ".txt";
+			outFilenames[j] = outFilename.str();
+		}
 
-			descriptorUtil->match(descriptors[descIndex][0], descriptors[descIndex][j + 1], kpts[0], kpts[j + 1], images[0], images[j + 1], homographies[j], outFilename.str(), drawMatches);
+		// the first image is the query side of every pair, so it is prepared once
+		NNQuery query = NNMatcher::prepare(descriptors[descIndex][0]);
+		// the parts of a stacked descriptor are in the table
+		vector<Mat> fusionQuery;
+		vector<vector<Mat> > fusionTrain(pairs);
+		if (!fusionWeights.empty() && descriptorTypes[descIndex].descs.size() > 1) {
+			for (int k = 0; k < descriptorTypes[descIndex].descs.size(); k++) {
+				int type = (int)descriptorTypes[descIndex].descs[k].type;
+				fusionQuery.push_back(*table[type][0]);
+				for (int j = 0; j < pairs; ++j) { fusionTrain[j].push_back(*table[type][j + 1]); }
+			}
 		}
+
+		vector<string> logs(pairs);
+		MatchPairsBody body(descriptorUtil, query, descriptors[descIndex], kpts, images, truths, outFilenames, drawMatches, matcher, ratioStrategy, mutualStrategy, guidedRadius,
+			fusionWeights, fusionQuery, fusionTrain, logs);
+
+		// the pairs write separate files, so they can run at the same time, unless each one
+		// has to wait for its match window to be closed or the backend draws from rand(),
+		// whose state the threads would share
+		if (drawMatches || (!matcher.empty() && matcher->isRandomised())) { body(Range(0, pairs)); }
+		else { parallel_for_(Range(0, pairs), body); }
+		for (int j = 0; j < pairs; ++j) { cout << logs[j]; }
 	}
 }
 
@@ -9,6 +9,8 @@
 
 #include "ConfigurationManager.h"
 #include "DescriptorType.h"
+#include "NNMatcher.h"
+#include "GroundTruth.h"
 #include <opencv2/opencv.hpp>
 #include <string>
 #include <iostream>
@@ -53,6 +55,16 @@ public:
 	bool failed = false;
 	bool saveData = false;
 	bool drawMatches = false;
+	bool benchmark = false;
+	bool fusedExtraction = false;
+	bool pooledChannels = false;
+	Ptr<NNMatcher> matcher;
+	bool ratioStrategy = false;
+	bool mutualStrategy = false;
+	vector<float> fusionWeights;
+	float guidedRadius = 0;
+	int maxFeatures = MAX_FEATURES;
+	bool byteDescriptors = false;
 	bool isRunningFromConsole;
 	bool homographyFlag;
 
@@ -65,6 +77,12 @@ public:
 	DESC_TYPES featureExtractor;
 	string featureExtractorText;
 	int descriptorTableSize;
+	// benchmark totals, indexed by DESC_TYPES
+	vector<double> descriptorTicks;
+	vector<double> descriptorKeypoints;
+	// benchmark totals of fused stacks, indexed like descriptorTypes
+	vector<double> stackedTicks;
+	vector<double> stackedKeypoints;
 
 	ScriptData();
 	ScriptData(ConfigurationManager configs);
@@ -93,10 +111,14 @@ private:
 	void initDescriptors(Mat **descriptors);
 	void computeKeypoints(vector<KeyPoint> *kpts, Mat *images, string* imageNames);
 	void writeKeypointsToFile(vector<cv::KeyPoint> *kpts, string* imageNames);
-	void computeDescriptors(Mat **descriptors, Mat*** table, vector<KeyPoint> *kpts, Mat *images, string* imageNames);
+	void computeGroundTruth(vector<KeyPoint> *kpts, Mat *images, vector<GroundTruth>& truths);
+	void computeDescriptors(Mat **descriptors, Mat*** table, vector<KeyPoint> *kpts, Mat *images, string* imageNames, const vector<GroundTruth>& truths);
 	Mat computeDescriptor(int descIndex, int imagesetIndex, Mat*** table, vector<KeyPoint> *kpts, Mat *images);
+	Mat timeDescriptor(int imagesetIndex, DESC_TYPES type, vector<KeyPoint> *kpts, Mat *images);
+	void computeFusedParts(int descIndex, int imagesetIndex, Mat*** table, vector<KeyPoint> *kpts, Mat *images);
+	void outputBenchmark();
 	void writeDescriptorToFile(Mat **descriptors, string* imageNames, int descIndex);
-	void performMatching(Mat **descriptors, Mat*** table, vector<KeyPoint> *kpts, Mat *images, int descIndex);
+	void performMatching(Mat **descriptors, Mat*** table, vector<KeyPoint> *kpts, Mat *images, int descIndex, const vector<GroundTruth>& truths);
 	void freeMemory(Mat*** table, Mat **descriptors, vector<cv::KeyPoint> *kpts, Mat *images, string *imageNames);
 
 	string removeFileExtension(string str);
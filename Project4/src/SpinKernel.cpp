@@ -0,0 +1,202 @@
+#include "SpinKernel.h"
+
+size_t SpinKernel::cachedSamples = 0;
+std::mutex SpinKernel::cacheLock;
+map<long long, Ptr<SpinWindow> > SpinKernel::windows;
+
+//------------------------------------getWindow()--------------------------------------
+// find or build the distance table of a spin window
+//Precondition: the following parameters must be correclty defined.
+//parameters:
+	//radius: window radius in pixels, samples further away are skipped
+	//circRadius: radius covered by the distance bins
+	//distanceBins: number of distance bins
+//Postcondition: the shared window is returned
+//-------------------------------------------------------------------------------------
+Ptr<SpinWindow> SpinKernel::getWindow(int radius, int circRadius, int distanceBins)
+{
+	long long key = ((long long)distanceBins << 48) | ((long long)circRadius << 24) | (long long)radius;
+
+	std::lock_guard<std::mutex> lock(cacheLock);
+
+	map<long long, Ptr<SpinWindow> >::iterator it = windows.find(key);
+	if (it != windows.end())
+		return it->second;
+
+	Ptr<SpinWindow> window = makePtr<SpinWindow>();
+	buildWindow(*window, radius, circRadius, distanceBins);
+
+	// windows already handed out stay alive through their Ptr
+	if (cachedSamples + window->rowOffset.size() > MAX_CACHED_SAMPLES)
+	{
+		windows.clear();
+		cachedSamples = 0;
+	}
+	windows[key] = window;
+	cachedSamples += window->rowOffset.size();
+
+	return window;
+}
+
+//------------------------------------buildWindow()------------------------------------
+// compute the distance bins and distance exponents of every pixel of a spin window
+//Precondition: the following parameters must be correclty defined.
+//Postcondition: the window is filled, in raster order
+//-------------------------------------------------------------------------------------
+void SpinKernel::buildWindow(SpinWindow& window, int radius, int circRadius, int distanceBins)
+{
+	// this is the number of distance bins per pixel
+	float bins_per_distance = (float)distanceBins / circRadius;
+
+	// the "soft width" of the distance bins
+	float alpha = (float)circRadius / (float)distanceBins;
+	float distanceDenominator = 2 * alpha * alpha;
+
+	for (int i = -radius; i <= radius; i++)
+		for (int j = -radius; j <= radius; j++)
+		{
+			float distance = (float)sqrt((double)(i*i + j*j));
+			if (distance > radius)
+				continue;
+
+			int imin = 0, count = 0;
+			float exponent[MAX_NEIGHBOUR_BINS] = { 0.f, 0.f, 0.f };
+
+			// a window narrower than one pixel has no distance bins to vote for
+			if (circRadius > 0)
+			{
+				int distance_bin = (int)(distance * bins_per_distance);
+				// this handles edge case when distance_bin is at the radius length
+				distance_bin = std::min(distanceBins - 1, distance_bin);
+
+				imin = std::max(0, distance_bin - 1);
+				int imax = std::min(distanceBins - 1, distance_bin + 1);
+				count = imax - imin + 1;
+
+				for (int b = 0; b < count; b++)
+				{
+					float i_dist = (imin + b + 0.5f) * alpha;
+					float diff = distance - i_dist;
+					exponent[b] = (diff * diff) / distanceDenominator;
+				}
+			}
+
+			window.rowOffset.push_back(i);
+			window.colOffset.push_back(j);
+			window.firstBin.push_back(imin);
+			window.binCount.push_back(count);
+			for (int b = 0; b < MAX_NEIGHBOUR_BINS; b++)
+				window.exponent.push_back(exponent[b]);
+		}
+}
+
+//------------------------------------collectSamples()---------------------------------
+// list the window samples that fall inside the image
+//Precondition: the following parameters must be correclty defined.
+//parameters:
+	//window: window returned by getWindow()
+	//pt: keypoint location in the pyramid level
+	//rows, cols: size of the pyramid level
+	//R, C: buffers receiving the sample pixel coordinates
+	//index: buffer receiving the sample index in the window
+//Postcondition: the number of samples is returned, in raster order
+//-------------------------------------------------------------------------------------
+int SpinKernel::collectSamples(const SpinWindow& window, Point pt, int rows, int cols, int* R, int* C, int* index)
+{
+	int total = (int)window.rowOffset.size(), k = 0;
+
+	for (int s = 0; s < total; s++)
+	{
+		int r = pt.y + window.rowOffset[s], c = pt.x + window.colOffset[s];
+
+		if (r > -1 && c > -1 && r < rows - 1 && c < cols - 1)
+		{
+			R[k] = r; C[k] = c;
+			index[k] = s;
+			k++;
+		}
+	}
+	return k;
+}
+
+//------------------------------------vote()-------------------------------------------
+// add the soft votes of normalised intensities to a distance x intensity histogram
+//Precondition: the following parameters must be correclty defined.
+//parameters:
+	//window: window the samples were collected from
+	//index: sample index in the window
+	//intensity: normalised intensity of each sample
+	//len: number of samples
+	//distanceBins, intensityBins: histogram size
+	//dst: histogram, distanceBins rows of intensityBins
+	//sums: total weight of each histogram row
+//Postcondition: dst and sums are updated
+//-------------------------------------------------------------------------------------
+void SpinKernel::vote(const SpinWindow& window, const int* index, const float* intensity, int len,
+	int distanceBins, int intensityBins, float* dst, float* sums)
+{
+	// this is the number of intensity bins per unit
+	float bins_per_intensity = (float)intensityBins / 255.f;
+
+	// the "soft width" of the intensity bins
+	float beta = 255.f / (float)intensityBins;
+	float intensityDenominator = 2 * beta * beta;
+
+	for (int k = 0; k < len; k++)
+	{
+		int s = index[k];
+		int count = window.binCount[s];
+		float binf = intensity[k] * bins_per_intensity;
+
+		// a bin more than one below zero (or beyond int range) has no neighbours
+		// inside the histogram, so the sample casts no votes
+		if (count == 0 || !(binf > -2.f && binf < 2147483648.f))
+			continue;
+
+		int intensity_bin = (int)binf;
+		// this handles edge case when intensity_bin is at the radius length
+		intensity_bin = std::min(intensityBins - 1, intensity_bin);
+
+		int jmin = std::max(0, intensity_bin - 1);
+		int jmax = std::min(intensityBins - 1, intensity_bin + 1);
+
+		float intensityExponent[MAX_NEIGHBOUR_BINS];
+		for (int j = jmin; j <= jmax; j++)
+		{
+			float diff = intensity[k] - (j + 0.5f) * beta;
+			intensityExponent[j - jmin] = (diff * diff) / intensityDenominator;
+		}
+
+		int imin = window.firstBin[s];
+		const float* distanceExponent = &window.exponent[s * MAX_NEIGHBOUR_BINS];
+
+		for (int b = 0; b < count; b++)
+		{
+			float* row = dst + (imin + b) * intensityBins;
+			for (int j = jmin; j <= jmax; j++)
+			{
+				// one exponential of the whole exponent, as the kernel was first written
+				float expo = std::exp(-distanceExponent[b] - intensityExponent[j - jmin]);
+
+				// add final calculation to sums array for normalization of weights
+				sums[imin + b] += expo;
+				row[j] += expo;
+			}
+		}
+	}
+}
+
+//------------------------------------normalizeRows()----------------------------------
+// divide each histogram row by its total weight
+//Precondition: sums holds the row totals accumulated by vote()
+//Postcondition: every row of dst sums to one, empty rows stay zero
+//-------------------------------------------------------------------------------------
+void SpinKernel::normalizeRows(float* dst, const float* sums, int distanceBins, int intensityBins)
+{
+	for (int i = 0; i < distanceBins; i++)
+	{
+		float sum = std::max(sums[i], FLT_EPSILON);
+		for (int j = 0; j < intensityBins; j++)
+			dst[i * intensityBins + j] /= sum;
+	}
+}
@@ -0,0 +1,105 @@
+//-------------------------------------------------------------------------
+// Name: SpinKernel.h
+// Description: Shared engine for the spin image descriptors (SPIN, CSPIN).
+//  The soft-binning kernel is a Gaussian over the distance and intensity
+//  bin-centre offsets. The distance part of its exponent depends only on
+//  where a pixel lies in the circular window, so it is kept in a table per
+//  window radius, and the intensity part is computed once per sample and
+//  neighbouring bin. The exponential of their sum is taken in the same
+//  order as the original per-bin code, so the histograms are unchanged.
+// Methods:
+//			getWindow()
+//			collectSamples()
+//			vote()
+//			normalizeRows()
+//-------------------------------------------------------------------------
+
+#ifndef SPIN_KERNEL_H
+#define SPIN_KERNEL_H
+
+#include "opencv2/opencv.hpp"
+#include <map>
+#include <mutex>
+#include <vector>
+
+using namespace std;
+using namespace cv;
+
+#ifdef __cplusplus
+
+/*!
+	Distance terms of every pixel of one circular spin window
+*/
+struct SpinWindow
+{
+	vector<int> rowOffset;		// sample row offset relative to the keypoint
+	vector<int> colOffset;		// sample column offset relative to the keypoint
+	vector<int> firstBin;		// first distance bin the sample votes for
+	vector<int> binCount;		// number of distance bins the sample votes for (0 to 3)
+	vector<float> exponent;		// distance parts of the exponent of those bins, three per sample
+};
+
+class SpinKernel
+{
+public:
+	static const int MAX_NEIGHBOUR_BINS = 3;			// a sample votes for its bin and both neighbours
+	static const size_t MAX_CACHED_SAMPLES = 1 << 22;	// total samples kept before the cache is flushed
+
+//------------------------------------getWindow()--------------------------------------
+// find or build the distance table of a spin window
+//Precondition: the following parameters must be correclty defined.
+//parameters:
+	//radius: window radius in pixels, samples further away are skipped
+	//circRadius: radius covered by the distance bins
+	//distanceBins: number of distance bins
+//Postcondition: the shared window is returned
+//-------------------------------------------------------------------------------------
+	static Ptr<SpinWindow> getWindow(int radius, int circRadius, int distanceBins);
+
+//------------------------------------collectSamples()---------------------------------
+// list the window samples that fall inside the image
+//Precondition: the following parameters must be correclty defined.
+//parameters:
+	//window: window returned by getWindow()
+	//pt: keypoint location in the pyramid level
+	//rows, cols: size of the pyramid level
+	//R, C: buffers receiving the sample pixel coordinates
+	//index: buffer receiving the sample index in the window
+//Postcondition: the number of samples is returned, in raster order
+//-------------------------------------------------------------------------------------
+	static int collectSamples(const SpinWindow& window, Point pt, int rows, int cols, int* R, int* C, int* index);
+
+//------------------------------------vote()-------------------------------------------
+// add the soft votes of normalised intensities to a distance x intensity histogram
+//Precondition: the following parameters must be correclty defined.
+//parameters:
+	//window: window the samples were collected from
+	//index: sample index in the window
+	//intensity: normalised intensity of each sample
+	//len: number of samples
+	//distanceBins, intensityBins: histogram size
+	//dst: histogram, distanceBins rows of intensityBins
+	//sums: total weight of each histogram row
+//Postcondition: dst and sums are updated
+//-------------------------------------------------------------------------------------
+	static void vote(const SpinWindow& window, const int* index, const float* intensity, int len,
+		int distanceBins, int intensityBins, float* dst, float* sums);
+
+//------------------------------------normalizeRows()----------------------------------
+// divide each histogram row by its total weight
+//Precondition: sums holds the row totals accumulated by vote()
+//Postcondition: every row of dst sums to one, empty rows stay zero
+//-------------------------------------------------------------------------------------
+	static void normalizeRows(float* dst, const float* sums, int distanceBins, int intensityBins);
+
+private:
+	static size_t cachedSamples;
+	static std::mutex cacheLock;
+	static map<long long, Ptr<SpinWindow> > windows;
+
+	static void buildWindow(SpinWindow& window, int radius, int circRadius, int distanceBins);
+};
+
+#endif /* __cplusplus */
+
+#endif
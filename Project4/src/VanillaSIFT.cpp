@@ -34,7 +34,8 @@ const float VanillaSIFT::SIFT_INT_DESCR_FCTR = 512.f;
 //Postcondition: variables are assigned
 //-------------------------------------------------------------------------------------
 VanillaSIFT::VanillaSIFT( int _nfeatures, int _nOctaveLayers, double _contrastThreshold, double _edgeThreshold, double _sigma )
-    : nfeatures(_nfeatures), nOctaveLayers(_nOctaveLayers), contrastThreshold(_contrastThreshold), edgeThreshold(_edgeThreshold), sigma(_sigma)
+    : nfeatures(_nfeatures), nOctaveLayers(_nOctaveLayers), contrastThreshold(_contrastThreshold), edgeThreshold(_edgeThreshold), sigma(_sigma),
+	poolChannels(false)
 {
 }
 
@@ -48,6 +49,36 @@ int VanillaSIFT::descriptorSize() const
     return SIFT_DESCR_WIDTH*SIFT_DESCR_WIDTH*SIFT_DESCR_HIST_BINS;
 }
 
+//------------------------------------setChannelPooling()------------------------------
+// turn pooling of the colour channels on or off
+//Precondition: None
+//Postcondition: descriptors computed afterwards are pooled if pool is true
+//-------------------------------------------------------------------------------------
+void VanillaSIFT::setChannelPooling(bool pool)
+{
+	poolChannels = pool;
+}
+
+//------------------------------------outputSize()-------------------------------------
+// ! returns the number of floats written per keypoint
+//Precondition: None
+//Postcondition: descriptorSize(), divided by the number of channels when pooling
+//-------------------------------------------------------------------------------------
+int VanillaSIFT::outputSize() const
+{
+	return poolChannels ? descriptorSize() / descriptorChannels() : descriptorSize();
+}
+
+//------------------------------------descriptorChannels()-----------------------------
+// ! returns the number of equal channel blocks stacked in the descriptor
+//Precondition: None
+//Postcondition: 1 is returned
+//-------------------------------------------------------------------------------------
+int VanillaSIFT::descriptorChannels() const
+{
+	return 1;
+}
+
 //------------------------------------descriptorType()---------------------------------
 //! returns the descriptor type
 //Precondition: None
@@ -162,7 +193,7 @@ void VanillaSIFT::operator()(InputArray _image, InputArray _mask, vector<KeyPoin
 	if (_descriptors.needed())
 	{
 		t = (double)getTickCount();
-		int dsize = descriptorSize();
+		int dsize = outputSize();
 		_descriptors.create((int)keypoints.size(), dsize, CV_32F);
 		Mat descriptors = _descriptors.getMat();
 
@@ -636,128 +667,37 @@ void VanillaSIFT::calcSIFTDescriptor( const Mat& img, Point2f ptf, float ori, fl
 {
 
     Point pt(cvRound(ptf.x), cvRound(ptf.y));
-    float cos_t = cosf(ori*(float)(CV_PI/180));
-    float sin_t = sinf(ori*(float)(CV_PI/180));
-    float bins_per_rad = n / 360.f;
-    float exp_scale = -1.f/(d * d * 0.5f);
     float hist_width = SIFT_DESCR_SCL_FCTR * scl;
     int radius = cvRound(hist_width * 1.4142135623730951f * (d + 1) * 0.5f);
     // Clip the radius to the diagonal of the image to avoid autobuffer too large exception
     radius = std::min(radius, (int) sqrt((double) img.cols*img.cols + img.rows*img.rows));
-    cos_t /= hist_width;
-    sin_t /= hist_width;
 
-    int i, j, k, len = (radius*2+1)*(radius*2+1), histlen = (d+2)*(d+2)*(n+2);
+    int k, len = (radius*2+1)*(radius*2+1);
     int rows = img.rows, cols = img.cols;
 
-    AutoBuffer<float> buf(len*6 + histlen);
-    float *X = buf, *Y = X + len, *Mag = Y, *Ori = Mag + len, *W = Ori + len;
-    float *RBin = W + len, *CBin = RBin + len, *hist = CBin + len;
-
-    for( i = 0; i < d+2; i++ )
-    {
-        for( j = 0; j < d+2; j++ )
-            for( k = 0; k < n+2; k++ )
-                hist[(i*(d+2) + j)*(n+2) + k] = 0.;
-    }
-
-    for( i = -radius, k = 0; i <= radius; i++ )
-        for( j = -radius; j <= radius; j++ )
-        {
-            // Calculate sample's histogram array coords rotated relative to ori.
-            // Subtract 0.5 so samples that fall e.g. in the center of row 1 (i.e.
-            // r_rot = 1.5) have full weight placed in row 1 after interpolation.
-            float c_rot = j * cos_t - i * sin_t;
-            float r_rot = j * sin_t + i * cos_t;
-            float rbin = r_rot + d/2 - 0.5f;
-            float cbin = c_rot + d/2 - 0.5f;
-            int r = pt.y + i, c = pt.x + j;
-
-            if( rbin > -1 && rbin < d && cbin > -1 && cbin < d &&
-                r > 0 && r < rows - 1 && c > 0 && c < cols - 1 )
-            {
-                float dx = (float)(img.at<sift_wt>(r, c+1) - img.at<sift_wt>(r, c-1));
-                float dy = (float)(img.at<sift_wt>(r-1, c) - img.at<sift_wt>(r+1, c));
-                X[k] = dx; Y[k] = dy; RBin[k] = rbin; CBin[k] = cbin;
-                W[k] = (c_rot * c_rot + r_rot * r_rot)*exp_scale;
-                k++;
-            }
-        }
+    AutoBuffer<float> buf(len*6);
+    float *X = buf, *Y = X + len, *Mag = Y, *Obin = Mag + len, *W = Obin + len;
+    float *RBin = W + len, *CBin = RBin + len;
+    AutoBuffer<int> pos(len*2);
+    int *R = pos, *C = R + len;
 
-    len = k;
-    hal::fastAtan2(Y, X, Ori, len, true);
-    hal::magnitude(X, Y, Mag, len);
-    hal::exp(W, W, len);
+    // rotated bin coordinates and Gaussian weights of the window samples
+    len = SamplingPatternCache::collectSamples(pt, ori, hist_width, radius, d, rows, cols, R, C, RBin, CBin, W);
 
     for( k = 0; k < len; k++ )
     {
-        float rbin = RBin[k], cbin = CBin[k];
-        float obin = (Ori[k] - ori)*bins_per_rad;
-        float mag = Mag[k]*W[k];
-
-        int r0 = cvFloor( rbin );
-        int c0 = cvFloor( cbin );
-        int o0 = cvFloor( obin );
-        rbin -= r0;
-        cbin -= c0;
-        obin -= o0;
-
-        if( o0 < 0 )
-            o0 += n;
-        if( o0 >= n )
-            o0 -= n;
-
-        // histogram update using tri-linear interpolation
-        float v_r1 = mag*rbin, v_r0 = mag - v_r1;
-        float v_rc11 = v_r1*cbin, v_rc10 = v_r1 - v_rc11;
-        float v_rc01 = v_r0*cbin, v_rc00 = v_r0 - v_rc01;
-        float v_rco111 = v_rc11*obin, v_rco110 = v_rc11 - v_rco111;
-        float v_rco101 = v_rc10*obin, v_rco100 = v_rc10 - v_rco101;
-        float v_rco011 = v_rc01*obin, v_rco010 = v_rc01 - v_rco011;
-        float v_rco001 = v_rc00*obin, v_rco000 = v_rc00 - v_rco001;
-
-        int idx = ((r0+1)*(d+2) + c0+1)*(n+2) + o0;
-        hist[idx] += v_rco000;
-        hist[idx+1] += v_rco001;
-        hist[idx+(n+2)] += v_rco010;
-        hist[idx+(n+3)] += v_rco011;
-        hist[idx+(d+2)*(n+2)] += v_rco100;
-        hist[idx+(d+2)*(n+2)+1] += v_rco101;
-        hist[idx+(d+3)*(n+2)] += v_rco110;
-        hist[idx+(d+3)*(n+2)+1] += v_rco111;
+        int r = R[k], c = C[k];
+        X[k] = (float)(img.at<sift_wt>(r, c+1) - img.at<sift_wt>(r, c-1));
+        Y[k] = (float)(img.at<sift_wt>(r-1, c) - img.at<sift_wt>(r+1, c));
     }
 
-    // finalize histogram, since the orientation histograms are circular
-    for( i = 0; i < d; i++ )
-        for( j = 0; j < d; j++ )
-        {
-            int idx = ((i+1)*(d+2) + (j+1))*(n+2);
-            hist[idx] += hist[idx+n];
-            hist[idx+1] += hist[idx+n+1];
-            for( k = 0; k < n; k++ )
-                dst[(i*d + j)*n + k] = hist[idx+k];
-        }
-    // copy histogram to the descriptor,
-    // apply hysteresis thresholding
-    // and scale the result, so that it can be easily converted
-    // to byte array
-    float nrm2 = 0;
-    len = d*d*n;
-    for( k = 0; k < len; k++ )
-        nrm2 += dst[k]*dst[k];
-    float thr = std::sqrt(nrm2)*SIFT_DESCR_MAG_THR;
-    for( i = 0, nrm2 = 0; i < k; i++ )
-    {
-        float val = std::min(dst[i], thr);
-        dst[i] = val;
-        nrm2 += val*val;
-    }
-    nrm2 = SIFT_INT_DESCR_FCTR/std::max(std::sqrt(nrm2), FLT_EPSILON);
+    GradientBins::compute(X, Y, len, ori, n, Obin, Mag);
 
-    for( k = 0; k < len; k++ )
-    {
-        dst[k] = /*saturate_cast<uchar>*/(dst[k]*nrm2);		//cfolson: eliminated cast to byte from float, unnecessary
-    }
+    // tri-linear voting and folding of the circular orientation bins
+    OrientationHistogram::accumulate(RBin, CBin, W, &Obin, &Mag, len, d, n, 1, dst);
+
+    // apply hysteresis thresholding and scale the result
+    DescriptorNormalizer::normalize(dst, d*d*n);
 }
 
 //------------------------------------calcDescriptors()--------------------------------
@@ -792,7 +732,98 @@ void VanillaSIFT::calcDescriptors(const std::vector<Mat>& gpyr, const std::vecto
             angle = 0.f;
 
 		//printf("octave: %3d     scale: %5.1f     size: %5.1f\n", octave, scale, size*0.5f);
-        calcSIFTDescriptor(img, ptf, angle, size*0.5f, d, n, descriptors.ptr<float>((int)i));
+        describeKeypoint(img, ptf, angle, size*0.5f, d, n, descriptors.ptr<float>((int)i));
     }
 }
 
+//------------------------------------describeKeypoint()-------------------------------
+// call calcSIFTDescriptor() for one keypoint and pool its channels if requested
+//Precondition: dst has room for outputSize() floats
+//Postcondition: dst holds the descriptor of the keypoint
+//-------------------------------------------------------------------------------------
+void VanillaSIFT::describeKeypoint(const Mat& img, Point2f ptf, float ori, float scl, int d, int n, float* dst) const
+{
+	int channels = descriptorChannels();
+
+	if (!poolChannels || channels == 1)
+	{
+		calcSIFTDescriptor(img, ptf, ori, scl, d, n, dst);
+		return;
+	}
+
+	// the stacked channels of the colour descriptors fit in the buffer, so it stays on the stack
+	AutoBuffer<float, 4*SIFT_DESCR_WIDTH*SIFT_DESCR_WIDTH*SIFT_DESCR_HIST_BINS> stacked(descriptorSize());
+	calcSIFTDescriptor(img, ptf, ori, scl, d, n, stacked);
+	DescriptorNormalizer::pool(stacked, descriptorSize(), channels, dst);
+}
+
+//------------------------------------providedOctaveRange()----------------------------
+// find the octaves a pyramid must cover to describe user-provided keypoints
+//Precondition: keypoints is not empty
+//Postcondition: firstOctave (-1 or 0) and nOctaves are assigned
+//-------------------------------------------------------------------------------------
+void VanillaSIFT::providedOctaveRange(const std::vector<KeyPoint>& keypoints, int& firstOctave, int& nOctaves) const
+{
+	int maxOctave = INT_MIN, actualNLayers = 0;
+	firstOctave = 0;
+
+	for (size_t i = 0; i < keypoints.size(); i++)
+	{
+		int octave, layer;
+		float scale;
+		unpackOctave(keypoints[i], octave, layer, scale);
+		firstOctave = std::min(firstOctave, octave);
+		maxOctave = std::max(maxOctave, octave);
+		actualNLayers = std::max(actualNLayers, layer - 2);
+	}
+
+	firstOctave = std::min(firstOctave, 0);
+	CV_Assert(firstOctave >= -1 && actualNLayers <= nOctaveLayers);
+	nOctaves = maxOctave - firstOctave + 1;
+}
+
+//------------------------------------buildDescriptorPyramid()-------------------------
+// build the pyramid that calcDescriptors() reads, for user-provided keypoints
+//Precondition: the following parameters must be correclty defined.
+//parameters:
+	//image: 8-bit image passed to the descriptor
+	//keypoints: keypoints whose descriptors will be computed
+	//firstOctave, nOctaves: octave range from providedOctaveRange()
+	//pyr: receives the pyramid
+//Postcondition: pyr holds the grey gaussian pyramid
+//-------------------------------------------------------------------------------------
+void VanillaSIFT::buildDescriptorPyramid(const Mat& image, const std::vector<KeyPoint>& keypoints, int firstOctave, int nOctaves, std::vector<Mat>& pyr) const
+{
+	Mat base = createInitialImage(image, firstOctave < 0, (float)sigma);
+	buildGaussianPyramid(base, pyr, nOctaves);
+}
+
+//------------------------------------transformPyramidLevels()-------------------------
+// apply a colour transform to the pyramid levels that keypoints refer to; levels no
+// keypoint uses are left empty
+//Precondition: the following parameters must be correclty defined.
+//parameters:
+	//pyr: gaussian pyramid
+	//keypoints: keypoints whose descriptors will be computed
+	//nOctaveLayers: number of octave layers
+	//firstOctave: index of first octave
+	//transform: colour transform applied to each referenced level
+	//dst: receives the transformed pyramid
+//Postcondition: dst has one entry per level of pyr
+//-------------------------------------------------------------------------------------
+void VanillaSIFT::transformPyramidLevels(const std::vector<Mat>& pyr, const std::vector<KeyPoint>& keypoints, int nOctaveLayers, int firstOctave, ColorTransform::Kernel transform, std::vector<Mat>& dst)
+{
+	dst.assign(pyr.size(), Mat());
+
+	for (size_t i = 0; i < keypoints.size(); i++)
+	{
+		int octave, layer;
+		float scale;
+		unpackOctave(keypoints[i], octave, layer, scale);
+		int level = (octave - firstOctave)*(nOctaveLayers + 3) + layer;
+
+		if (level >= 0 && level < (int)pyr.size() && dst[level].empty())
+			transform(pyr[level], dst[level]);
+	}
+}
+
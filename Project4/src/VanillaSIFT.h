@@ -10,12 +10,19 @@
 //			operator()
 //			descriptorSize()
 //			descriptorType()
+//			setChannelPooling()
+//			outputSize()
 //			compute()
 //			buildGaussianPyramid()
 //			buildDoGPyramid()
 //			findScaleSpaceExtrema()
 //			calcDescriptors()
+//			providedOctaveRange()
+//			buildDescriptorPyramid()
+//			transformPyramidLevels()
 //			calcSIFTDescriptor()
+//			descriptorChannels()
+//			describeKeypoint()
 //			createInitialImage()
 //			detectImpl()
 //			compteImpl()
@@ -97,6 +104,11 @@
 #include "opencv2/features2d/features2d.hpp"
 #include "opencv2/opencv.hpp"
 #include "opencv2\core\mat.hpp"
+#include "SamplingPattern.h"
+#include "GradientBins.h"
+#include "OrientationHistogram.h"
+#include "ColorTransform.h"
+#include "DescriptorNormalizer.h"
 #include <algorithm>
 #include <stdarg.h>
 #include <iostream>
@@ -105,9 +117,13 @@ using namespace std;
 using namespace cv;
 #ifdef __cplusplus
 
+// computes several descriptors of the same keypoints in one pass
+class FusedDescriptor;
+
 namespace cv {
 
 	class CV_EXPORTS_W VanillaSIFT : public Feature2D {
+		friend class ::FusedDescriptor;
 
 	public:
 		static const int SIFT_DESCR_WIDTH = 4;			// default width of descriptor histogram array
@@ -163,6 +179,23 @@ namespace cv {
 //-------------------------------------------------------------------------------------
 		CV_WRAP virtual int descriptorType() const;
 
+//------------------------------------setChannelPooling()------------------------------
+// turn pooling of the colour channels on or off. A pooled descriptor sums the
+// channel blocks of the stacked descriptor into one block and renormalises it, so
+// RGBSIFT gives 128 floats instead of 384.
+//Precondition: None
+//Postcondition: descriptors computed afterwards are pooled if pool is true; the
+//				 setting has no effect on single channel descriptors
+//-------------------------------------------------------------------------------------
+		CV_WRAP void setChannelPooling(bool pool);
+
+//------------------------------------outputSize()-------------------------------------
+// ! returns the number of floats written per keypoint
+//Precondition: None
+//Postcondition: descriptorSize(), divided by the number of channels when pooling
+//-------------------------------------------------------------------------------------
+		CV_WRAP int outputSize() const;
+
 //------------------------------------operator()---------------------------------------
 // Overloading operator() to run the SIFT algorithm :
 // 1. compute keypoints using local extrema of Dog space
@@ -250,6 +283,40 @@ namespace cv {
 //Postcondition: descriptors are assigned
 //-------------------------------------------------------------------------------------
 		virtual void calcDescriptors(const std::vector<Mat>& gpyr, const std::vector<KeyPoint>& keypoints, Mat& descriptors, int nOctaveLayers, int firstOctave) const;
+
+//------------------------------------providedOctaveRange()----------------------------
+// find the octaves a pyramid must cover to describe user-provided keypoints
+//Precondition: keypoints is not empty
+//Postcondition: firstOctave (-1 or 0) and nOctaves are assigned
+//-------------------------------------------------------------------------------------
+		void providedOctaveRange(const std::vector<KeyPoint>& keypoints, int& firstOctave, int& nOctaves) const;
+
+//------------------------------------buildDescriptorPyramid()-------------------------
+// build the pyramid that calcDescriptors() reads, for user-provided keypoints
+//Precondition: the following parameters must be correclty defined.
+//parameters:
+	//image: 8-bit image passed to the descriptor
+	//keypoints: keypoints whose descriptors will be computed
+	//firstOctave, nOctaves: octave range from providedOctaveRange()
+	//pyr: receives the pyramid
+//Postcondition: pyr holds the grey gaussian pyramid
+//-------------------------------------------------------------------------------------
+		virtual void buildDescriptorPyramid(const Mat& image, const std::vector<KeyPoint>& keypoints, int firstOctave, int nOctaves, std::vector<Mat>& pyr) const;
+
+//------------------------------------transformPyramidLevels()-------------------------
+// apply a colour transform to the pyramid levels that keypoints refer to; levels no
+// keypoint uses are left empty
+//Precondition: the following parameters must be correclty defined.
+//parameters:
+	//pyr: gaussian pyramid
+	//keypoints: keypoints whose descriptors will be computed
+	//nOctaveLayers: number of octave layers
+	//firstOctave: index of first octave
+	//transform: colour transform applied to each referenced level
+	//dst: receives the transformed pyramid
+//Postcondition: dst has one entry per level of pyr
+//-------------------------------------------------------------------------------------
+		static void transformPyramidLevels(const std::vector<Mat>& pyr, const std::vector<KeyPoint>& keypoints, int nOctaveLayers, int firstOctave, ColorTransform::Kernel transform, std::vector<Mat>& dst);
 		
 //------------------------------------calcSIFTDescriptor()-----------------------------
 // compute SIFT descriptor and perform normalization for one keypoint
@@ -266,6 +333,23 @@ namespace cv {
 //-------------------------------------------------------------------------------------
 		virtual void calcSIFTDescriptor(const Mat& img, Point2f ptf, float ori, float scl, int d, int n, float* dst) const;
 
+//------------------------------------descriptorChannels()-----------------------------
+// ! returns the number of equal channel blocks stacked in the descriptor
+//Precondition: None
+//Postcondition: 1, multi-channel descriptors override it
+//-------------------------------------------------------------------------------------
+		virtual int descriptorChannels() const;
+
+//------------------------------------describeKeypoint()-------------------------------
+// call calcSIFTDescriptor() for one keypoint and pool its channels if requested
+//Precondition: the following parameters must be correclty defined.
+//parameters:
+	//img, ptf, ori, scl, d, n: as for calcSIFTDescriptor()
+	//dst: output row of outputSize() floats
+//Postcondition: dst holds the descriptor of the keypoint
+//-------------------------------------------------------------------------------------
+		void describeKeypoint(const Mat& img, Point2f ptf, float ori, float scl, int d, int n, float* dst) const;
+
 //------------------------------------createInitialImage()-----------------------------
 //create initial grey-scale base image for later process
 //Precondition: the following parameters must be correclty defined.
@@ -356,6 +440,9 @@ namespace cv {
 		CV_PROP_RW double contrastThreshold;
 		CV_PROP_RW double edgeThreshold;
 		CV_PROP_RW double sigma;
+
+		// sum the channel blocks of the descriptor into one
+		bool poolChannels;
 	};
 
 } // namespace cv
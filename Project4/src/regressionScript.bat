@@ -0,0 +1,114 @@
+@echo off
+rem Records the keypoints, descriptors and matches of every descriptor type on
+rem one image pair, and compares them byte for byte with an earlier recording.
+rem
+rem   regressionScript.bat <label>                        record into Regression\<label>
+rem   regressionScript.bat <label> <baseline>             record, then compare with Regression\<baseline>
+rem   regressionScript.bat <label> <baseline> <matcher>   the same with another matcher than brute
+rem
+rem A change that claims unchanged output is checked by recording its parent
+rem commit as the baseline and the change itself against it. A matcher that
+rem claims the matches of brute is checked by recording with brute as the
+rem baseline and with it against that, e.g. "regressionScript.bat blocked brute blocked".
+
+cls
+@pushd %~dp0
+
+setlocal EnableDelayedExpansion
+
+if "%~1"=="" (
+	echo usage: regressionScript.bat label [baseline] [matcher]
+	goto :end
+)
+
+cd ..\
+for %%a in ("%cd%") do set programTitle=%%~na
+cd src
+
+set "executable=%programTitle%.exe"
+
+set "dataset=oxford"
+set "imageset=boat"
+set "images=img1.ppm, img2.ppm"
+set "homographies=H1to2p.txt"
+set "descriptors=SIFT CHoNI CSIFT CSPIN HoNC HoNC3 HoNI HoWH OpponentSIFT RGBSIFT RGSIFT SPIN HoNC+SIFT RGBSIFT+HoNC+HoWH+HoNI"
+
+set "matcher=brute"
+if not "%~3"=="" set "matcher=%~3"
+
+set "configName=regressionScriptConfig.txt"
+set "configFile=%~dp0..\config\%configName%"
+set "outputDir=%~dp0..\output\"
+set "runDir=%~dp0Regression\%~1\"
+set "baselineDir=%~dp0Regression\%~2\"
+set "resultFile=%~dp0regression_result.txt"
+
+if exist "%runDir%" rmdir /s /q "%runDir%"
+
+rem one run per descriptor type, the descriptor file is named after all types of a run
+for %%d in (%descriptors%) do (
+	echo dataset: %dataset%> "%configFile%"
+	echo imageset: %imageset%>> "%configFile%"
+	echo images: %images%>> "%configFile%"
+	echo homographies: %homographies%>> "%configFile%"
+	echo descriptors: %%d>> "%configFile%"
+	echo extractor: SURF>> "%configFile%"
+	echo save: true>> "%configFile%"
+	echo display: false>> "%configFile%"
+	echo matcher: %matcher%>> "%configFile%"
+
+	del /q "%outputDir%*%imageset%*.txt" "%outputDir%kpts_images=*.xml" "%outputDir%descriptors=*.xml" 2>nul
+
+	start /b /wait /d "%~dp0..\..\x64\Release\" %executable% %configName%
+
+	mkdir "%runDir%%%d"
+	for %%f in ("%outputDir%*%imageset%*.txt" "%outputDir%kpts_images=*.xml" "%outputDir%descriptors=*.xml") do (
+		move /y "%%~f" "%runDir%%%d\" >nul
+	)
+)
+
+del "%configFile%"
+
+if "%~2"=="" goto :end
+
+del "%resultFile%" 2>nul
+
+rem every recorded baseline file has to exist in the new run with the same bytes
+for %%d in (%descriptors%) do (
+	echo %%d >> "%resultFile%"
+
+	for %%f in ("%baselineDir%%%d\*") do (
+		if not exist "%runDir%%%d\%%~nxf" (
+			echo %%~nxf: MISSING >> "%resultFile%"
+		) else (
+			fc /b "%%~f" "%runDir%%%d\%%~nxf" >nul
+
+			if errorlevel 1 (
+				echo %%~nxf: FAIL >> "%resultFile%"
+			) else (
+				echo %%~nxf: PASS >> "%resultFile%"
+			)
+		)
+	)
+
+	echo( >> "%resultFile%"
+)
+
+find /c "FAIL" "%resultFile%"
+find /c "MISSING" "%resultFile%"
+
+echo(
+
+findstr /c:"FAIL" /c:"MISSING" "%resultFile%" >nul
+
+if errorlevel 1 (
+	echo The output is unchanged
+) else (
+	echo The output has CHANGED, see %resultFile%
+)
+
+echo(
+
+:end
+endlocal
+popd
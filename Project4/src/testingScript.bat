@@ -33,9 +33,20 @@ for %%i in (%imagesets%) do (
 		set "correctResultFile=%correctResultFileLoc%%%j"
 		set "testResultFile=%testResultFileLoc%%%j"
 
-		fc "!correctResultFile!" "!testResultFile!" >nul
+		rem the checked-out headers predate the count of keypoints with a true correspondence,
+		rem so only the first two values of the first line are compared, then every other line
+		set "correctHeader=" & set "testHeader="
+		for /f "usebackq tokens=1,2" %%a in ("!correctResultFile!") do if not defined correctHeader set "correctHeader=%%a %%b"
+		for /f "usebackq tokens=1,2" %%a in ("!testResultFile!") do if not defined testHeader set "testHeader=%%a %%b"
+		more +1 "!correctResultFile!" > "%~dp0correct_body.txt"
+		more +1 "!testResultFile!" > "%~dp0test_body.txt"
+
+		set "differs=1"
+		if "!correctHeader!"=="!testHeader!" (
+			fc "%~dp0correct_body.txt" "%~dp0test_body.txt" >nul && set "differs=0"
+		)
 
-		if errorlevel 1 (
+		if "!differs!"=="1" (
 		    echo %%j files comparison: FAIL >> "%resultFile%"
 		) else (
 		    echo %%j files comparison: PASS >> "%resultFile%"
@@ -47,6 +58,8 @@ for %%i in (%imagesets%) do (
 
 )
 
+del "%~dp0correct_body.txt" "%~dp0test_body.txt" 2>nul
+
 find /c "FAIL" "%resultFile%"
 
 echo(